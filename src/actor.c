@@ -0,0 +1,127 @@
+/*
+ * Copyright 2013, Zhou Zhenghui <zhouzhenghui@gmail.com>
+ */
+
+#include "continuation/actor.h"
+#include <errno.h>
+#include <sched.h>
+
+static void actor_run(struct __SchedulerTask *task);
+
+void actor_init(struct __Actor *actor, struct __Scheduler *scheduler, ActorBehavior *behavior, int batch)
+{
+  scheduler_task_init(&actor->task, actor_run);
+  actor->scheduler = scheduler ? scheduler : scheduler_default();
+  actor->behavior = behavior;
+  actor->batch = batch > 0 ? batch : ACTOR_BATCH;
+  actor->scheduled = 0;
+  actor->active = 0;
+  actor->stub.next = NULL;
+  actor->head = &actor->stub;
+  actor->tail = &actor->stub;
+}
+
+void actor_free(struct __Actor *actor)
+{
+  /* an idle actor has an empty mailbox, and the activation clearing the flag
+   * still touches the actor until it leaves, which it has entered before the clearing */
+  while (ATOMIC_LOAD(&actor->scheduled) || ATOMIC_LOAD(&actor->active)) sched_yield();
+}
+
+static void actor_push(struct __Actor *actor, struct __ActorMessage *item)
+{
+  struct __ActorMessage *prev;
+  item->next = NULL;
+  prev = ATOMIC_EXCHANGE(&actor->tail, item);
+  /* the item is unreachable by the activation until linked */
+  ATOMIC_STORE(&prev->next, item);
+}
+
+/* take the oldest message, or NULL if empty or the latest post is not linked yet */
+static struct __ActorMessage *actor_pop(struct __Actor *actor)
+{
+  struct __ActorMessage *head = actor->head;
+  struct __ActorMessage *next = ATOMIC_LOAD(&head->next);
+  if (head == &actor->stub) {
+    if (next == NULL) return NULL;
+    actor->head = next;
+    head = next;
+    next = ATOMIC_LOAD(&next->next);
+  }
+  if (next) {
+    actor->head = next;
+    return head;
+  }
+  if (head != ATOMIC_LOAD(&actor->tail)) return NULL;
+  /* the last message, put the stub behind it to take it out */
+  actor_push(actor, &actor->stub);
+  next = ATOMIC_LOAD(&head->next);
+  if (next) {
+    actor->head = next;
+    return head;
+  }
+  return NULL;
+}
+
+/* the mailbox has a message or a post in progress */
+static int actor_has_message(struct __Actor *actor)
+{
+  return ATOMIC_LOAD(&actor->tail) != actor->head;
+}
+
+static void actor_run(struct __SchedulerTask *task)
+{
+  struct __Actor *actor = (struct __Actor *)task;
+  int n;
+
+  /* counted rather than flagged, the next activation may enter before the previous one leaves */
+  ATOMIC_FETCH_ADD(&actor->active, 1);
+  for (n = 0; n < actor->batch; ++n) {
+    struct __ActorMessage *item = actor_pop(actor);
+    void *message;
+    if (item == NULL) {
+      /* the post being linked will be taken by the next activation */
+      if (actor_has_message(actor)) break;
+      ATOMIC_STORE(&actor->scheduled, 0);
+      ATOMIC_FENCE();
+      /* a post between the pop and the clearing found the actor scheduled */
+      if (!actor_has_message(actor) || !ATOMIC_CAS(&actor->scheduled, 0, 1)) {
+        /* the last access to the actor, it may be freed afterward */
+        ATOMIC_FETCH_SUB(&actor->active, 1);
+        return;
+      }
+      continue;
+    }
+    message = item->message;
+    if (item->allocated) free(item);
+    CLOSURE_RUN_N(1, actor->behavior, (message));
+  }
+  /* give the worker to others, the actor stays scheduled */
+  scheduler_submit(actor->scheduler, &actor->task);
+  ATOMIC_FETCH_SUB(&actor->active, 1);
+}
+
+static void actor_deliver(struct __Actor *actor, struct __ActorMessage *item)
+{
+  actor_push(actor, item);
+  /* only the post waking an idle actor queues it */
+  if (ATOMIC_CAS(&actor->scheduled, 0, 1)) {
+    scheduler_submit(actor->scheduler, &actor->task);
+  }
+}
+
+void actor_post(struct __Actor *actor, struct __ActorMessage *item)
+{
+  item->allocated = 0;
+  actor_deliver(actor, item);
+}
+
+int actor_send(struct __Actor *actor, void *message)
+{
+  struct __ActorMessage *item = (struct __ActorMessage *)malloc(sizeof(struct __ActorMessage));
+  if (item == NULL) return ENOMEM;
+  item->message = message;
+  item->allocated = 1;
+  actor_deliver(actor, item);
+  return 0;
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright 2013, Zhou Zhenghui <zhouzhenghui@gmail.com>
+ */
+
+#include "continuation/cancel_token.h"
+#include <sched.h>
+#include <stdlib.h>
+
+/* the list of a cancelled token, which takes no more registrations */
+#define CANCEL_TOKEN_CLOSED(token) ((struct __CancelCallback *)(token))
+
+void cancel_token_init(struct __CancelToken *token)
+{
+  token->callbacks = NULL;
+  token->fired = NULL;
+  token->cancelled = 0;
+  token->released = 0;
+}
+
+void cancel_token_free(struct __CancelToken *token)
+{
+  struct __CancelCallback *callback = token->callbacks, *next;
+  if (callback == CANCEL_TOKEN_CLOSED(token)) callback = token->fired;
+  for (; callback; callback = next) {
+    next = callback->next;
+    free(callback);
+  }
+  token->callbacks = NULL;
+  token->fired = NULL;
+  token->released = 0;
+}
+
+int cancel_token_cancel(struct __CancelToken *token)
+{
+  struct __CancelCallback *list, *callback, *next;
+  if (!ATOMIC_CAS(&token->cancelled, 0, 1)) return 0;
+  list = ATOMIC_EXCHANGE(&token->callbacks, CANCEL_TOKEN_CLOSED(token));
+  /* run in the order of registration, the registrations looking for a released one
+   * may still walk the list meanwhile, which stays acyclic while it is reversed */
+  for (callback = NULL; list; list = next) {
+    next = list->next;
+    list->next = callback;
+    callback = list;
+  }
+  token->fired = callback;
+  for (; callback; callback = callback->next) {
+    if (ATOMIC_CAS(&callback->state, CANCEL_CALLBACK_REGISTERED, CANCEL_CALLBACK_RUNNING)) {
+      callback->func(callback->arg);
+      ATOMIC_STORE(&callback->state, CANCEL_CALLBACK_DONE);
+    }
+  }
+  return 1;
+}
+
+/* claim a registration released by cancel_token_unregister(), or return NULL */
+static struct __CancelCallback *cancel_token_claim(struct __CancelToken *token)
+{
+  struct __CancelCallback *callback;
+  if (ATOMIC_LOAD(&token->released) <= 0) return NULL;
+  /* the registrations are never unlinked before cancel_token_free(), so the walk is safe */
+  for (callback = ATOMIC_LOAD(&token->callbacks);
+       callback != NULL && callback != CANCEL_TOKEN_CLOSED(token);
+       callback = callback->next) {
+    if (ATOMIC_LOAD_RELAXED(&callback->state) == CANCEL_CALLBACK_UNREGISTERED
+        && ATOMIC_CAS(&callback->state, CANCEL_CALLBACK_UNREGISTERED, CANCEL_CALLBACK_CLAIMED)) {
+      ATOMIC_FETCH_SUB(&token->released, 1);
+      return callback;
+    }
+  }
+  return NULL;
+}
+
+struct __CancelCallback *cancel_token_register(struct __CancelToken *token, void (*func)(void *), void *arg)
+{
+  struct __CancelCallback *callback, *head;
+  if (ATOMIC_LOAD(&token->cancelled)) return NULL;
+  callback = cancel_token_claim(token);
+  if (callback != NULL) {
+    callback->func = func;
+    callback->arg = arg;
+    ATOMIC_STORE(&callback->state, CANCEL_CALLBACK_REGISTERED);
+    /* a cancellation which has passed over the claimed registration has set the flag already */
+    ATOMIC_FENCE();
+    if (ATOMIC_LOAD(&token->cancelled)
+        && ATOMIC_CAS(&callback->state, CANCEL_CALLBACK_REGISTERED, CANCEL_CALLBACK_UNREGISTERED)) {
+      return NULL;
+    }
+    return callback;
+  }
+  callback = (struct __CancelCallback *)malloc(sizeof(struct __CancelCallback));
+  if (callback == NULL) return NULL;
+  callback->token = token;
+  callback->func = func;
+  callback->arg = arg;
+  callback->state = CANCEL_CALLBACK_REGISTERED;
+  do {
+    head = ATOMIC_LOAD(&token->callbacks);
+    if (head == CANCEL_TOKEN_CLOSED(token)) {
+      free(callback);
+      return NULL;
+    }
+    callback->next = head;
+  } while (!ATOMIC_CAS(&token->callbacks, head, callback));
+  return callback;
+}
+
+int cancel_token_unregister(struct __CancelCallback *callback)
+{
+  if (callback == NULL) return 0;
+  /* the registration stays in the list, to be reused by a later registration until the cancellation */
+  if (ATOMIC_CAS(&callback->state, CANCEL_CALLBACK_REGISTERED, CANCEL_CALLBACK_UNREGISTERED)) {
+    ATOMIC_FETCH_ADD(&callback->token->released, 1);
+    return 1;
+  }
+  while (ATOMIC_LOAD(&callback->state) == CANCEL_CALLBACK_RUNNING) sched_yield();
+  return 0;
+}
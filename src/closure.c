@@ -68,3 +68,19 @@ void __closure_commit_vars_debug(__ClosureVarDebugVector *argv, size_t stack_fra
   }
   if (updated) fprintf(stderr, ". at: file \"%s\", line %d\n", file, line);
 }
+
+void __closure_restore_vars(__ClosureVarVector *argv, size_t stack_frame_offset)
+{
+  struct __ClosureVar *arg;
+  VECTOR_FOREACH(arg, argv) {
+    memcpy((char *)arg->addr + stack_frame_offset, arg->value, arg->size);
+  }
+}
+
+void __closure_restore_vars_debug(__ClosureVarDebugVector *argv, size_t stack_frame_offset)
+{
+  struct __ClosureVarDebug *arg;
+  VECTOR_FOREACH(arg, argv) {
+    memcpy((char *)arg->addr + stack_frame_offset, arg->value, arg->size);
+  }
+}
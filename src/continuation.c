@@ -3,9 +3,17 @@
  */
 
 #include "continuation/continuation_base.h"
+#if CONTINUATION_USE_INVOKE_STACK
+# include "continuation/fiber.h"
+# ifdef HAVE_PTHREAD
+#  include <pthread.h>
+# endif
+#endif
 
 void(*__continuation_enforce_var)(char * volatile) = 0;
 
+jmp_buf __continuation_clobber_buf;
+
 /** @internal */
 /**
  * @brief internal function to __continuation_invoke_helper.
@@ -163,18 +171,98 @@ static struct __ContinuationStub *__continuation_restore_stack_frame(const struc
   }
 #endif /* mark unused code */
   assert((size_t)cont_stub->addr.stack_frame_tail > (size_t)&stack_tail && "Wrong frame tail in stack frame");
-  memcpy(cont_stub->addr.stack_frame_tail, stack_frame, cont_stub->cont->stack_frame_size);
+  continuation_copy_frame(cont_stub->cont, cont_stub->addr.stack_frame_tail, stack_frame);
   return (struct __ContinuationStub *)cont_stub;
 }
 
+#if CONTINUATION_USE_INVOKE_STACK
+/* the pre-allocated stack of the thread to invoke continuations on */
+static CONTINUATION_THREAD_LOCAL struct __Fiber *continuation_invoke_stack = NULL;
+#ifdef HAVE_PTHREAD
+static pthread_key_t continuation_invoke_stack_key;
+static pthread_once_t continuation_invoke_stack_once = PTHREAD_ONCE_INIT;
+
+static void continuation_invoke_stack_destroy(void *arg)
+{
+  (void)arg;
+  continuation_invoke_stack_free();
+}
+
+static void make_key()
+{
+  pthread_key_create(&continuation_invoke_stack_key, continuation_invoke_stack_destroy);
+}
+#endif
+
+struct __ContinuationInvokeOnStack {
+  struct __ContinuationStub *cont_stub;
+  char *stack_frame_addr;
+};
+
+static void continuation_invoke_on_stack(void *arg)
+{
+  struct __ContinuationStub *cont_stub = ((struct __ContinuationInvokeOnStack *)arg)->cont_stub;
+  if (continuation_stub_setjmp(cont_stub->return_buf) == 0) {
+    /* the space reserved above is large enough, so that the stack needs no extension */
+    cont_stub->addr.stack_frame_addr = ((struct __ContinuationInvokeOnStack *)arg)->stack_frame_addr;
+    cont_stub->cont->invoke(cont_stub);
+  }
+}
+
+/* invoke on the stack of the thread if it's available and large enough */
+static int continuation_stub_invoke_on_stack(struct __ContinuationStub *cont_stub)
+{
+  struct __ContinuationInvokeOnStack arg;
+  size_t reserve = cont_stub->cont->stack_frame_size + cont_stub->cont->stack_parameters_size
+                    + 2 * CONTINUATION_STACK_FRAME_PADDING + CONTINUATION_STACK_BLOCK_SIZE;
+  /* the stack is busy with a nesting invocation, or the caller runs on a fiber already */
+  if (fiber_current() != NULL) return 0;
+  if (continuation_invoke_stack == NULL) {
+    continuation_invoke_stack = (struct __Fiber *)malloc(sizeof(struct __Fiber));
+    if (continuation_invoke_stack == NULL) return 0;
+    if (fiber_init(continuation_invoke_stack, NULL, continuation_invoke_on_stack, NULL) != 0) {
+      free(continuation_invoke_stack);
+      continuation_invoke_stack = NULL;
+      return 0;
+    }
+#ifdef HAVE_PTHREAD
+    /* the stack is released when the thread exits */
+    pthread_once(&continuation_invoke_stack_once, make_key);
+    pthread_setspecific(continuation_invoke_stack_key, continuation_invoke_stack);
+#endif
+  }
+  if (reserve + 4 * CONTINUATION_STACK_BLOCK_SIZE > continuation_invoke_stack->pool->stack_size) return 0;
+  arg.cont_stub = cont_stub;
+  arg.stack_frame_addr = (char *)continuation_invoke_stack->stack - CONTINUATION_STACK_BLOCK_SIZE;
+  fiber_reset(continuation_invoke_stack, continuation_invoke_on_stack, &arg, reserve);
+  fiber_resume(continuation_invoke_stack);
+  assert(fiber_is_finished(continuation_invoke_stack));
+  return 1;
+}
+#endif /* CONTINUATION_USE_INVOKE_STACK */
+
 void continuation_stub_invoke(struct __ContinuationStub *cont_stub)
 {
   assert(cont_stub->cont != NULL);
+#if CONTINUATION_USE_INVOKE_STACK
+  if (continuation_stub_invoke_on_stack(cont_stub)) return;
+#endif
   if (continuation_stub_setjmp(cont_stub->return_buf) == 0) {
     __continuation_invoke_helper(cont_stub);
   }
 }
 
+void continuation_invoke_stack_free(void)
+{
+#if CONTINUATION_USE_INVOKE_STACK
+  if (continuation_invoke_stack != NULL) {
+    fiber_free(continuation_invoke_stack);
+    free(continuation_invoke_stack);
+    continuation_invoke_stack = NULL;
+  }
+#endif
+}
+
 void continuation_stub_return(struct __ContinuationStub *cont_stub)
 {
   continuation_stub_longjmp(cont_stub->return_buf, 1);
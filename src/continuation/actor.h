@@ -0,0 +1,138 @@
+/*
+ * Copyright 2013, Zhou Zhenghui <zhouzhenghui@gmail.com>
+ */
+
+#ifndef __CONTINUATION_ACTOR_H
+#define __CONTINUATION_ACTOR_H
+
+/**
+ * @defgroup actor actor
+ * @ingroup scheduler
+ * @brief Closures with private mailboxes run on the scheduler.
+ * @details An actor is a connected closure, the behavior, together with a mailbox. The messages
+ * posted to the mailbox are passed to the behavior one by one in order, and the behavior is never
+ * invoked concurrently, so the state it retains, e.g. by CLOSURE_RETAIN_VAR(), needs no lock.
+ *
+ * The mailbox is an intrusive lock-free list of multiple producers and a single consumer.
+ * Posting links the message and sets the scheduled flag of the actor, and only the post finding
+ * the flag clear queues the actor to the scheduler. An activation processes at most a batch of
+ * messages and queues the actor again if more remain, so that a busy actor doesn't starve the others
+ * on the same worker. An idle actor takes no task of the scheduler, no thread and no lock,
+ * so the number of actors is bound by the memory only.
+ *
+ * @par Example:
+ * @code
+ *  ActorBehavior counter;
+ *  struct __Actor actor;
+ *  long total = 0;
+ *  CLOSURE_INIT(&counter);
+ *  CLOSURE_CONNECT(&counter
+ *    , (CLOSURE_RETAIN_VAR(total);)
+ *    , (total += *(long *)CLOSURE_ARG_OF_(&counter)->_1;)
+ *    , ()
+ *  );
+ *  actor_init(&actor, NULL, &counter, 0);
+ *  ...
+ *  // any thread
+ *  actor_send(&actor, &amount);
+ * @endcode
+ * @{
+ */
+
+/**
+ * @file
+ * @brief The head file for actors.
+ */
+
+#include "scheduler.h"
+#include "closure.h"
+
+/**
+ * @brief The number of messages processed by an activation of an actor by default.
+ * @see actor_init()
+ */
+#define ACTOR_BATCH 64
+
+/**
+ * @brief Type of the closures of actors.
+ * @details The closure is invoked with the message posted.
+ */
+typedef CLOSURE1(void *) ActorBehavior;
+
+/**
+ * @brief Structure type represents a message in the mailbox of an actor.
+ * @details It can be embedded in a user structure and posted by actor_post()
+ * to avoid the allocation of actor_send().
+ */
+struct __ActorMessage {
+  struct __ActorMessage * volatile next; /**< link in the mailbox. */
+  void *message; /**< the message passed to the behavior. */
+  int allocated; /**< the item is allocated by actor_send() and freed after delivery. */
+};
+
+/**
+ * @brief The actor structure.
+ * @see actor_init()
+ */
+struct __Actor {
+  struct __SchedulerTask task; /**< the scheduler task of the activations. */
+  struct __Scheduler *scheduler; /**< the scheduler to run on. */
+  ActorBehavior *behavior; /**< the connected behavior. */
+  int batch; /**< the maximum number of messages processed by an activation. */
+  volatile int scheduled; /**< the actor is queued or running. */
+  volatile int active; /**< number of the activations that have not finished touching the actor. */
+  struct __ActorMessage *head; /**< the oldest message, taken by the activation only. */
+  struct __ActorMessage * volatile tail; /**< the latest message, appended by the posts. */
+  struct __ActorMessage stub; /**< the placeholder keeping the mailbox never empty. */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  /**
+   * @brief Initialize an actor.
+   * @param actor: pointer to the actor.
+   * @param scheduler: the scheduler to run the behavior on, or NULL for the default one.
+   * @param behavior: the connected behavior.
+   * @param batch: the maximum number of messages processed by an activation, or 0 for ACTOR_BATCH.
+   * @see actor_free()
+   */
+  extern void actor_init(struct __Actor *actor, struct __Scheduler *scheduler, ActorBehavior *behavior, int batch);
+  /**
+   * @brief Free an actor.
+   * @details It waits until the messages posted are processed. The behavior is owned by the caller.
+   * @param actor: pointer to the actor.
+   * @note No message should be posted meanwhile.
+   */
+  extern void actor_free(struct __Actor *actor);
+  /**
+   * @brief Post an item to the mailbox of an actor.
+   * @param actor: pointer to the actor.
+   * @param item: pointer to the item with the message filled,
+   * which must stay valid until the behavior has been invoked.
+   */
+  extern void actor_post(struct __Actor *actor, struct __ActorMessage *item);
+  /**
+   * @brief Send a message to an actor.
+   * @param actor: pointer to the actor.
+   * @param message: the message passed to the behavior.
+   * @return 0 on success, or ENOMEM.
+   */
+  extern int actor_send(struct __Actor *actor, void *message);
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+/**
+ * @brief Determine whether an actor is queued or running.
+ * @param actor: pointer to the actor.
+ * @return 0 if the actor is idle with an empty mailbox.
+ */
+inline static int actor_is_scheduled(const struct __Actor *actor)
+{
+  return ATOMIC_LOAD(&actor->scheduled);
+}
+
+/** @} */
+
+#endif /* __CONTINUATION_ACTOR_H */
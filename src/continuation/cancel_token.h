@@ -0,0 +1,144 @@
+/*
+ * Copyright 2013, Zhou Zhenghui <zhouzhenghui@gmail.com>
+ */
+
+#ifndef __CONTINUATION_CANCEL_TOKEN_H
+#define __CONTINUATION_CANCEL_TOKEN_H
+
+/**
+ * @defgroup cancel_token cancel token
+ * @ingroup continuation_pthread
+ * @brief Cooperative cancellation of asynchronous work.
+ * @details A cancel token is an atomic flag together with a lock-free list of callbacks.
+ * The asynchronous tasks poll the flag by cancel_token_is_cancelled(), while the waits
+ * register callbacks to be woken up or unlinked as soon as the token is cancelled:
+ * - scheduler_cancel_timer() takes a task out of the timer heap of a scheduler;
+ * - signal_queue_emit_cancellable() gives up waiting for room of a full queue;
+ * - signalbus::sleep_for() of the coroutines resumes before the deadline.
+ *
+ * A token is cancelled at most once, and the callbacks run on the cancelling thread in
+ * the order they are registered. The registrations are only pushed to the list, and never
+ * unlinked before cancel_token_free(), so that neither a lock nor a reclamation scheme is needed.
+ * Instead, a registration released by cancel_token_unregister() is reused by a later one in its place,
+ * so a long-lived token doesn't grow with the waits registered and unregistered.
+ *
+ * @par Example:
+ * @code
+ *  struct __CancelToken token;
+ *  cancel_token_init(&token);
+ *  ASYNC_SPAWN(
+ *    while (!cancel_token_is_cancelled(&token) && work_remains()) work();
+ *  );
+ *  ...
+ *  // the client is gone
+ *  cancel_token_cancel(&token);
+ * @endcode
+ * @{
+ */
+
+/**
+ * @file
+ * @brief The head file for cancel tokens.
+ */
+
+#include <stddef.h>
+#include "misc/atomic.h"
+
+/**
+ * @name Callback states
+ * @{
+ */
+/** @brief The callback runs when the token is cancelled. */
+#define CANCEL_CALLBACK_REGISTERED 0
+/** @brief The callback is unregistered before it runs. */
+#define CANCEL_CALLBACK_UNREGISTERED 1
+/** @brief The callback is running. */
+#define CANCEL_CALLBACK_RUNNING 2
+/** @brief The callback has run. */
+#define CANCEL_CALLBACK_DONE 3
+/** @brief The unregistered callback is being reused by a registration. */
+#define CANCEL_CALLBACK_CLAIMED 4
+/** @} */
+
+struct __CancelToken;
+
+/**
+ * @brief Structure type represents a callback registered to a cancel token.
+ * @see cancel_token_register()
+ */
+struct __CancelCallback {
+  struct __CancelCallback * volatile next; /**< the callback registered before. */
+  struct __CancelToken *token; /**< the token registered to. */
+  void (*func)(void *); /**< the function called on cancellation. */
+  void *arg; /**< the argument to \p func. */
+  volatile int state; /**< one of the callback states. */
+};
+
+/**
+ * @brief The cancel token structure.
+ * @see cancel_token_init()
+ */
+struct __CancelToken {
+  struct __CancelCallback * volatile callbacks; /**< the callbacks, the latest first. */
+  struct __CancelCallback * volatile fired; /**< the callbacks taken by the cancellation. */
+  volatile int cancelled; /**< the token is cancelled. */
+  volatile int released; /**< number of the unregistered callbacks in \p callbacks to be reused. */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  /**
+   * @brief Initialize a cancel token.
+   * @param token: pointer to the token.
+   * @see cancel_token_free()
+   */
+  extern void cancel_token_init(struct __CancelToken *token);
+  /**
+   * @brief Free a cancel token together with its registrations.
+   * @param token: pointer to the token.
+   * @note No registration or cancellation should happen meanwhile.
+   */
+  extern void cancel_token_free(struct __CancelToken *token);
+  /**
+   * @brief Cancel a token and run the callbacks registered.
+   * @param token: pointer to the token.
+   * @return 1 if the token is cancelled by the call, or 0 if it was cancelled already.
+   */
+  extern int cancel_token_cancel(struct __CancelToken *token);
+  /**
+   * @brief Register a callback to a cancel token.
+   * @param token: pointer to the token.
+   * @param func: the function called with \p arg on cancellation.
+   * @param arg: the argument to \p func.
+   * @return the registration, or NULL if the token is cancelled already or out of memory,
+   * in which case \p func is not called.
+   * @see cancel_token_unregister()
+   */
+  extern struct __CancelCallback *cancel_token_register(struct __CancelToken *token, void (*func)(void *), void *arg);
+  /**
+   * @brief Unregister a callback from its cancel token.
+   * @details If the callback is running, it waits until the callback returns,
+   * so that \p arg can be released afterward.
+   * @param callback: the registration, or NULL, which is kept by the token to be reused
+   * by a later registration, so it must not be unregistered twice.
+   * @return 1 if the callback is unregistered before it runs, otherwise 0.
+   * @warning Don't unregister a callback from the callback itself.
+   */
+  extern int cancel_token_unregister(struct __CancelCallback *callback);
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+/**
+ * @brief Determine whether a cancel token is cancelled.
+ * @param token: pointer to the token, or NULL for a token never cancelled.
+ */
+inline static int cancel_token_is_cancelled(const struct __CancelToken *token)
+{
+  return token != NULL && ATOMIC_LOAD(&token->cancelled);
+}
+
+/** @} */
+
+#endif /* __CONTINUATION_CANCEL_TOKEN_H */
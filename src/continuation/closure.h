@@ -183,6 +183,71 @@ struct __ClosureEmpty { struct __Closure closure; struct { char end; } arg; };
 #define CLOSURE8(t1, t2, t3, t4, t5, t6, t7, t8) CLOSURE_N(8, (t1, t2, t3, t4, t5, t6, t7, t8))
 #define CLOSURE9(t1, t2, t3, t4, t5, t6, t7, t8, t9) CLOSURE_N(9, (t1, t2, t3, t4, t5, t6, t7, t8, t9))
 
+/** @cond */
+/**
+ * @internal
+ * @brief Internal help macro to CLOSURE_REF_N()
+ */
+#define __CLOSURE_REF_FIELDS(z, n, seq) \
+  __CLOSURE_REF_FIELD(BOOST_PP_SEQ_ELEM(n, seq), BOOST_PP_CAT(_, BOOST_PP_INC(n)))
+#define __CLOSURE_REF_FIELD(type, name) type const * name;
+/** @endcond */
+
+/**
+ * @brief Anonymous structure type to declare a closure taking parameters by reference.
+ * @details The fields of the closure argument are const pointers to the parameters
+ * instead of copies of them. The parameters stay in the stack of the invoker,
+ * so that only a pointer per parameter is stored in the closure and copied into
+ * the relocated stack frame, no matter how large the parameters are.
+ * 
+ * @param n: the number of parameters.
+ * @param tuple: boost preprocessor tuple contains type of parameters.
+ * 
+ * @see CLOSURE_REF()
+ * @see CLOSURE_REF_RUN_N()
+ * @par Example:
+ * @code
+ *  struct Quote { char symbol[16]; double bids[256]; double asks[256]; };
+ *  CLOSURE_REF_N(1, (struct Quote)) closure_quote;
+ *  CLOSURE_CONNECT(&closure_quote
+ *    , ()
+ *    , (
+ *      printf("%s: %f\n", CLOSURE_ARG_OF_(&closure_quote)->_1->symbol, CLOSURE_ARG_OF_(&closure_quote)->_1->bids[0]);
+ *    )
+ *    , ()
+ *  );
+ * @endcode
+ */
+#define CLOSURE_REF_N(n, tuple) \
+struct { \
+  struct __Closure closure; \
+  struct { \
+      BOOST_PP_REPEAT(n, __CLOSURE_REF_FIELDS, BOOST_PP_TUPLE_TO_SEQ(n, tuple)) \
+      char end; /* for MSVC compatible */ \
+  } arg; \
+}
+
+/**
+ * @copybrief CLOSURE_REF_N()
+ * @details If variadic macros are available, the parameters in BOOST preprocessor tuple
+ * can be transefered directly without the number and tuple specification,
+ * or it is the alias to CLOSURE_REF_N() otherwise.
+ * 
+ * @param ...: type of parameters seperated by comma if BOOST_PP_VARIADICS isn't 0.
+ * 
+ * @see CLOSURE_REF_N()
+ */
+#define CLOSURE_REF() /* Empty definition for Doxygen */
+#undef CLOSURE_REF
+
+/** @cond */
+#if BOOST_PP_VARIADICS
+# define CLOSURE_REF(...) CLOSURE_REF_N(__PP_VARIADIC_SIZE_OR_ZERO(__VA_ARGS__), BOOST_PP_VARIADIC_TO_TUPLE(__VA_ARGS__))
+#else
+# define CLOSURE_REF CLOSURE_REF_N
+#endif
+/** @endcond */
+
 /**
  * @brief Initialize a closure to bring it to a consistent state in the life cycle.
  * @details The closure is marked as unconnected.
@@ -232,6 +297,52 @@ struct __ClosureEmpty { struct __Closure closure; struct { char end; } arg; };
   __closure_commit_vars(&__CLOSURE_STUB->closure->argv, CLOSURE_GET_STACK_FRAME_OFFSET())
 #endif
 
+/** @cond */
+/**
+ * @internal
+ * @brief Restore the retained variables only, when the closure is invoked in place.
+ * @details It is an internal help macro to CLOSURE_CONNECT().
+ * @see CLOSURE_CONNECT()
+ * @see CONTINUATION_USE_IN_PLACE_INVOKE
+ */
+#ifdef CLOSURE_DEBUG
+# define __CLOSURE_RESTORE_RETAIN_VARS() \
+  __closure_restore_vars_debug(&__CLOSURE_STUB->closure->argv, CLOSURE_GET_STACK_FRAME_OFFSET())
+#else
+# define __CLOSURE_RESTORE_RETAIN_VARS() \
+  __closure_restore_vars(&__CLOSURE_STUB->closure->argv, CLOSURE_GET_STACK_FRAME_OFFSET())
+#endif
+
+/**
+ * @internal
+ * @brief Record the activation of host function when a closure is connected.
+ * @details It is an internal help macro to CLOSURE_CONNECT().
+ * @param internal_closure: pointer to the internal closure structure.
+ * @param mark: address of a variable in the stack frame of host function which points to \p closure.
+ * @see CONTINUATION_USE_IN_PLACE_INVOKE
+ */
+#if CONTINUATION_USE_IN_PLACE_INVOKE
+# define __CLOSURE_INIT_HOST(internal_closure, mark) \
+  do { \
+    (internal_closure)->host_frame = CONTINUATION_FRAME_ADDRESS(); \
+    (internal_closure)->host_func = __func__; \
+    (internal_closure)->host_mark = (mark); \
+    (internal_closure)->in_place = 0; \
+    (internal_closure)->in_place_stub = NULL; \
+  } while (0)
+#else
+/* never run in place even by a translation unit with CONTINUATION_USE_IN_PLACE_INVOKE */
+# define __CLOSURE_INIT_HOST(internal_closure, mark) \
+  do { \
+    (internal_closure)->host_frame = NULL; \
+    (internal_closure)->host_func = NULL; \
+    (internal_closure)->host_mark = NULL; \
+    (internal_closure)->in_place = 0; \
+    (internal_closure)->in_place_stub = NULL; \
+  } while (0)
+#endif
+/** @endcond */
+
 /**
  * @brief Connect a closure with the execution statements based on continuation.
  * @details The continuation statements are specified in place and will be executed when the closure is connected,
@@ -300,7 +411,13 @@ struct __ClosureEmpty { struct __Closure closure; struct { char end; } arg; };
             } \
         ) \
         , ( \
-            CONTINUATION_RESTORE_STACK_FRAME(__CLOSURE_STUB, __CLOSURE_STUB->closure->frame); \
+            if (CONTINUATION_USE_IN_PLACE_INVOKE && __CLOSURE_STUB == __CLOSURE_STUB->closure->in_place_stub) { \
+              /* running in the live stack frame of host function, \
+                 a relocated invocation may be at the offset 0 as well */ \
+              __CLOSURE_RESTORE_RETAIN_VARS(); \
+            } else { \
+              CONTINUATION_RESTORE_STACK_FRAME(__CLOSURE_STUB, __CLOSURE_STUB->closure->frame); \
+            } \
             __CLOSURE_PTR = __CLOSURE_STUB->closure; \
             assert(__CLOSURE_STUB->cont_stub.cont == &__CLOSURE_PTR->cont); \
             if (!CLOSURE_IS_EMPTY(closure_ptr) && __CLOSURE_PTR != (void *)(closure_ptr)) { \
@@ -320,6 +437,7 @@ struct __ClosureEmpty { struct __Closure closure; struct { char end; } arg; };
         (closure_ptr)->closure.frame = (char *)malloc(CLOSURE_GET_STACK_FRAME_SIZE(&(closure_ptr)->closure)); \
         CONTINUATION_BACKUP_STACK_FRAME(&(closure_ptr)->closure.cont, (closure_ptr)->closure.frame); \
         __CLOSURE_INIT_VARS(&(closure_ptr)->closure); \
+        __CLOSURE_INIT_HOST(&(closure_ptr)->closure, &__CLOSURE__.stub.closure); \
         /* (closure_ptr)->closure.connected = 1; */ \
       } \
       if (__CLOSURE_PTR) { \
@@ -341,8 +459,9 @@ struct __ClosureEmpty { struct __Closure closure; struct { char end; } arg; };
  * @brief Internal help macro encloses continuation statements for CLOSURE_CONNECT().
  * @details Use C++ exception handle for return from middle of continuation.
  * @param continuation: the continuation statements of the closure.
+ * @see CONTINUATION_USE_EXCEPTION_RETURN
  */
-#ifdef __cplusplus
+#if CONTINUATION_USE_EXCEPTION_RETURN
   struct __ClosureException {};
   inline void __closure_return_by_throw() {
     throw __ClosureException();
@@ -364,8 +483,9 @@ struct __ClosureEmpty { struct __Closure closure; struct { char end; } arg; };
  * @details The execution of the closure continuation is terminated.
  * @warning Don't or be careful to use it in C++ with undelimited continuation for the unsafety longjmp().
  * @see CLOSURE_CONNECT()
+ * @see CONTINUATION_USE_EXCEPTION_RETURN
  */
-#ifdef __cplusplus
+#if CONTINUATION_USE_EXCEPTION_RETURN
 # define CLOSURE_RETURN() \
     (sizeof(__CLOSURE__) > sizeof(void *) ? (CLOSURE_COMMIT_RETAIN_VARS(), __closure_return_by_throw()) \
                                         : (CLOSURE_COMMIT_RETAIN_VARS(), CONTINUATION_STUB_RETURN(&__CLOSURE_STUB->cont_stub)))
@@ -383,7 +503,7 @@ struct __ClosureEmpty { struct __Closure closure; struct { char end; } arg; };
  * @see CLOSURE_RETURN()
  * @see CLOSURE_RETAIN_VAR()
  */
-#ifdef __cplusplus
+#if CONTINUATION_USE_EXCEPTION_RETURN
 # define CLOSURE_RETURN_NO_RETAIN() \
      (sizeof(__CLOSURE__) > sizeof(void *) ? CONTINUATION_RETURN(&__CLOSURE_STUB->cont_stub) \
                                          : CONTINUATION_STUB_RETURN(&__CLOSURE_STUB->cont_stub))
@@ -1466,9 +1586,44 @@ do { \
 #define CLOSURE_RUN_N(n, closure_ptr, tuple) \
 do { \
   CLOSURE_INIT_ARGS_N(n, closure_ptr, tuple); \
-  __closure_run(&(closure_ptr)->closure); \
+  __CLOSURE_RUN(&(closure_ptr)->closure); \
 } while (0)
 
+/** @cond */
+/**
+ * @internal
+ * @brief Internal help macro to CLOSURE_RUN_N().
+ * @details With CONTINUATION_USE_IN_PLACE_INVOKE, the continuation is entered directly
+ * if the closure is invoked by the activation of host function that connected it,
+ * so that it runs against the live stack frame without relocation.
+ * The stub of the invocation in place is allocated at the first time, the closure is relocated as usual if it fails.
+ * @param internal_closure: pointer to the internal closure structure, which is evaluated multiple times.
+ * @see CONTINUATION_USE_IN_PLACE_INVOKE
+ */
+#if CONTINUATION_USE_IN_PLACE_INVOKE
+# define __CLOSURE_RUN(internal_closure) \
+  do { \
+    if (__closure_is_in_place(internal_closure, CONTINUATION_FRAME_ADDRESS(), __func__) \
+        && __closure_in_place_stub(internal_closure) != NULL) { \
+      (internal_closure)->in_place = 1; \
+      (internal_closure)->in_place_stub->closure = (internal_closure); \
+      continuation_stub_init(&(internal_closure)->in_place_stub->cont_stub, &(internal_closure)->cont); \
+      /* the stack frame is the one of the host */ \
+      (internal_closure)->in_place_stub->cont_stub.addr.stack_frame_addr = (internal_closure)->cont.stack_frame_tail + (internal_closure)->cont.stack_frame_size; \
+      if (continuation_stub_setjmp((internal_closure)->in_place_stub->cont_stub.return_buf) == 0) { \
+        struct __ContinuationStub * volatile anti_optimize = &(internal_closure)->in_place_stub->cont_stub; \
+        CONTINUATION_STUB_INVOKE_IN_PLACE(anti_optimize); \
+      } \
+      (internal_closure)->in_place = 0; \
+    } else { \
+      __closure_run(internal_closure); \
+    } \
+  } while (0)
+#else
+# define __CLOSURE_RUN(internal_closure) __closure_run(internal_closure)
+#endif
+/** @endcond */
+
 /**
  * @copybrief CLOSURE_RUN_N()
  * 
@@ -1530,6 +1685,63 @@ do { \
 #define CLOSURE8_RUN(closure_ptr, v1, v2, v3, v4, v5, v6, v7, v8) CLOSURE_RUN_N(8, closure_ptr, (v1, v2, v3, v4, v5, v6, v7, v8))
 #define CLOSURE9_RUN(closure_ptr, v1, v2, v3, v4, v5, v6, v7, v8, v9) CLOSURE_RUN_N(9, closure_ptr, (v1, v2, v3, v4, v5, v6, v7, v8, v9))
 
+/** @cond */
+/**
+ * @internal
+ * @brief Internal help macro to CLOSURE_REF_RUN_N().
+ */
+#define __CLOSURE_INIT_REF_ARGS(z, n, closure_params) \
+  BOOST_PP_CAT((BOOST_PP_TUPLE_ELEM(2, 0, closure_params))->arg._, BOOST_PP_INC(n)) \
+  = \
+  __CLOSURE_REF_ADDR(BOOST_PP_SEQ_ELEM(n, BOOST_PP_TUPLE_ELEM(2, 1, closure_params)));
+#define __CLOSURE_REF_ADDR(value) &(value)
+/** @endcond */
+
+/**
+ * @brief Invoke a closure declared by CLOSURE_REF() with a number of parameters.
+ * @details The addresses of the parameters are passed to the closure rather than the values,
+ * so the parameters must be lvalues, which are accessed by the closure in place.
+ * @param n: the number of parameters.
+ * @param closure_ptr: pointer to the closure.
+ * @param tuple: BOOST preprocessor tuple contains parameters.
+ * 
+ * @warning \p closure_ptr is evaluated multiple times!
+ * @note The pointers in the closure argument are dangling after the invocation returns.
+ * 
+ * @see CLOSURE_REF_N()
+ * @see CLOSURE_REF_RUN()
+ */
+#define CLOSURE_REF_RUN_N(n, closure_ptr, tuple) \
+do { \
+  BOOST_PP_REPEAT(n, __CLOSURE_INIT_REF_ARGS, (closure_ptr, BOOST_PP_TUPLE_TO_SEQ(n, tuple))) \
+  __CLOSURE_RUN(&(closure_ptr)->closure); \
+} while (0)
+
+/**
+ * @copybrief CLOSURE_REF_RUN_N()
+ * 
+ * @details If variadic macros are available, the parameters in BOOST preprocessor tuple
+ * can be transefered directly without the number and tuple specification,
+ * or it is the alias to CLOSURE_REF_RUN_N() otherwise.
+ * 
+ * @param closure_ptr: pointer to the closure.
+ * @param ...: one ore more lvalues seperated by comma if BOOST_PP_VARIADICS isn't 0.
+ * 
+ * @warning \p closure_ptr is evaluated multiple times!
+ * 
+ * @see CLOSURE_REF_RUN_N()
+ */
+#define CLOSURE_REF_RUN(closure_ptr) /* Empty defintion for Doxygen */
+#undef CLOSURE_REF_RUN
+
+/** @cond */
+#if BOOST_PP_VARIADICS
+# define CLOSURE_REF_RUN(closure_ptr, ...) CLOSURE_REF_RUN_N(__PP_VARIADIC_SIZE_OR_ZERO(__VA_ARGS__), closure_ptr, BOOST_PP_VARIADIC_TO_TUPLE(__VA_ARGS__))
+#else
+# define CLOSURE_REF_RUN(n, closure_ptr, tuple) CLOSURE_REF_RUN_N(n, closure_ptr, tuple)
+#endif
+/** @endcond */
+
 /**
  * @brief Disconnect and free a closure.
  * @details If a closure is connected, it will be unconnected and the finalization statement of it will be executed,
@@ -1545,4 +1757,44 @@ do { \
  */
 #define closure_free(closure_ptr) CLOSURE_FREE(closure_ptr)
 
+/**
+ * @brief Connect a closure as a clone of a connected closure of the same type.
+ * @details The clone runs the statements of \p src_ptr without the deduction of the stack frame
+ * by CLOSURE_CONNECT(), and has its own copy of the backup stack frame and the retained variables,
+ * which start with the values of \p src_ptr at the moment. Either closure is freed independently.
+ * @param dst_ptr: pointer to the unconnected closure.
+ * @param src_ptr: pointer to the connected closure.
+ * @return 0 on success, or ENOMEM with \p dst_ptr left unconnected.
+ * @warning The statements get the parameters through the closure expression of CLOSURE_CONNECT(),
+ * where the parameters of the clone are copied to before the statements run, so the clones of
+ * a closure referred by a pointer in the host function must not run concurrently.
+ * @see CLOSURE_CONNECT()
+ * @see CLOSURE_FREE()
+ *
+ * @par Example:
+ * @code
+ *  CLOSURE1(int) handlers[16];
+ *  CLOSURE_INIT(&handlers[0]);
+ *  CLOSURE_CONNECT(&handlers[0]
+ *    , ()
+ *    , (
+ *      printf("%d\n", CLOSURE_ARG_OF_(&handlers[0])->_1);
+ *    )
+ *    , ()
+ *  );
+ *  for (i = 1; i < 16; ++i) {
+ *    CLOSURE_INIT(&handlers[i]);
+ *    if (CLOSURE_CLONE(&handlers[i], &handlers[0]) != 0) break;
+ *  }
+ * @endcode
+ */
+#define CLOSURE_CLONE(dst_ptr, src_ptr) \
+  ((void)STATIC_ASSERT_OR_ZERO(sizeof(*(dst_ptr)) == sizeof(*(src_ptr)), clone_closure_of_different_type) \
+    , __closure_clone(&(dst_ptr)->closure, &(src_ptr)->closure))
+
+/**
+ * @brief Alias to CLOSURE_CLONE().
+ */
+#define closure_clone(dst_ptr, src_ptr) CLOSURE_CLONE(dst_ptr, src_ptr)
+
 #endif /* CLOSURE_H */
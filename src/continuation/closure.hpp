@@ -0,0 +1,171 @@
+/*
+ * Copyright 2013, Zhou Zhenghui <zhouzhenghui@gmail.com>
+ */
+
+#ifndef __CLOSURE_HPP
+#define __CLOSURE_HPP
+
+/**
+ * @file
+ * @ingroup closure
+ * @brief The C++ template of closure.
+ * @details signalbus::closure is a typed wrapper of the closure structure, whose parameter types
+ * are given by a template parameter pack instead of the Boost preprocessor tuples of CLOSURE_N().
+ * The arity is a compile time constant, so the invocation is specialized for each closure type
+ * and takes no runtime branch on the presence of parameters.
+ *
+ * The parameters are passed by the addresses of the parameters of the invocation instead of copies,
+ * so that move-only types are supported and the continuation forwards them as they are declared,
+ * e.g. a parameter declared as a value type is handed to the continuation as an rvalue reference.
+ *
+ * The underlying closure structure returned by signalbus::closure::native() is connected by CLOSURE_CONNECT()
+ * as usual, and the continuation gets the parameters by signalbus::closure::arg().
+ *
+ * @par Example:
+ * @code
+ *  signalbus::closure<std::string, std::unique_ptr<Order> > on_order;
+ *  CLOSURE_CONNECT(on_order.native()
+ *    , ()
+ *    , (
+ *      std::unique_ptr<Order> order = on_order.arg<1>();
+ *      book.add(on_order.arg<0>(), std::move(order));
+ *    )
+ *    , ()
+ *  );
+ *  on_order("EURUSD", std::unique_ptr<Order>(new Order()));
+ * @endcode
+ */
+
+#if !defined(__cplusplus) || __cplusplus < 201103L
+# error "signalbus::closure requires C++11"
+#endif
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "closure.h"
+
+namespace signalbus {
+
+/** @cond */
+namespace detail {
+  /**
+   * @internal
+   * @brief The argument of the underlying closure structure, which holds the addresses of the parameters.
+   */
+  template <typename... Args>
+  struct closure_args {
+    void *addr[sizeof...(Args)];
+    char end; /* for CLOSURE_IS_EMPTY() */
+  };
+
+  template <>
+  struct closure_args<> {
+    char end;
+  };
+
+  /**
+   * @internal
+   * @brief The underlying closure structure of the same layout as CLOSURE_N().
+   */
+  template <typename... Args>
+  struct closure_native {
+    struct __Closure closure;
+    closure_args<Args...> arg;
+  };
+
+  template <typename T>
+  inline void *closure_addr(T &value)
+  {
+    return const_cast<void *>(static_cast<const volatile void *>(std::addressof(value)));
+  }
+} /* namespace detail */
+/** @endcond */
+
+/**
+ * @brief The closure template of parameter types \p Args.
+ * @details A parameter type can be a value type, an lvalue reference or an rvalue reference type.
+ * @note The closure is neither copyable nor movable, since the continuation refers to it by address.
+ * @see CLOSURE_N()
+ */
+template <typename... Args>
+class closure {
+public:
+  /** @brief The underlying closure structure, which is compatible with the CLOSURE_* macros. */
+  typedef detail::closure_native<Args...> native_type;
+
+  /** @brief Number of the parameters. */
+  static const std::size_t arity = sizeof...(Args);
+
+  /** @brief Type of the parameter of index \p I. */
+  template <std::size_t I>
+  struct arg_type {
+    typedef typename std::tuple_element<I, std::tuple<Args...> >::type type;
+  };
+
+  /** @brief Initialize the closure as unconnected. */
+  closure() { __closure_init(&native_.closure); }
+  /** @brief Disconnect and free the closure. */
+  ~closure() { __closure_free(&native_.closure); }
+
+  closure(const closure &) = delete;
+  closure &operator=(const closure &) = delete;
+
+  /**
+   * @brief Get the underlying closure structure to connect by CLOSURE_CONNECT().
+   */
+  native_type *native() { return &native_; }
+
+  /** @brief Determine whether the closure is connected. */
+  bool connected() const { return native_.closure.connected != 0; }
+
+  /**
+   * @brief Disconnect and free the closure before destruction.
+   * @see CLOSURE_FREE()
+   */
+  void free() { __closure_free(&native_.closure); }
+
+  /**
+   * @brief Invoke the closure.
+   * @details The value parameters are constructed by the caller, so rvalues are moved in once
+   * and never copied again.
+   */
+  void operator()(Args... args)
+  {
+    invoke(std::integral_constant<bool, arity == 0>(), args...);
+  }
+
+  /**
+   * @brief Get the parameter of index \p I within the continuation.
+   * @return reference to the parameter forwarded as its declared type.
+   * @warning It is valid only during the invocation.
+   */
+  template <std::size_t I>
+  typename arg_type<I>::type &&arg()
+  {
+    typedef typename arg_type<I>::type type;
+    return std::forward<type>(*static_cast<typename std::remove_reference<type>::type *>(native_.arg.addr[I]));
+  }
+
+private:
+  void invoke(std::true_type)
+  {
+    __closure_run(&native_.closure);
+  }
+
+  void invoke(std::false_type, typename std::remove_reference<Args>::type &... args)
+  {
+    void *addr[arity] = {detail::closure_addr(args)...};
+    std::memcpy(native_.arg.addr, addr, sizeof(addr));
+    __closure_run(&native_.closure);
+  }
+
+  native_type native_;
+};
+
+} /* namespace signalbus */
+
+#endif /* __CLOSURE_HPP */
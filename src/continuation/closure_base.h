@@ -12,6 +12,7 @@
  */
 
 #include "continuation_base.h"
+#include <errno.h>
 #include <boost/preprocessor/inc.hpp>
 #include <boost/preprocessor/cat.hpp>
 #include <boost/preprocessor/seq.hpp>
@@ -52,34 +53,48 @@ typedef VECTOR(struct __ClosureVar) __ClosureVarVector;
  */
 typedef VECTOR(struct __ClosureVarDebug) __ClosureVarDebugVector;
 
+struct __Closure;
+
+/**
+ * @internal
+ * @brief The stub structure for invoking a closure.
+ */
+struct __ClosureStub {
+  struct __ContinuationStub cont_stub; /**< the continuation stub. */
+  struct __Closure *closure; /**< pointer to the closure. */
+};
+
 /**
  * @internal
  * @brief The closure structure.
  * @details It is the underlying structure of CLOSURE().
+ * The fields read by every invocation precede the continuation to be adjacent to its hot fields,
+ * and the parameters of CLOSURE_N() follow closely. The stub of the invocation in place holds a jmp_buf,
+ * it is allocated apart not to push the parameters away.
  * @see CLOSURE()
  */
 struct __Closure {
-  struct __Continuation cont; /**< the continuation structure of closure. */
   int connected; /**< indicates the closure is connected or not. */
+  char *frame; /**< storage for backup stack frame of continuation. */
 #ifdef CLOSURE_DEBUG
   __ClosureVarDebugVector argv;
 #else
   __ClosureVarVector argv;
 #endif /**< array of captured variables. */
-  char *frame; /**< storage for backup stack frame of continuation. */
-};
-
-/**
- * @internal
- * @brief The stub structure for invoking a closure.
- */
-struct __ClosureStub {
-  struct __ContinuationStub cont_stub; /**< the continuation stub. */
-  struct __Closure *closure; /**< pointer to the closure. */
+  struct __Continuation cont; /**< the continuation structure of closure. */
+  /* the fields of in place invocation are kept regardless of CONTINUATION_USE_IN_PLACE_INVOKE,
+   * so that the layout is the same to the translation units compiled with or without it */
+  const char *host_frame; /**< frame address of the activation of host function that connected the closure. */
+  const char *host_func; /**< name of the host function. */
+  struct __Closure * const *host_mark; /**< a slot in the stack frame of host function which points to the closure while the activation is alive. */
+  int in_place; /**< the closure is running in place. */
+  struct __ClosureStub *in_place_stub; /**< the stub of the invocation in place, allocated at the first one. */
 };
 
 /** @cond */
 STATIC_ASSERT(offsetof(struct __ClosureStub, cont_stub) == 0, internal_constraint_of_struct_ClosureStub_failed);
+STATIC_ASSERT(offsetof(struct __Closure, cont) + offsetof(struct __Continuation, initialized) + sizeof(int) <= 2 * CONTINUATION_CACHE_LINE_SIZE
+              , hot_fields_of_struct_Closure_exceed_two_cache_lines);
 /** @endcond */
 
 /**
@@ -124,6 +139,16 @@ extern "C" {
    * @brief Internal help function to CLOSURE_CONNECT().
    */
   extern void __closure_commit_vars_debug(__ClosureVarDebugVector *argv, size_t stack_frame_offset, const char *file, unsigned int line);
+  /**
+   * @internal
+   * @brief Internal help function to CLOSURE_CONNECT().
+   */
+  extern void __closure_restore_vars(__ClosureVarVector *argv, size_t stack_frame_offset);
+  /**
+   * @internal
+   * @brief Internal help function to CLOSURE_CONNECT().
+   */
+  extern void __closure_restore_vars_debug(__ClosureVarDebugVector *argv, size_t stack_frame_offset);
 #ifdef __cplusplus
 }
 #endif
@@ -142,6 +167,40 @@ inline static void __closure_run(struct __Closure *closure)
   }
 }
 
+#if CONTINUATION_USE_IN_PLACE_INVOKE
+/**
+ * @internal
+ * @brief Determine whether a closure can run in place of the caller.
+ * @details The caller must be the activation of host function that connected the closure,
+ * which is identified by the frame address, the function and the mark slot still pointing to the closure.
+ * @param closure: pointer to the closure.
+ * @param frame: frame address of the caller.
+ * @param func: name of the caller function.
+ * @see CONTINUATION_USE_IN_PLACE_INVOKE
+ */
+inline static int __closure_is_in_place(const struct __Closure *closure, const char *frame, const char *func)
+{
+  return closure->connected && !closure->in_place
+      && closure->host_frame == frame && closure->host_func == func
+      && *closure->host_mark == closure;
+}
+
+/**
+ * @internal
+ * @brief Get the stub of the invocation in place of a closure, which is allocated at the first time.
+ * @param closure: pointer to the closure.
+ * @return pointer to the stub, or NULL if it fails to be allocated.
+ * @see CONTINUATION_USE_IN_PLACE_INVOKE
+ */
+inline static struct __ClosureStub *__closure_in_place_stub(struct __Closure *closure)
+{
+  if (closure->in_place_stub == NULL) {
+    closure->in_place_stub = (struct __ClosureStub *)malloc(sizeof(struct __ClosureStub));
+  }
+  return closure->in_place_stub;
+}
+#endif
+
 /**
  * @internal
  * @brief Free a closure.
@@ -163,7 +222,69 @@ inline static void __closure_free(struct __Closure *closure)
     CONTINUATION_DESTRUCT(&closure->cont);
     VECTOR_FREE(&closure->argv);
     free(closure->frame);
+    free(closure->in_place_stub);
+    closure->in_place_stub = NULL;
+  }
+}
+
+/**
+ * @internal
+ * @brief Clone a connected closure.
+ * @details It is the underlying function of CLOSURE_CLONE().
+ * The continuation deduced at the connection of \p src is copied as it is,
+ * and the backup stack frame and the retained variables are duplicated.
+ * @param dst: pointer to the unconnected closure.
+ * @param src: pointer to the connected closure.
+ * @return 0 on success, or ENOMEM with \p dst left unconnected.
+ * @warning It is defined in header for the layout of retained variables depends on CLOSURE_DEBUG.
+ * @see CLOSURE_CLONE()
+ */
+inline static int __closure_clone(struct __Closure *dst, const struct __Closure *src)
+{
+  size_t i, argc = VECTOR_SIZE(&src->argv);
+  char *frame;
+  jmp_buf *invoke_buf = NULL;
+  assert(src->connected && "the closure to clone is not connected");
+  assert(!dst->connected && "the closure had been connected");
+  frame = (char *)malloc(src->cont.stack_frame_size);
+  if (frame == NULL) return ENOMEM;
+  if (src->cont.invoke_buf != NULL) {
+    /* the jmp_buf of the longjmp() implementation is owned by each continuation */
+    invoke_buf = (jmp_buf *)malloc(sizeof(jmp_buf));
+    if (invoke_buf == NULL) {
+      free(frame);
+      return ENOMEM;
+    }
+    memcpy(invoke_buf, src->cont.invoke_buf, sizeof(jmp_buf));
+  }
+  VECTOR_INIT(&dst->argv);
+  if (argc) {
+    /* allocated as a whole to check the failure, which the vector macros don't report */
+    struct __Vector *argv = (struct __Vector *)&dst->argv;
+    argv->item = malloc(argc * sizeof(VECTOR_ITEM(&src->argv, 0)));
+    if (argv->item == NULL) {
+      free(invoke_buf);
+      free(frame);
+      return ENOMEM;
+    }
+    memcpy(argv->item, VECTOR_ADDR(&src->argv), argc * sizeof(VECTOR_ITEM(&src->argv, 0)));
+    argv->size = argv->alloc = argc;
+  }
+  dst->cont = src->cont;
+  dst->cont.invoke_buf = invoke_buf;
+  dst->frame = frame;
+  continuation_copy_frame(&src->cont, dst->frame, src->frame);
+  for (i = 0; i < VECTOR_SIZE(&dst->argv); ++i) {
+    VECTOR_ITEM(&dst->argv, i).value = dst->frame + ((char *)VECTOR_ITEM(&src->argv, i).value - src->frame);
   }
+  /* the mark in the host frame never points to the clone */
+  dst->host_frame = src->host_frame;
+  dst->host_func = src->host_func;
+  dst->host_mark = src->host_mark;
+  dst->in_place = 0;
+  dst->in_place_stub = NULL;
+  dst->connected = 1;
+  return 0;
 }
 
 #endif /* __CLOSURE_BASE_H */
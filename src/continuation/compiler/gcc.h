@@ -53,7 +53,7 @@
         if (((struct __ContinuationStub *)cont_stub)->cont->func_addr) goto BOOST_PP_CAT(LABEL_CONTINUATION_ENTRY_END_, __LINE__); \
         else { \
           /* Clobber registers using pretend setjmp */ \
-          if (setjmp(((struct __ContinuationStub *)cont_stub)->cont->invoke_buf) == 0) goto BOOST_PP_CAT(LABEL_CONTINUATION_ENTRY_END_, __LINE__); \
+          if (setjmp(__continuation_clobber_buf) == 0) goto BOOST_PP_CAT(LABEL_CONTINUATION_ENTRY_END_, __LINE__); \
         } \
         BOOST_PP_CAT(LABEL_CONTINUATION_ENTRY_BEGIN_, __LINE__): \
         { \
@@ -90,7 +90,7 @@
         if (((struct __ContinuationStub *)cont_stub)->cont->func_addr) goto BOOST_PP_CAT(LABEL_CONTINUATION_ENTRY_END_, __LINE__); \
         else { \
           /* Clobber registers using pretend setjmp */ \
-          if (setjmp(((struct __ContinuationStub *)cont_stub)->cont->invoke_buf) == 0) goto BOOST_PP_CAT(LABEL_CONTINUATION_ENTRY_END_, __LINE__); \
+          if (setjmp(__continuation_clobber_buf) == 0) goto BOOST_PP_CAT(LABEL_CONTINUATION_ENTRY_END_, __LINE__); \
         } \
         BOOST_PP_CAT(LABEL_CONTINUATION_ENTRY_BEGIN_, __LINE__): \
         { \
@@ -129,7 +129,7 @@
         if (((struct __ContinuationStub *)cont_stub)->cont->func_addr) goto BOOST_PP_CAT(LABEL_CONTINUATION_ENTRY_END_, __LINE__); \
         else { \
           /* Clobber registers using pretend setjmp */ \
-          if (setjmp(((struct __ContinuationStub *)cont_stub)->cont->invoke_buf) == 0) goto BOOST_PP_CAT(LABEL_CONTINUATION_ENTRY_END_, __LINE__); \
+          if (setjmp(__continuation_clobber_buf) == 0) goto BOOST_PP_CAT(LABEL_CONTINUATION_ENTRY_END_, __LINE__); \
         } \
         BOOST_PP_CAT(LABEL_CONTINUATION_ENTRY_BEGIN_, __LINE__): \
         { \
@@ -192,6 +192,25 @@
 #endif
 /** @endcond */
 
+/**
+ * @brief Get the frame address of the current function under GCC compiler.
+ * @see CONTINUATION_USE_IN_PLACE_INVOKE
+ */
+#define CONTINUATION_FRAME_ADDRESS() ((char *)__builtin_frame_address(0))
+
+/**
+ * @brief Invoke a continuation within the activation of its host function under GCC compiler.
+ * @details The computed goto is never reached, but it tells the compiler that the continuation
+ * may be entered from here, so that the variables of the continuation are kept in the stack frame
+ * and do not share the stack slots with those alive at the invocation.
+ * @see CONTINUATION_USE_IN_PLACE_INVOKE
+ */
+#define CONTINUATION_STUB_INVOKE_IN_PLACE(cont_stub) \
+  do { \
+    CONTINUATION_STUB_INVOKE(cont_stub); \
+    goto *((struct __ContinuationStub *)(cont_stub))->cont->func_addr; \
+  } while (0)
+
 #if __GNUC__ > 2 || __GNUC_MINOR__ >= 9
 # if !defined(CONTINUATION_USE_C99_VLA) && !defined(__STRICT_ANSI__)
 /**
@@ -17,6 +17,7 @@
  */
 
 #include <setjmp.h>
+#include <stdlib.h>
 #if HAVE_MEMORY_H
 # include <memory.h>
 #endif
@@ -254,6 +255,34 @@ extern "C" {
 # define CONTINUATION_STUB_INVOKE(cont_stub) /* Empty defintion for doxygen */
 # undef CONTINUATION_STUB_INVOKE
 
+/**
+ * @internal
+ * @brief Allocate the jmp_buf of the entry point of a continuation if it is not yet.
+ * @details The jmp_buf is about 200 bytes and only read when the continuation is invoked,
+ * it is kept out of struct __Continuation not to spread the hot fields of the closures.
+ * @param cont: pointer to the continuation.
+ * @see CONTINUATION_DESTRUCT()
+ */
+# define __CONTINUATION_ALLOC_INVOKE_BUF(cont) /* Empty defintion for doxygen */
+# undef __CONTINUATION_ALLOC_INVOKE_BUF
+
+/** @cond */
+# define __CONTINUATION_ALLOC_INVOKE_BUF(cont) \
+  do { \
+    if ((cont)->invoke_buf == NULL) { \
+      (cont)->invoke_buf = (jmp_buf *)malloc(sizeof(jmp_buf)); \
+      assert((cont)->invoke_buf != NULL && "[CONTINUATION FAULT] failed to allocate the jmp_buf of continuation"); \
+    } \
+  } while (0)
+# ifndef CONTINUATION_DESTRUCT
+#   define CONTINUATION_DESTRUCT(cont) \
+  do { \
+    free((cont)->invoke_buf); \
+    (cont)->invoke_buf = NULL; \
+  } while (0)
+# endif
+/** @endcond */
+
 /** @cond */
 # if HAVE_PTHREAD
 #   define CONTINUATION_STUB_ENTRY(cont_stub) \
@@ -262,9 +291,10 @@ extern "C" {
       pthread_once(&__continuation_pthread_jmpcode.once, __continuation_pthread_init_jmpcode); \
       __continuation_pthread_jmpcode.initialized = 1; \
     } \
+    __CONTINUATION_ALLOC_INVOKE_BUF(((struct __ContinuationStub *)cont_stub)->cont); \
     { \
       int __continuation_addr__; \
-      __continuation_addr__ = setjmp(((struct __ContinuationStub *)cont_stub)->cont->invoke_buf); \
+      __continuation_addr__ = setjmp(*((struct __ContinuationStub *)cont_stub)->cont->invoke_buf); \
       if (__continuation_addr__) { \
         *((void **)&cont_stub) = pthread_getspecific(__continuation_pthread_jmpcode.address_key); \
       } \
@@ -274,7 +304,7 @@ extern "C" {
   do { \
     jmp_buf __continuation_env__; \
     jmp_buf __continuation_jmp__; \
-    memcpy(&__continuation_jmp__, &(cont_stub)->cont->invoke_buf, sizeof(jmp_buf)); \
+    memcpy(&__continuation_jmp__, ((struct __ContinuationStub *)(cont_stub))->cont->invoke_buf, sizeof(jmp_buf)); \
     if (setjmp(__continuation_env__) == 0) { \
       __continuation_patch_jmpbuf(__continuation_pthread_jmpcode.indexes, &__continuation_jmp__, &__continuation_env__); \
       pthread_setspecific(__continuation_pthread_jmpcode.address_key, cont_stub); \
@@ -288,12 +318,13 @@ extern "C" {
       __continuation_init_jmpcode(); \
       __continuation_jmpcode.initialized = 1; \
     } \
+    __CONTINUATION_ALLOC_INVOKE_BUF(((struct __ContinuationStub *)cont_stub)->cont); \
     { \
       union { \
         int i; \
         int Fixme_for_unknown_platform_that_sizeof_pointer_is_not_equal_to_int : !!(sizeof(cont_stub) == sizeof(int)); \
       } __continuation_addr__; \
-      __continuation_addr__.i = setjmp(((struct __ContinuationStub *)cont_stub)->cont->invoke_buf); \
+      __continuation_addr__.i = setjmp(*((struct __ContinuationStub *)cont_stub)->cont->invoke_buf); \
       if (__continuation_addr__.i) { \
         *((struct __ContinuationStub **)&cont_stub) = (struct __ContinuationStub *)__continuation_addr__.i; \
       } \
@@ -303,7 +334,7 @@ extern "C" {
   do { \
     jmp_buf __continuation_env__; \
     jmp_buf __continuation_jmp__; \
-    memcpy(&__continuation_jmp__, &(cont_stub)->cont->invoke_buf, sizeof(jmp_buf)); \
+    memcpy(&__continuation_jmp__, ((struct __ContinuationStub *)(cont_stub))->cont->invoke_buf, sizeof(jmp_buf)); \
     if (setjmp(__continuation_env__) == 0) { \
       union { \
         int i; \
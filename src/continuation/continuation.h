@@ -185,8 +185,9 @@
  * @brief Internal help macro encloses continuation statements for CONTINUATION_CONNECT()
  * @details Use C++ exception handle for return from middle of continuation.
  * @param continuation: the continuation statements.
+ * @see CONTINUATION_USE_EXCEPTION_RETURN
  */
-#ifdef __cplusplus
+#if CONTINUATION_USE_EXCEPTION_RETURN
   struct __ContinuationException {};
   inline void continuation_return_by_throw() {
     throw __ContinuationException();
@@ -216,8 +217,9 @@
  * @warning Don't or be careful to use it in C++ with undelimited continuation for the unsafety longjmp().
  * 
  * @see CONTINUATION_CONNECT()
+ * @see CONTINUATION_USE_EXCEPTION_RETURN
  */
-#ifdef __cplusplus
+#if CONTINUATION_USE_EXCEPTION_RETURN
 # define CONTINUATION_RETURN(cont_stub) \
     continuation_return_by_throw()
 #else
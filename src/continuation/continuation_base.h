@@ -17,26 +17,42 @@
 
 struct __ContinuationStub;
 
+/**
+ * @brief Type of the routines to copy a stack frame, which is compatible with memcpy().
+ * @see continuation_select_frame_copy()
+ */
+typedef void *(*ContinuationFrameCopy)(void *dst, const void *src, size_t size);
+
 /**
  * @internal
  * @brief Structure type represents a captured continuation.
+ * @details The fields read by every invocation come first to share a cache line.
+ * The jmp_buf of the longjmp() implementation of the invocation is allocated apart
+ * behind \p invoke_buf, the compiler configurations jump to \p func_addr instead and leave it NULL.
+ * The pointer is declared regardless of the configuration, so that the layout is the same to all translation units.
  * 
  * @see struct __ContinuationStub()
  * @see CONTINUATION_CONNECT()
  */
 struct __Continuation {
-  int initialized; /**< is the continuation connected or not. */
-  char *stack_frame_addr; /**< minimal address of stack frame. */
-  const char *stack_frame_spot; /**< an anchor address in the stack frame. */
+  void(*invoke)(struct __ContinuationStub *); /**< pointer to the invocation stub of the continuation. */
+  void *func_addr; /**< entry address of the continuation. */
   char *stack_frame_tail; /**< tail/maximum address of stack frame. */
   size_t stack_frame_size; /**< size of the stack frame. */
+  ContinuationFrameCopy copy_frame; /**< the routine to copy the stack frame, selected at the first copy. */
+  const char *stack_frame_spot; /**< an anchor address in the stack frame. */
   size_t stack_parameters_size; /**< parameters size of the host function. */
+  int initialized; /**< is the continuation connected or not. */
+  char *stack_frame_addr; /**< minimal address of stack frame. */
   size_t offset_to_frame_tail; /**< maximum offset of any addresses in the stack frame to the \p stack_frame_tail. */
-  void(*invoke)(struct __ContinuationStub *); /**< pointer to the invocation stub of the continuation. */
-  void *func_addr; /**< entry address of the continuation. */
-  jmp_buf invoke_buf; /**< jmp_buf for longjmp() of the continuation. */
+  jmp_buf *invoke_buf; /**< jmp_buf for longjmp() of the continuation, allocated at the connection. */
 };
 
+/** @cond */
+STATIC_ASSERT(offsetof(struct __Continuation, initialized) + sizeof(int) <= CONTINUATION_CACHE_LINE_SIZE
+              , hot_fields_of_struct_Continuation_exceed_a_cache_line);
+/** @endcond */
+
 /**
  * @internal
  * @brief Structure type represents a continuation when it is invoked.
@@ -82,6 +98,15 @@ void continuation_stub_return(struct __ContinuationStub *cont_stub)
 __attribute__((__noreturn__))
 #endif
 ;
+/**
+ * @brief Release the invoke stack of the calling thread.
+ * @details If the library is compiled with CONTINUATION_USE_INVOKE_STACK, the stack
+ * is released when the thread exits under pthread, otherwise it should be called
+ * before a thread exits. It does nothing without CONTINUATION_USE_INVOKE_STACK.
+ *
+ * @see CONTINUATION_USE_INVOKE_STACK
+ */
+void continuation_invoke_stack_free(void);
 #ifdef __cplusplus
 }
 #endif
@@ -103,6 +128,8 @@ inline static void continuation_init(struct __Continuation *cont, const void *st
   cont->stack_parameters_size = CONTINUATION_STACK_PARAMETERS_SIZE;
   cont->stack_frame_spot = (const char *)stack_frame_spot;
   cont->invoke = NULL;
+  cont->copy_frame = NULL;
+  cont->invoke_buf = NULL;
 }
 
 /**
@@ -146,6 +173,13 @@ static void __continuation_init_invoke_return(struct __ContinuationStub *cont_st
  */
 extern void (*__continuation_enforce_var)(char * volatile);
 
+/**
+ * @internal
+ * @brief The jmp_buf of the pretended setjmp() clobbering the registers at the entry of continuations.
+ * @details It is never jumped to, so all of the continuations share it.
+ */
+extern jmp_buf __continuation_clobber_buf;
+
 /**
  * @internal
  * @brief Internal helper for continuation invoking.
@@ -190,8 +224,42 @@ extern void *(*__continuation_init_frame_tail)(void *, void *);
  * @see CONTINUATION_BACKUP_STACK_FRAME()
  */
 extern struct __ContinuationStub *(*continuation_restore_stack_frame)(const struct __ContinuationStub *cont_stub, void *stack_frame);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**
+ * @brief Select the routine to copy a stack frame.
+ * @details The kernels of the size classes are selected by the features of the processor
+ * at the first call in the process.
+ * @param size: size of the stack frame.
+ * @return the routine to copy exactly \p size bytes of the stack frame.
+ * @see CONTINUATION_USE_VECTOR_FRAME_COPY
+ */
+extern ContinuationFrameCopy continuation_select_frame_copy(size_t size);
+#ifdef __cplusplus
+}
+#endif
 /** @} */
 
+/**
+ * @brief Copy the stack frame of a continuation between non-overlapping storages.
+ * @details The routine selected for the size of the stack frame is cached in the continuation.
+ *
+ * @param cont: pointer to the continuation.
+ * @param dst: pointer to the destination.
+ * @param src: pointer to the source.
+ */
+inline static void continuation_copy_frame(const struct __Continuation *cont, void *dst, const void *src)
+{
+  ContinuationFrameCopy copy_frame = cont->copy_frame;
+  if (copy_frame == NULL) {
+    copy_frame = continuation_select_frame_copy(cont->stack_frame_size);
+    ((struct __Continuation *)cont)->copy_frame = copy_frame;
+  }
+  copy_frame(dst, src, cont->stack_frame_size);
+}
+
 /**
  * @brief Help function to CONTINUATION_BACKUP_STACK_FRAME().
  * @details Copy the stack frame of a continuation to the backup storage.
@@ -207,7 +275,7 @@ extern struct __ContinuationStub *(*continuation_restore_stack_frame)(const stru
  */
 inline static void continuation_backup_stack_frame(const struct __Continuation *cont, void *stack_frame)
 {
-  memcpy(stack_frame, cont->stack_frame_tail, cont->stack_frame_size);
+  continuation_copy_frame(cont, stack_frame, cont->stack_frame_tail);
 }
 
 /**
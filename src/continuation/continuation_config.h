@@ -163,6 +163,131 @@
 # undef CONTINUATION_STACK_BLOCK_SIZE
 #endif
 
+/**
+ * @def CONTINUATION_USE_FIBER
+ * @brief Whether the blocks spawned to a scheduler run on stackful fibers?
+ * @details A fiber owns a pooled stack and is switched by swapping registers,
+ * so that the spawned block can yield in the middle and be resumed later,
+ * while the stack frame of host function is only copied once.
+ * @see fiber
+ * @see ASYNC_YIELD()
+ */
+#ifndef CONTINUATION_USE_FIBER
+# define CONTINUATION_USE_FIBER /* Empty definition for Doxygen */
+# undef CONTINUATION_USE_FIBER
+#endif
+
+/**
+ * @def CONTINUATION_FIBER_STACK_SIZE
+ * @brief Default size of the stack of a fiber, not including the guard page.
+ */
+#ifndef CONTINUATION_FIBER_STACK_SIZE
+# define CONTINUATION_FIBER_STACK_SIZE /* Empty definition for Doxygen */
+# undef CONTINUATION_FIBER_STACK_SIZE
+#endif
+
+/**
+ * @def CONTINUATION_USE_INVOKE_STACK
+ * @brief Whether the continuations are invoked on a pre-allocated stack of each thread?
+ * @details The stack frame of a continuation is relocated to the top of a dedicated
+ * stack, where the space for the frame and the parameters is always available,
+ * instead of extending the stack of caller before the invocation.
+ * It applies when the library is compiled, and the stacks come from the fiber stack pool.
+ * @see continuation_invoke_stack_free()
+ * @see fiber
+ */
+#ifndef CONTINUATION_USE_INVOKE_STACK
+# define CONTINUATION_USE_INVOKE_STACK /* Empty definition for Doxygen */
+# undef CONTINUATION_USE_INVOKE_STACK
+#endif
+
+/**
+ * @def CONTINUATION_USE_IN_PLACE_INVOKE
+ * @brief Whether a closure invoked by its host function runs against the live stack frame?
+ * @details When CLOSURE_RUN() is called in the same activation of the host function
+ * that connected the closure, the stack frame to be relocated is still on the stack.
+ * The continuation is then entered with the stack frame of the host itself,
+ * neither the backup stack frame is restored nor the frame is relocated,
+ * only the retained variables are copied in and committed back.
+ *
+ * It requires CONTINUATION_FRAME_ADDRESS() and CONTINUATION_STUB_INVOKE_IN_PLACE()
+ * of the compiler config.
+ *
+ * @warning The continuation sees the current values of the variables of the host function
+ * instead of those at the moment of connection. The variables declared in the initialization
+ * statements are undefined in place unless they are retained by CLOSURE_RETAIN_VAR().
+ * @see CLOSURE_RUN()
+ */
+#ifndef CONTINUATION_USE_IN_PLACE_INVOKE
+# define CONTINUATION_USE_IN_PLACE_INVOKE /* Empty definition for Doxygen */
+# undef CONTINUATION_USE_IN_PLACE_INVOKE
+#endif
+
+/**
+ * @def CONTINUATION_USE_EXCEPTION_RETURN
+ * @brief Whether the early return from a continuation or a closure throws a C++ exception?
+ * @details With the exception, CONTINUATION_RETURN() and CLOSURE_RETURN() unwind the continuation
+ * statements, so the destructors of the objects declared within them are called.
+ * It costs a throw per early return and the exception handling around every continuation.
+ *
+ * Define it to 0 to return with longjmp() as in C instead, when the continuation statements
+ * declare no object with a destructor across the early returns.
+ *
+ * It is 1 by default in C++ with exceptions enabled, and always 0 otherwise.
+ * @see CONTINUATION_RETURN()
+ * @see CLOSURE_RETURN()
+ */
+#ifndef CONTINUATION_USE_EXCEPTION_RETURN
+# define CONTINUATION_USE_EXCEPTION_RETURN /* Empty definition for Doxygen */
+# undef CONTINUATION_USE_EXCEPTION_RETURN
+#endif
+
+/**
+ * @def CONTINUATION_CACHE_LINE_SIZE
+ * @brief Size of a cache line, by which the fields read by the invocations are laid out.
+ */
+#ifndef CONTINUATION_CACHE_LINE_SIZE
+# define CONTINUATION_CACHE_LINE_SIZE /* Empty definition for Doxygen */
+# undef CONTINUATION_CACHE_LINE_SIZE
+#endif
+
+/**
+ * @def CONTINUATION_USE_VECTOR_FRAME_COPY
+ * @brief Whether the stack frames are copied by the vectorized kernels?
+ * @details The SSE2, AVX2 or AVX-512 kernels are selected by the processor features once
+ * per process, and each continuation caches the kernel for the size class of its stack frame.
+ * It applies when the library is compiled, and defaults to 1 on x86 with GCC or clang.
+ * @see continuation_select_frame_copy()
+ */
+#ifndef CONTINUATION_USE_VECTOR_FRAME_COPY
+# define CONTINUATION_USE_VECTOR_FRAME_COPY /* Empty definition for Doxygen */
+# undef CONTINUATION_USE_VECTOR_FRAME_COPY
+#endif
+
+/**
+ * @def CONTINUATION_FRAME_ADDRESS()
+ * @brief Get an address identifies the stack frame of the current function.
+ * @details It must be the same at any point of a function activation.
+ * @see CONTINUATION_USE_IN_PLACE_INVOKE
+ */
+#ifndef CONTINUATION_FRAME_ADDRESS
+# define CONTINUATION_FRAME_ADDRESS() /* Empty definition for Doxygen */
+# undef CONTINUATION_FRAME_ADDRESS
+#endif
+
+/**
+ * @def CONTINUATION_STUB_INVOKE_IN_PLACE(cont_stub)
+ * @brief Invoke a continuation within the activation of its host function.
+ * @details Like CONTINUATION_STUB_INVOKE(), but the compiler must be aware of
+ * the continuation being entered with the current stack frame.
+ * @param cont_stub: pointer to the continuation stub.
+ * @see CONTINUATION_USE_IN_PLACE_INVOKE
+ */
+#ifndef CONTINUATION_STUB_INVOKE_IN_PLACE
+# define CONTINUATION_STUB_INVOKE_IN_PLACE(cont_stub) /* Empty definition for Doxygen */
+# undef CONTINUATION_STUB_INVOKE_IN_PLACE
+#endif
+
 /**
  * @internal
  * @def continuation_stub_setjmp
@@ -291,6 +416,55 @@
 # define CONTINUATION_STACK_BLOCK_SIZE 1024
 #endif
 
+#ifndef CONTINUATION_USE_FIBER
+# define CONTINUATION_USE_FIBER 0
+#endif
+
+#ifndef CONTINUATION_FIBER_STACK_SIZE
+# define CONTINUATION_FIBER_STACK_SIZE (256 * 1024)
+#endif
+
+#ifndef CONTINUATION_USE_INVOKE_STACK
+# define CONTINUATION_USE_INVOKE_STACK 0
+#endif
+
+/* in place invocation needs to identify and enter the stack frame of the host function */
+#if !defined(CONTINUATION_USE_IN_PLACE_INVOKE) || !defined(CONTINUATION_FRAME_ADDRESS) || !defined(CONTINUATION_STUB_INVOKE_IN_PLACE)
+# undef CONTINUATION_USE_IN_PLACE_INVOKE
+# define CONTINUATION_USE_IN_PLACE_INVOKE 0
+#endif
+
+#if !defined(__cplusplus) || !(defined(__cpp_exceptions) || defined(__EXCEPTIONS) || defined(_CPPUNWIND))
+# undef CONTINUATION_USE_EXCEPTION_RETURN
+# define CONTINUATION_USE_EXCEPTION_RETURN 0
+#elif !defined(CONTINUATION_USE_EXCEPTION_RETURN)
+# define CONTINUATION_USE_EXCEPTION_RETURN 1
+#endif
+
+#ifndef CONTINUATION_CACHE_LINE_SIZE
+# define CONTINUATION_CACHE_LINE_SIZE 64
+#endif
+
+/* the kernels are compiled by the target attributes of the functions */
+#if !defined(CONTINUATION_USE_VECTOR_FRAME_COPY)
+# if (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#  define CONTINUATION_USE_VECTOR_FRAME_COPY 1
+# else
+#  define CONTINUATION_USE_VECTOR_FRAME_COPY 0
+# endif
+#endif
+
+/*
+ * storage class of thread local variables.
+ */
+#ifndef CONTINUATION_THREAD_LOCAL
+# if defined(_MSC_VER)
+#   define CONTINUATION_THREAD_LOCAL __declspec(thread)
+# elif defined(__GNUC__)
+#   define CONTINUATION_THREAD_LOCAL __thread
+# endif
+#endif
+
 #if defined(__GNUC__) && (__GNUC__ >= 4 || (__GNUC__ == 3 && __GNUC_MINOR__ >= 3))
 # define CONTINUATION_ATTRIBUTE_MAY_ALIAS __attribute__((__may_alias__))
 #else
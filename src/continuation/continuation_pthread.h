@@ -36,10 +36,32 @@
  * @brief Name of a asynchronous task/continuation used by the library.
  */
 #define __ASYNC_TASK __async_task
+/**
+ * @brief Name of the innermost asynchronous scope used by the library.
+ */
+#define __ASYNC_SCOPE __async_scope
 /** @} */
 
 #include <pthread.h>
 #include "continuation.h"
+#include "misc/atomic.h"
+
+/**
+ * @brief Determine whether to wait for the tasks of a scope by futex.
+ * @details Defaults to 1 on Linux, otherwise the tasks are waited by a pthread condition variable.
+ */
+#define ASYNC_SCOPE_USE_FUTEX /* Empty definition for Doxygen */
+#undef ASYNC_SCOPE_USE_FUTEX
+
+/** @cond */
+#ifndef ASYNC_SCOPE_USE_FUTEX
+# if defined(__linux__)
+#  define ASYNC_SCOPE_USE_FUTEX 1
+# else
+#  define ASYNC_SCOPE_USE_FUTEX 0
+# endif
+#endif
+/** @endcond */
 
 /**
  * @name External variables
@@ -53,6 +75,28 @@
 extern pthread_key_t __async_pthread_key;
 /** @} */
 
+/**
+ * @internal
+ * @brief Structure type represents a scope that waits for the asynchronous tasks run inside.
+ * @see ASYNC_SCOPE()
+ */
+struct __AsyncScope {
+  struct __AsyncScope *parent; /**< the enclosing scope, or NULL. */
+  volatile int pending; /**< number of the tasks still running, also the futex word. */
+  volatile int cancelled; /**< the scope is cancelled. */
+#if !ASYNC_SCOPE_USE_FUTEX
+  pthread_mutex_t mutex; /**< lock of the last task leaving and the waiting. */
+  pthread_cond_t done; /**< signaled when the last task leaves. */
+#endif
+};
+
+/**
+ * @internal
+ * @brief The scope outside of any ASYNC_SCOPE().
+ * @details ASYNC_SCOPE() declares a local one of the same name that hides it.
+ */
+static struct __AsyncScope *const __ASYNC_SCOPE = NULL;
+
 /**
  * @internal
  * @brief Structure type represents the continuation that runs asynchronous.
@@ -60,6 +104,7 @@ extern pthread_key_t __async_pthread_key;
 struct __AsyncTask {
   struct __ContinuationStub cont_stub; /**< the continuation stub. */
   struct __Continuation cont; /**< the continuation. */
+  struct __AsyncScope *scope; /**< the scope the task is run inside, or NULL. */
   int quitable; /**< indicated the thread can quit or not. */
   pthread_mutex_t mutex; /**< pthread mutex for synchronization between host function and continuation. */
   pthread_cond_t running; /**< pthread condition variable. */
@@ -69,6 +114,34 @@ struct __AsyncTask {
 STATIC_ASSERT(offsetof(struct __AsyncTask, cont_stub) == 0, self_contraint_of_inheritance_hierarchy_of_struct_AsyncTask_failed);
 /** @endcond */
 
+/**
+ * @internal
+ * @brief Structure type represents the snapshot of a host stack frame shared by asynchronous tasks.
+ * @see ASYNC_RUN_EACH()
+ */
+struct __AsyncShared {
+  struct __Continuation cont; /**< the continuation shared by the tasks. */
+  char *frame; /**< the snapshot of the stack frame of host function. */
+  volatile int refcount; /**< number of the tasks and the host function referencing the snapshot. */
+};
+
+/**
+ * @internal
+ * @brief Structure type represents a task running on a shared snapshot.
+ */
+struct __AsyncSharedTask {
+  struct __ContinuationStub cont_stub; /**< the continuation stub. */
+  struct __AsyncShared *shared; /**< the snapshot. */
+  struct __AsyncScope *scope; /**< the scope the task is run inside, or NULL. */
+  long index; /**< index of the task. */
+  int restored; /**< the stack frame has been restored. */
+  int last; /**< the task released the last reference of the snapshot. */
+};
+
+/** @cond */
+STATIC_ASSERT(offsetof(struct __AsyncSharedTask, cont_stub) == 0, self_contraint_of_inheritance_hierarchy_of_struct_AsyncSharedTask_failed);
+/** @endcond */
+
 /**
  * @name Function pointers
  * Pointers to the functions that should not be inlined.
@@ -83,6 +156,15 @@ STATIC_ASSERT(offsetof(struct __AsyncTask, cont_stub) == 0, self_contraint_of_in
  * @see ASYNC_RUN()
  */
 extern struct __AsyncTask *(*__async_copy_stack_frame)(struct __AsyncTask *);
+/**
+ * @internal
+ * @brief Internal help function to copy the live stack frame of the host function to a task of ASYNC_RUN_EACH().
+ * @details It is used by the tasks run on the host thread when there is no snapshot.
+ * @param task: pointer to the task.
+ * @return \p task: the missing \p task the value of callee may be overwritten by the function itself.
+ * @see ASYNC_RUN_EACH()
+ */
+extern struct __AsyncSharedTask *(*__async_shared_copy_stack_frame)(struct __AsyncSharedTask *);
 /**@}*/
 
 #ifdef __cplusplus
@@ -92,16 +174,53 @@ extern "C" {
    * @internal
    * @brief Internal help function to create a pthread routine.
    * @details The pthread routine is used for running the task/continuation asynchronously.
+   * @param scope: the scope to wait for the thread, or NULL.
    * @return the pthread_t type id of the thread.
    */
-  extern pthread_t __async_pthread_create();
+  extern pthread_t __async_pthread_create(struct __AsyncScope *scope);
+  /**
+   * @internal
+   * @brief Internal help function to initialize the scope of ASYNC_SCOPE().
+   */
+  extern void __async_scope_init(struct __AsyncScope *scope, struct __AsyncScope *parent);
+  /**
+   * @internal
+   * @brief Internal help function to wait for the tasks of the scope of ASYNC_SCOPE().
+   */
+  extern void __async_scope_join(struct __AsyncScope *scope);
+  /**
+   * @internal
+   * @brief Internal help function to allocate the snapshot of ASYNC_RUN_EACH().
+   * @details The snapshot is referenced by the host function until the tasks are created,
+   * and is taken by __async_shared_take().
+   * @return 0 on success, or ENOMEM.
+   */
+  extern int __async_shared_new(void);
+  /**
+   * @internal
+   * @brief Internal help function to take the snapshot allocated by __async_shared_new() on the calling thread.
+   * @return the snapshot, or NULL if it fails to be allocated.
+   */
+  extern struct __AsyncShared *__async_shared_take(void);
+  /**
+   * @internal
+   * @brief Internal help function to create the threads of ASYNC_RUN_EACH().
+   * @details The iterations that fail to get a thread, or all of them without a snapshot,
+   * run on the calling thread before it returns.
+   */
+  extern void __async_shared_run(struct __AsyncShared *shared, long n, struct __AsyncScope *scope);
+  /**
+   * @internal
+   * @brief Internal help function to free the snapshot of ASYNC_RUN_EACH().
+   */
+  extern void __async_shared_free(struct __AsyncShared *shared);
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
 
 /** @cond */
 #define __ASYNC_RUN(continuation) \
-    __async_pthread_create(); \
+    __async_pthread_create(__ASYNC_SCOPE); \
     { \
       struct __AsyncTask *__ASYNC_TASK = (struct __AsyncTask *)pthread_getspecific(__async_pthread_key); \
       assert(__ASYNC_TASK != NULL); \
@@ -133,6 +252,7 @@ extern "C" {
  * 
  * @warning If variadic macro isn't supported, the statements block
  * should not contains any "," operators outside of any semantic parentheses.
+ * @warning Inside ASYNC_SCOPE(), the thread is detached and must not be joined.
  * 
  * @see __ASYNC_RUN()
  * 
@@ -154,6 +274,193 @@ extern "C" {
 #endif
 /** @endcond */
 
+/** @cond */
+#define __ASYNC_RUN_EACH(i, n, continuation) \
+    __async_shared_new(); \
+    { \
+      struct __AsyncShared *__async_shared = __async_shared_take(); \
+      struct __AsyncSharedTask __async_shared_task, *__ASYNC_TASK = &__async_shared_task; \
+      if (__async_shared) { \
+        CONTINUATION_CONNECT(&__async_shared->cont, __ASYNC_TASK \
+          , () \
+          , ( \
+              if (!__ASYNC_TASK->restored) { \
+                if (__ASYNC_TASK->shared->frame) { \
+                  CONTINUATION_RESTORE_STACK_FRAME(__ASYNC_TASK, __ASYNC_TASK->shared->frame); \
+                } else { \
+                  /* run by the host thread, whose stack frame is still live */ \
+                  __ASYNC_TASK = __async_shared_copy_stack_frame(__ASYNC_TASK); \
+                } \
+                __ASYNC_TASK->restored = 1; \
+                /* enter again, the compiler may load the variables before the restoration */ \
+                __ASYNC_TASK->cont_stub.addr.stack_frame_addr = __ASYNC_TASK->cont_stub.addr.stack_frame_tail \
+                                                                + __ASYNC_TASK->cont_stub.cont->stack_frame_size; \
+                CONTINUATION_STUB_INVOKE(__ASYNC_TASK); \
+              } \
+              i = __ASYNC_TASK->index; \
+              { \
+                __PP_REMOVE_PARENS(continuation); \
+              } \
+              if (ATOMIC_FETCH_SUB(&__ASYNC_TASK->shared->refcount, 1) == 1) { \
+                CONTINUATION_DESTRUCT(&__ASYNC_TASK->shared->cont); \
+                __ASYNC_TASK->last = 1; \
+              } \
+          ) \
+        ) { \
+          __async_shared->frame = (char *)malloc(__async_shared->cont.stack_frame_size); \
+          if (__async_shared->frame) { \
+            CONTINUATION_BACKUP_STACK_FRAME(&__async_shared->cont, __async_shared->frame); \
+          } \
+        } \
+        __async_shared_run(__async_shared, n, __ASYNC_SCOPE); \
+        if (ATOMIC_FETCH_SUB(&__async_shared->refcount, 1) == 1) { \
+          CONTINUATION_DESTRUCT(&__async_shared->cont); \
+          __async_shared_free(__async_shared); \
+        } \
+      } \
+    }
+/** @endcond */
+
+/**
+ * @brief Run a statements block asynchronously by a number of threads sharing one snapshot of the host stack frame.
+ *
+ * @details ASYNC_RUN() connects a continuation for each thread and the host function waits
+ * until the thread has copied the live stack frame of the host function. Instead, the stack
+ * frame is backed up once into a reference counted snapshot, the \p n threads restore their
+ * frames from it by themselves, and the host function returns as soon as the threads are
+ * created. So the cost of the host function does not grow with the size of stack frame
+ * times the number of threads. The last thread finished releases the snapshot.
+ *
+ * The local variables are captured by value at the moment of the snapshot, which suits the
+ * tasks only reading them. Each thread runs the statements with \p i set to its index from 0
+ * up to but not including \p n.
+ *
+ * The threads are detached. Inside ASYNC_SCOPE() they are waited by the scope,
+ * otherwise the results should be synchronized by the statements themselves.
+ *
+ * It evaluates as an expression of int type, which is 0, or ENOMEM if the snapshot can't be
+ * allocated and nothing runs. An iteration that fails to get a thread runs on the host thread
+ * before ASYNC_RUN_EACH() returns, as all of them do if the stack frame can't be backed up,
+ * in which case they see the live local variables.
+ *
+ * @param i: name of a local variable of integer type to receive the index of the thread.
+ * @param n: number of the threads.
+ * @param ...: the statements to run asynchronously.
+ *
+ * @warning ASYNC_HOST_VAR() is only valid while the host function is still active.
+ *
+ * @see ASYNC_RUN()
+ *
+ * @par Example:
+ * @code
+ *  long i;
+ *  ASYNC_SCOPE(
+ *    ASYNC_RUN_EACH(i, nthreads,
+ *      search(table, table_size, keys + i * keys_per_thread, keys_per_thread);
+ *    );
+ *  );
+ * @endcode
+ */
+#define ASYNC_RUN_EACH(i, n) /* Empty defintion for Doxygen */
+#undef ASYNC_RUN_EACH
+
+/** @cond */
+#if BOOST_PP_VARIADICS
+# define ASYNC_RUN_EACH(i, n, ...) __ASYNC_RUN_EACH(i, n, (__VA_ARGS__))
+#else
+# define ASYNC_RUN_EACH __ASYNC_RUN_EACH
+#endif
+/** @endcond */
+
+/** @cond */
+#define __ASYNC_SCOPE_RUN(statements) \
+  { \
+    struct __AsyncScope __async_scope_storage; \
+    __async_scope_init(&__async_scope_storage, __ASYNC_SCOPE); \
+    { \
+      /* volatile to be loaded from the frame copied by the tasks, rather than rebased with it */ \
+      struct __AsyncScope *volatile const __ASYNC_SCOPE = &__async_scope_storage; \
+      __PP_REMOVE_PARENS(statements); \
+    } \
+    __async_scope_join(&__async_scope_storage); \
+  }
+/** @endcond */
+
+/**
+ * @brief Run a statements block and wait for the asynchronous tasks run inside.
+ *
+ * @details The threads created by ASYNC_RUN() in the block, including the ones created by
+ * those threads, are detached and counted by the scope. Leaving the block waits until all of
+ * them have finished, by a single wait on the counter rather than joining each thread.
+ *
+ * A scope can be cancelled by ASYNC_SCOPE_CANCEL(), which is seen by ASYNC_SCOPE_IS_CANCELLED()
+ * in the tasks of the scope as well as in the scopes nested inside. The cancellation is
+ * cooperative and leaving the scope still waits for the tasks.
+ *
+ * @param ...: the statements to run.
+ *
+ * @warning Don't leave the block by return, break or goto, or the tasks are not waited.
+ *
+ * @par Example:
+ * @code
+ *  ASYNC_SCOPE(
+ *    for (i = 0; i < n; ++i) {
+ *      ASYNC_RUN(
+ *        if (!ASYNC_SCOPE_IS_CANCELLED() && !process(&items[i])) ASYNC_SCOPE_CANCEL();
+ *      );
+ *    }
+ *  );
+ *  // all of the items are processed here
+ * @endcode
+ */
+#define ASYNC_SCOPE() /* Empty defintion for Doxygen */
+#undef ASYNC_SCOPE
+
+/** @cond */
+#if BOOST_PP_VARIADICS
+# define ASYNC_SCOPE(...) __ASYNC_SCOPE_RUN((__VA_ARGS__))
+#else
+# define ASYNC_SCOPE __ASYNC_SCOPE_RUN
+#endif
+/** @endcond */
+
+/**
+ * @brief Cancel the innermost scope together with the scopes nested inside.
+ */
+#define ASYNC_SCOPE_CANCEL() \
+  async_scope_cancel(__ASYNC_SCOPE)
+
+/**
+ * @brief Determine whether the innermost scope or any enclosing one is cancelled.
+ * @return 0 outside of any scope.
+ */
+#define ASYNC_SCOPE_IS_CANCELLED() \
+  async_scope_is_cancelled(__ASYNC_SCOPE)
+
+/**
+ * @brief Cancel a scope.
+ * @param scope: pointer to the scope.
+ * @see ASYNC_SCOPE_CANCEL()
+ */
+inline static void async_scope_cancel(struct __AsyncScope *scope)
+{
+  assert(scope != NULL);
+  ATOMIC_STORE(&scope->cancelled, 1);
+}
+
+/**
+ * @brief Determine whether a scope or any enclosing one is cancelled.
+ * @param scope: pointer to the scope, or NULL.
+ * @see ASYNC_SCOPE_IS_CANCELLED()
+ */
+inline static int async_scope_is_cancelled(const struct __AsyncScope *scope)
+{
+  for (; scope; scope = scope->parent) {
+    if (ATOMIC_LOAD(&scope->cancelled)) return 1;
+  }
+  return 0;
+}
+
 /**
  * @brief Get pointer to a local variable in the parent thread.
  * @param v: name of the variable.
@@ -0,0 +1,452 @@
+/*
+ * Copyright 2013, Zhou Zhenghui <zhouzhenghui@gmail.com>
+ */
+
+#ifndef __CONTINUATION_COROUTINE_HPP
+#define __CONTINUATION_COROUTINE_HPP
+
+/**
+ * @file
+ * @ingroup scheduler
+ * @brief C++20 coroutines resumed by the scheduler.
+ * @details signalbus::task is the return type of coroutines, whose promise runs the coroutine
+ * on a scheduler and resumes it by submitting a scheduler task, so that the coroutines share
+ * the workers with the continuations spawned by ASYNC_SPAWN() and no thread is created.
+ *
+ * A coroutine runs on scheduler_default(), or on the scheduler passed as its first parameter.
+ * It can co_await:
+ *  - another signalbus::task, for its completion and result;
+ *  - signalbus::sleep_for(), which submits the resumption through scheduler_submit_after(),
+ *    and resumes before the deadline if the cancel token passed is cancelled;
+ *  - signalbus::yield(), which queues the resumption behind the other tasks;
+ *  - a signalbus::signal, for its next emission.
+ *
+ * @par Example:
+ * @code
+ *  signalbus::task<double> best_bid(struct __Scheduler *scheduler, signalbus::signal<Quote> *quotes)
+ *  {
+ *    Quote quote = co_await *quotes;
+ *    co_await signalbus::sleep_for(std::chrono::milliseconds(10));
+ *    co_return quote.bid;
+ *  }
+ *
+ *  signalbus::task<double> bid = best_bid(&scheduler, &quotes);
+ *  quotes.emit(quote);
+ *  printf("%f\n", bid.get());
+ * @endcode
+ */
+
+#if !defined(__cplusplus) || __cplusplus < 202002L || !defined(__cpp_impl_coroutine)
+# error "signalbus coroutines require C++20"
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include "scheduler.h"
+#include "cancel_token.h"
+
+namespace signalbus {
+
+/** @cond */
+namespace detail {
+  /**
+   * @internal
+   * @brief A scheduler task resuming a suspended coroutine.
+   */
+  struct resumer {
+    struct __SchedulerTask task;
+    std::coroutine_handle<> handle;
+    struct __Scheduler *scheduler;
+
+    static void run(struct __SchedulerTask *task)
+    {
+      reinterpret_cast<resumer *>(reinterpret_cast<char *>(task) - offsetof(resumer, task))->handle.resume();
+    }
+
+    void post(std::coroutine_handle<> h)
+    {
+      handle = h;
+      scheduler_task_init(&task, run);
+      scheduler_submit(scheduler, &task);
+    }
+
+    void post_after(std::coroutine_handle<> h, uint64_t delay)
+    {
+      handle = h;
+      scheduler_task_init(&task, run);
+      scheduler_submit_after(scheduler, &task, delay);
+    }
+  };
+
+  /**
+   * @internal
+   * @brief The part of the promises of signalbus::task that the awaitables resume through.
+   * @details A coroutine is suspended at most once at a time, so one resumer is enough.
+   */
+  struct promise_base {
+    resumer resumer_;
+
+    promise_base() { resumer_.scheduler = scheduler_default(); }
+
+    template <typename... Args>
+    promise_base(struct __Scheduler *scheduler, Args &...) { resumer_.scheduler = scheduler; }
+
+    /* start on the scheduler instead of the caller */
+    struct initial_awaiter {
+      bool await_ready() const noexcept { return false; }
+      template <typename Promise>
+      void await_suspend(std::coroutine_handle<Promise> h) noexcept { h.promise().resumer_.post(h); }
+      void await_resume() const noexcept {}
+    };
+  };
+
+  template <typename Promise>
+  inline resumer &resumer_of(std::coroutine_handle<Promise> h)
+  {
+    static_assert(std::is_base_of<promise_base, Promise>::value, "only signalbus::task coroutines are resumed by the scheduler");
+    return h.promise().resumer_;
+  }
+
+  /**
+   * @internal
+   * @brief The completion state shared by a task and its coroutine.
+   * @details \p waiter is NULL while running, the resumer of the awaiting coroutine,
+   * or the state itself after completion.
+   */
+  struct task_state_base {
+    std::atomic<void *> waiter{nullptr};
+    std::exception_ptr exception;
+
+    bool done() const { return waiter.load(std::memory_order_acquire) == this; }
+
+    void complete()
+    {
+      void *w = waiter.exchange(this, std::memory_order_acq_rel);
+      if (w != nullptr) static_cast<resumer *>(w)->post(static_cast<resumer *>(w)->handle);
+      waiter.notify_all();
+    }
+
+    /* returns false if completed already */
+    bool await(resumer *r)
+    {
+      void *expected = nullptr;
+      return waiter.compare_exchange_strong(expected, r, std::memory_order_acq_rel);
+    }
+
+    void wait()
+    {
+      void *w = waiter.load(std::memory_order_acquire);
+      while (w != this) {
+        waiter.wait(w, std::memory_order_acquire);
+        w = waiter.load(std::memory_order_acquire);
+      }
+    }
+  };
+
+  template <typename T>
+  struct task_state : task_state_base {
+    std::optional<T> value;
+
+    T take()
+    {
+      if (exception) std::rethrow_exception(exception);
+      return std::move(*value);
+    }
+  };
+
+  template <>
+  struct task_state<void> : task_state_base {
+    void take()
+    {
+      if (exception) std::rethrow_exception(exception);
+    }
+  };
+
+  template <typename T>
+  struct task_promise : promise_base {
+    using promise_base::promise_base;
+    std::shared_ptr<task_state<T> > state;
+
+    template <typename U>
+    void return_value(U &&value) { state->value.emplace(std::forward<U>(value)); }
+  };
+
+  template <>
+  struct task_promise<void> : promise_base {
+    using promise_base::promise_base;
+    std::shared_ptr<task_state<void> > state;
+
+    void return_void() {}
+  };
+} /* namespace detail */
+/** @endcond */
+
+/**
+ * @brief The return type of coroutines run by the scheduler.
+ * @details The coroutine starts on the scheduler as soon as it is called, and keeps running
+ * if the task is destroyed. A task is either awaited by one coroutine or waited by get().
+ * @param T: type of the result, or void.
+ */
+template <typename T = void>
+class task {
+public:
+  /** @brief The promise type of the coroutines. */
+  struct promise_type : detail::task_promise<T> {
+    using detail::task_promise<T>::task_promise;
+
+    task get_return_object()
+    {
+      this->state = std::make_shared<detail::task_state<T> >();
+      return task(this->state);
+    }
+    detail::promise_base::initial_awaiter initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept
+    {
+      this->state->complete();
+      return {};
+    }
+    void unhandled_exception() { this->state->exception = std::current_exception(); }
+  };
+
+  /** @brief The awaiter resuming the awaiting coroutine when the task completes. */
+  struct awaiter {
+    std::shared_ptr<detail::task_state<T> > state;
+
+    bool await_ready() const { return state->done(); }
+    template <typename Promise>
+    bool await_suspend(std::coroutine_handle<Promise> h)
+    {
+      detail::resumer &r = detail::resumer_of(h);
+      r.handle = h;
+      return state->await(&r);
+    }
+    T await_resume() { return state->take(); }
+  };
+
+  task(task &&) = default;
+  task &operator=(task &&) = default;
+
+  /** @brief Determine whether the coroutine has completed. */
+  bool done() const { return state_->done(); }
+
+  /**
+   * @brief Block the calling thread until the coroutine completes.
+   * @return the result of the coroutine, or rethrow its exception.
+   * @warning Don't call it on a worker of the scheduler, which may be the one to run the coroutine.
+   */
+  T get()
+  {
+    state_->wait();
+    return state_->take();
+  }
+
+  awaiter operator co_await() const { return awaiter{state_}; }
+
+private:
+  explicit task(std::shared_ptr<detail::task_state<T> > state) : state_(std::move(state)) {}
+
+  std::shared_ptr<detail::task_state<T> > state_;
+};
+
+/** @cond */
+namespace detail {
+  struct sleep_awaiter {
+    uint64_t delay;
+
+    bool await_ready() const noexcept { return false; }
+    template <typename Promise>
+    void await_suspend(std::coroutine_handle<Promise> h)
+    {
+      if (delay) resumer_of(h).post_after(h, delay);
+      else resumer_of(h).post(h);
+    }
+    void await_resume() const noexcept {}
+  };
+
+  /**
+   * @internal
+   * @brief The awaiter of a sleep cut short by a cancel token.
+   * @details The timer is a task of the awaiter rather than the resumer of the coroutine, so
+   * taking it out on cancellation never hits a later suspension of the same coroutine.
+   * The timer doesn't resume the coroutine until await_suspend() is done with the awaiter.
+   */
+  struct cancellable_sleep_awaiter {
+    static const int SUSPENDING = 0; /* await_suspend() still uses the awaiter */
+    static const int ARMED = 1; /* the timer resumes the coroutine */
+    static const int FIRED = 2; /* the timer has fired during await_suspend() */
+
+    struct __SchedulerTask task;
+    uint64_t delay;
+    struct __CancelToken *token;
+    struct __Scheduler *scheduler;
+    std::coroutine_handle<> handle;
+    struct __CancelCallback *callback;
+    volatile int state;
+
+    static void fire(struct __SchedulerTask *task)
+    {
+      cancellable_sleep_awaiter *awaiter = reinterpret_cast<cancellable_sleep_awaiter *>(task);
+      /* leave the resumption to await_suspend() */
+      if (ATOMIC_CAS(&awaiter->state, SUSPENDING, FIRED)) return;
+      awaiter->handle.resume();
+    }
+
+    /* fire the timer at once if it is still in the heap */
+    static void cancel(void *arg)
+    {
+      cancellable_sleep_awaiter *awaiter = static_cast<cancellable_sleep_awaiter *>(arg);
+      if (scheduler_cancel_timer(awaiter->scheduler, &awaiter->task)) scheduler_submit(awaiter->scheduler, &awaiter->task);
+    }
+
+    bool await_ready() const noexcept { return cancel_token_is_cancelled(token); }
+    template <typename Promise>
+    bool await_suspend(std::coroutine_handle<Promise> h)
+    {
+      scheduler = resumer_of(h).scheduler;
+      handle = h;
+      state = SUSPENDING;
+      scheduler_task_init(&task, fire);
+      scheduler_submit_after(scheduler, &task, delay);
+      /* the timer is of this awaiter only, and the coroutine is not resumed meanwhile */
+      callback = cancel_token_register(token, cancel, this);
+      if (callback == NULL && cancel_token_is_cancelled(token)) cancel(this);
+      /* resume at once if the timer has fired */
+      return ATOMIC_CAS(&state, SUSPENDING, ARMED);
+    }
+    /* waits for the callback running */
+    void await_resume() noexcept { cancel_token_unregister(callback); }
+  };
+} /* namespace detail */
+/** @endcond */
+
+/**
+ * @brief Suspend the coroutine for a duration.
+ * @details The resumption is submitted by scheduler_submit_after(), so no worker is blocked.
+ */
+template <typename Rep, typename Period>
+inline detail::sleep_awaiter sleep_for(std::chrono::duration<Rep, Period> duration)
+{
+  auto delay = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+  return detail::sleep_awaiter{delay > 0 ? (uint64_t)delay : 0};
+}
+
+/**
+ * @brief Suspend the coroutine for a duration or until a cancel token is cancelled.
+ * @details The timer is taken out of the scheduler on cancellation, and the coroutine
+ * is resumed at once. It returns immediately if the token is cancelled already.
+ * @param duration: the duration.
+ * @param token: the cancel token.
+ */
+template <typename Rep, typename Period>
+inline detail::cancellable_sleep_awaiter sleep_for(std::chrono::duration<Rep, Period> duration, struct __CancelToken *token)
+{
+  auto delay = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+  return detail::cancellable_sleep_awaiter{{}, delay > 0 ? (uint64_t)delay : 0, token, nullptr, {}, nullptr, 0};
+}
+
+/**
+ * @brief Suspend the coroutine to let the other tasks of the scheduler run.
+ */
+inline detail::sleep_awaiter yield()
+{
+  return detail::sleep_awaiter{0};
+}
+
+/**
+ * @brief A signal that coroutines wait for the next emission of.
+ * @details The waiting coroutines are kept in an intrusive list of their awaiters,
+ * and an emission resumes all of them through their schedulers with a copy of the value.
+ * It can be emitted from any thread, e.g. by a slot subscribed to a topic.
+ * @param T: type of the value, or void.
+ */
+template <typename T = void>
+class signal {
+  typedef typename std::conditional<std::is_void<T>::value, std::monostate, T>::type value_type;
+
+public:
+  /** @brief The awaiter of the next emission. */
+  struct awaiter {
+    signal *owner;
+    awaiter *next;
+    detail::resumer *resumer;
+    std::optional<value_type> value;
+
+    bool await_ready() const noexcept { return false; }
+    template <typename Promise>
+    void await_suspend(std::coroutine_handle<Promise> h)
+    {
+      resumer = &detail::resumer_of(h);
+      resumer->handle = h;
+      owner->lock();
+      next = owner->waiters_;
+      owner->waiters_ = this;
+      owner->unlock();
+    }
+    T await_resume()
+    {
+      if constexpr (!std::is_void<T>::value) return std::move(*value);
+    }
+  };
+
+  signal() : waiters_(nullptr) {}
+  signal(const signal &) = delete;
+  signal &operator=(const signal &) = delete;
+
+  awaiter operator co_await() { return awaiter{this, nullptr, nullptr, std::nullopt}; }
+
+  /**
+   * @brief Resume all of the coroutines waiting for the signal.
+   * @return number of the coroutines resumed.
+   */
+  std::size_t emit(const value_type &value = value_type())
+  {
+    std::size_t count = 0;
+    lock();
+    awaiter *w = waiters_;
+    waiters_ = nullptr;
+    unlock();
+    while (w) {
+      /* the awaiter is gone once the coroutine resumes */
+      awaiter *next = w->next;
+      w->value.emplace(value);
+      w->resumer->post(w->resumer->handle);
+      w = next;
+      ++count;
+    }
+    return count;
+  }
+
+  /** @brief Get the number of the coroutines waiting for the signal. */
+  std::size_t waiting()
+  {
+    std::size_t count = 0;
+    lock();
+    for (awaiter *w = waiters_; w; w = w->next) ++count;
+    unlock();
+    return count;
+  }
+
+private:
+  void lock()
+  {
+    while (lock_.exchange(true, std::memory_order_acquire)) {
+      while (lock_.load(std::memory_order_relaxed)) ATOMIC_CPU_RELAX();
+    }
+  }
+  void unlock() { lock_.store(false, std::memory_order_release); }
+
+  awaiter *waiters_;
+  std::atomic<bool> lock_{false};
+};
+
+} /* namespace signalbus */
+
+#endif /* __CONTINUATION_COROUTINE_HPP */
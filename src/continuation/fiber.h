@@ -0,0 +1,143 @@
+/*
+ * Copyright 2013, Zhou Zhenghui <zhouzhenghui@gmail.com>
+ */
+
+#ifndef __CONTINUATION_FIBER_H
+#define __CONTINUATION_FIBER_H
+
+/**
+ * @defgroup fiber fiber
+ * @ingroup continuation
+ * @brief Stackful fibers running on their own pooled stacks.
+ * @details A continuation relocates the stack frame of the host function by copying,
+ * which costs in proportion to the size of the frame at every invocation. A fiber
+ * instead owns a separate stack, so that switching to and from it only swaps the
+ * callee-saved registers and the stack pointer, no matter how deep the frames are.
+ *
+ * The stacks are mapped with a guard page below them to catch overflows, and are
+ * recycled by a stack pool to avoid the cost of mapping a stack for every fiber.
+ *
+ * Define CONTINUATION_USE_FIBER to 1 to run the blocks spawned by ASYNC_SPAWN() on fibers.
+ * @see CONTINUATION_USE_FIBER
+ * @see CONTINUATION_FIBER_STACK_SIZE
+ *
+ * @{
+ */
+
+/**
+ * @file
+ * @brief The head file for stackful fibers.
+ */
+
+#include "continuation_base.h"
+
+struct __FiberStack;
+
+/**
+ * @brief The stack pool structure.
+ * @details Released stacks are cached in the pool up to \p capacity and
+ * reused by the fibers initialized later.
+ * @see fiber_stack_pool_init()
+ */
+struct __FiberStackPool {
+  struct __FiberStack *stacks; /**< the cached stacks. */
+  size_t stack_size; /**< usable size of each stack. */
+  int count; /**< number of cached stacks. */
+  int capacity; /**< maximum number of cached stacks. */
+  volatile int lock; /**< spin lock of the pool. */
+};
+
+/**
+ * @brief Structure type represents a fiber.
+ * @see fiber_init()
+ */
+struct __Fiber {
+  void *sp; /**< saved stack pointer of the fiber. */
+  void *caller_sp; /**< saved stack pointer of the caller of fiber_resume(). */
+  struct __FiberStack *stack; /**< the stack of the fiber, which also points to the top of the stack. */
+  struct __FiberStackPool *pool; /**< the pool that the stack comes from. */
+  void (*func)(void *); /**< the function to run on the fiber. */
+  void *arg; /**< argument passed to \p func. */
+  int finished; /**< \p func has returned. */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  /**
+   * @brief Initialize a stack pool.
+   * @param pool: pointer to the pool.
+   * @param stack_size: usable size of each stack, or 0 for CONTINUATION_FIBER_STACK_SIZE.
+   * @param capacity: maximum number of stacks to cache.
+   * @see fiber_stack_pool_free()
+   */
+  extern void fiber_stack_pool_init(struct __FiberStackPool *pool, size_t stack_size, int capacity);
+  /**
+   * @brief Unmap the stacks cached by a stack pool.
+   * @param pool: pointer to the pool.
+   * @note All of the fibers using the pool should have been freed.
+   */
+  extern void fiber_stack_pool_free(struct __FiberStackPool *pool);
+  /**
+   * @brief Get the default stack pool of the process.
+   * @return pointer to the pool.
+   */
+  extern struct __FiberStackPool *fiber_stack_pool_default(void);
+  /**
+   * @brief Initialize a fiber.
+   * @details The fiber does not start until fiber_resume() is called.
+   * @param fiber: pointer to the fiber.
+   * @param pool: the pool to take the stack from, or NULL for the default pool.
+   * @param func: the function to run on the fiber.
+   * @param arg: argument passed to \p func.
+   * @return 0 on success, or ENOMEM if no stack could be mapped.
+   * @see fiber_free()
+   */
+  extern int fiber_init(struct __Fiber *fiber, struct __FiberStackPool *pool, void (*func)(void *), void *arg);
+  /**
+   * @brief Restart a fiber with another function on the same stack.
+   * @param fiber: pointer to the fiber, which must be finished or never resumed.
+   * @param func: the function to run on the fiber.
+   * @param arg: argument passed to \p func.
+   * @param reserve: size of space to be left untouched at the top of the stack.
+   */
+  extern void fiber_reset(struct __Fiber *fiber, void (*func)(void *), void *arg, size_t reserve);
+  /**
+   * @brief Release the stack of a fiber to its pool.
+   * @param fiber: pointer to the fiber.
+   * @warning The objects on the stack of a suspended fiber are discarded without any cleanup.
+   */
+  extern void fiber_free(struct __Fiber *fiber);
+  /**
+   * @brief Switch to a fiber.
+   * @details It returns when the fiber calls fiber_yield() or its function returns.
+   * @param fiber: pointer to the fiber, which must not be finished.
+   */
+  extern void fiber_resume(struct __Fiber *fiber);
+  /**
+   * @brief Switch from a fiber back to the caller of fiber_resume().
+   * @param fiber: pointer to the running fiber.
+   */
+  extern void fiber_yield(struct __Fiber *fiber);
+  /**
+   * @brief Get the fiber running on the calling thread.
+   * @return pointer to the fiber, or NULL if not running on a fiber.
+   */
+  extern struct __Fiber *fiber_current(void);
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+/**
+ * @brief Test if the function of a fiber has returned.
+ * @param fiber: pointer to the fiber.
+ * @return nonzero if the fiber is finished.
+ */
+inline static int fiber_is_finished(const struct __Fiber *fiber)
+{
+  return fiber->finished;
+}
+
+/** @} */
+
+#endif /* __CONTINUATION_FIBER_H */
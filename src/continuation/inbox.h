@@ -0,0 +1,147 @@
+/*
+ * Copyright 2013, Zhou Zhenghui <zhouzhenghui@gmail.com>
+ */
+
+#ifndef __CONTINUATION_INBOX_H
+#define __CONTINUATION_INBOX_H
+
+/**
+ * @defgroup inbox inbox
+ * @ingroup closure
+ * @brief Thread-affine delivery of messages to slots through inboxes.
+ * @details An inbox is owned by a thread, e.g. an I/O loop, and the slots posted to
+ * the inbox always run on the owner thread no matter which thread emits.
+ *
+ * Emitting pushes an item onto a lock-free multiple-producer list of the inbox.
+ * The owner takes all of the pushed items at once and invokes their slots in the
+ * order of emission. The owner is woken through a file descriptor, which is an eventfd
+ * on Linux or a pipe elsewhere, so that the inbox can be watched by select(), poll()
+ * or epoll together with other descriptors. Only the emission that finds the list empty
+ * writes to the descriptor, so there is at most one wakeup system call per batch.
+ *
+ * @par Example:
+ * @code
+ *   // the owner thread
+ *   inbox_init(&inbox);
+ *   for (;;) {
+ *     inbox_wait(&inbox, -1);
+ *     inbox_drain(&inbox);
+ *   }
+ *
+ *   // any thread
+ *   inbox_emit(&inbox, &slot, message);
+ * @endcode
+ *
+ * @{
+ */
+
+/**
+ * @file
+ * @brief The head file for thread-affine inboxes.
+ */
+
+#include "closure.h"
+#include "misc/atomic.h"
+
+/**
+ * @brief Type of the closures posted to inboxes.
+ * @details The closure is invoked with the message emitted.
+ */
+typedef CLOSURE1(void *) InboxSlot;
+
+/**
+ * @brief Structure type represents a message posted to an inbox.
+ * @details It can be embedded in a user structure and posted by inbox_post()
+ * to avoid the allocation of inbox_emit().
+ */
+struct __InboxItem {
+  struct __InboxItem *next; /**< link in the inbox. */
+  InboxSlot *slot; /**< the slot to invoke. */
+  void *message; /**< the message passed to the slot. */
+  int allocated; /**< the item is allocated by inbox_emit() and freed after delivery. */
+};
+
+/**
+ * @brief The inbox structure.
+ * @see inbox_init()
+ */
+struct __Inbox {
+  struct __InboxItem *items; /**< the items pushed by the emitters, in reverse order. */
+  int fds[2]; /**< the descriptors to read and write the wakeup, which are the same for eventfd. */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  /**
+   * @brief Initialize an inbox.
+   * @param inbox: pointer to the inbox.
+   * @return 0 on success, or the error number if the descriptor could not be created.
+   * @see inbox_free()
+   */
+  extern int inbox_init(struct __Inbox *inbox);
+  /**
+   * @brief Free an inbox.
+   * @details The messages not yet delivered are discarded.
+   * @param inbox: pointer to the inbox.
+   */
+  extern void inbox_free(struct __Inbox *inbox);
+  /**
+   * @brief Post an item to an inbox.
+   * @param inbox: pointer to the inbox.
+   * @param item: pointer to the item with the slot and the message filled,
+   * which must stay valid until the slot has been invoked.
+   */
+  extern void inbox_post(struct __Inbox *inbox, struct __InboxItem *item);
+  /**
+   * @brief Emit a message to a slot through an inbox.
+   * @param inbox: pointer to the inbox.
+   * @param slot: the slot to run on the owner thread of the inbox.
+   * @param message: the message passed to the slot.
+   * @return 0 on success, or ENOMEM.
+   */
+  extern int inbox_emit(struct __Inbox *inbox, InboxSlot *slot, void *message);
+  /**
+   * @brief Invoke the slots of all of the items posted to an inbox.
+   * @param inbox: pointer to the inbox.
+   * @return number of the slots invoked.
+   * @note It must be called by the owner thread only.
+   */
+  extern int inbox_drain(struct __Inbox *inbox);
+  /**
+   * @brief Wait until an inbox is woken.
+   * @param inbox: pointer to the inbox.
+   * @param timeout: timeout in milliseconds, or -1 to wait infinitely.
+   * @return nonzero if woken, or 0 on timeout.
+   */
+  extern int inbox_wait(struct __Inbox *inbox, int timeout);
+  /**
+   * @brief Bind an inbox to the calling thread as its own.
+   * @param inbox: pointer to the inbox, or NULL to unbind.
+   * @see inbox_current()
+   */
+  extern void inbox_bind(struct __Inbox *inbox);
+  /**
+   * @brief Get the inbox bound to the calling thread.
+   * @return pointer to the inbox, or NULL if not bound.
+   */
+  extern struct __Inbox *inbox_current(void);
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+/**
+ * @brief Get the file descriptor to watch for the wakeup of an inbox.
+ * @details The descriptor becomes readable when messages are posted, and it is
+ * reset by inbox_drain().
+ * @param inbox: pointer to the inbox.
+ * @return the file descriptor.
+ */
+inline static int inbox_fd(const struct __Inbox *inbox)
+{
+  return inbox->fds[0];
+}
+
+/** @} */
+
+#endif /* __CONTINUATION_INBOX_H */
@@ -0,0 +1,137 @@
+/*
+ * Copyright 2013, Zhou Zhenghui <zhouzhenghui@gmail.com>
+ */
+
+#ifndef __CONTINUATION_JOURNAL_H
+#define __CONTINUATION_JOURNAL_H
+
+/**
+ * @defgroup journal journal
+ * @ingroup topic
+ * @brief Memory mapped journal recording and replaying the traffic of topics.
+ * @details A journal is an append-only sequence of segment files named by a prefix and
+ * an index, e.g. "bus.000000", "bus.000001". Each segment is mapped into memory,
+ * and a record is a fixed header followed by the topic name and the message bytes.
+ *
+ * The emitters append concurrently without lock: each one reserves the space of its record
+ * by an atomic increment of the offset of the segment and copies the record into the mapped
+ * memory. The emitter whose reservation overflows the segment maps the next segment and
+ * retires the full one after the other emitters finish with it.
+ *
+ * A journal tap is a slot recording the messages published to the topics it subscribes.
+ * journal_replay() publishes the recorded records to a topic registry again,
+ * either at the original pace or as fast as possible to drive benchmarks.
+ *
+ * @{
+ */
+
+/**
+ * @file
+ * @brief The head file for memory mapped journals.
+ */
+
+#include <stdint.h>
+#include "topic.h"
+
+struct __JournalSegment;
+
+/**
+ * @brief The header of a record in a journal.
+ * @details The header is followed by the topic name terminated by '\0' and the message.
+ * Records are aligned by 8 bytes.
+ */
+struct __JournalRecord {
+  uint32_t length; /**< length of the whole record, 0 marks the end of a segment. */
+  uint32_t name_size; /**< size of the topic name without the terminating '\0'. */
+  uint64_t size; /**< size of the message. */
+  uint64_t timestamp; /**< time of recording in nanoseconds of the monotonic clock. */
+  uint64_t sequence; /**< sequence number of the record in the journal. */
+};
+
+/**
+ * @brief The journal structure.
+ * @see journal_open()
+ */
+struct __Journal {
+  struct __JournalSegment *segment; /**< the segment being appended. */
+  struct __JournalSegment *segments; /**< all of the segments opened. */
+  char *prefix; /**< prefix of the segment file names. */
+  size_t segment_size; /**< size of each segment file. */
+  volatile uint64_t sequence; /**< sequence number of the next record. */
+  volatile int error; /**< error number of a failed rotation. */
+};
+
+/**
+ * @brief A slot recording the messages published to topics into a journal.
+ * @see journal_tap_init()
+ */
+struct __JournalTap {
+  TopicSlot slot; /**< the slot to subscribe. */
+  struct __Journal *journal; /**< the journal to record into. */
+  size_t size; /**< size of each message, or 0 if the messages are payload buffers. */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  /**
+   * @brief Create a journal.
+   * @details The existing segment files of the same prefix are overwritten.
+   * @param journal: pointer to the journal.
+   * @param prefix: prefix of the segment file names.
+   * @param segment_size: size of each segment file, which limits the size of a record.
+   * @return 0 on success, or the error number.
+   * @see journal_close()
+   */
+  extern int journal_open(struct __Journal *journal, const char *prefix, size_t segment_size);
+  /**
+   * @brief Close a journal.
+   * @details The segment files are truncated to the recorded data.
+   * @param journal: pointer to the journal.
+   * @note No emitter should be appending meanwhile.
+   */
+  extern void journal_close(struct __Journal *journal);
+  /**
+   * @brief Append a record to a journal.
+   * @param journal: pointer to the journal.
+   * @param name: the topic name.
+   * @param data: the message.
+   * @param size: size of the message.
+   * @return 0 on success, EMSGSIZE if the record is larger than a segment,
+   * or the error number of a failed rotation.
+   */
+  extern int journal_append(struct __Journal *journal, const char *name, const void *data, size_t size);
+  /**
+   * @brief Initialize a journal tap.
+   * @param tap: pointer to the tap, whose slot can be subscribed by topic_subscribe().
+   * @param journal: the journal to record into.
+   * @param size: size of each message, or 0 if the messages are buffers allocated by payload_alloc(),
+   * which is checked by payload_is_buffer() and a message failing it is recorded empty.
+   * A buffer is recorded by the size requested from payload_alloc().
+   * @note The slot of the tap is not reentrant, so use a tap per publishing thread.
+   * @see journal_tap_free()
+   */
+  extern void journal_tap_init(struct __JournalTap *tap, struct __Journal *journal, size_t size);
+  /**
+   * @brief Free a journal tap.
+   * @param tap: pointer to the tap.
+   */
+  extern void journal_tap_free(struct __JournalTap *tap);
+  /**
+   * @brief Publish the records of a journal to a topic registry.
+   * @details The message passed to the slots points to the read-only mapped record,
+   * which is valid during the invocation only.
+   * @param prefix: prefix of the segment file names.
+   * @param registry: the registry to publish to.
+   * @param realtime: nonzero to keep the original intervals between the records,
+   * or 0 to publish as fast as possible.
+   * @return number of the records replayed, or -1 if no journal is found.
+   */
+  extern long journal_replay(const char *prefix, struct __TopicRegistry *registry, int realtime);
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+/** @} */
+
+#endif /* __CONTINUATION_JOURNAL_H */
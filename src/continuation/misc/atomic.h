@@ -0,0 +1,131 @@
+/*
+ * Copyright 2013, Zhou Zhenghui <zhouzhenghui@gmail.com>
+ */
+
+#ifndef __CONTINUATION_ATOMIC_H
+#define __CONTINUATION_ATOMIC_H
+
+/**
+ * @file
+ * @ingroup continuation
+ * @brief Minimal atomic operations on integers and pointers for the lock-free facilities.
+ *
+ * The operations are mapped to the gcc __atomic builtins if available,
+ * otherwise to the legacy gcc __sync builtins.
+ *
+ * Loads are acquire, stores are release and read-modify-write operations are
+ * sequentially consistent unless the \c _RELAXED variant is used.
+ */
+
+/**
+ * @def ATOMIC_LOAD(ptr)
+ * @brief Load the value pointed by \p ptr with acquire semantics.
+ */
+#define ATOMIC_LOAD(ptr) /* Empty definition for Doxygen */
+#undef ATOMIC_LOAD
+
+/**
+ * @def ATOMIC_LOAD_RELAXED(ptr)
+ * @brief Load the value pointed by \p ptr without ordering constraints.
+ */
+#define ATOMIC_LOAD_RELAXED(ptr) /* Empty definition for Doxygen */
+#undef ATOMIC_LOAD_RELAXED
+
+/**
+ * @def ATOMIC_STORE(ptr, value)
+ * @brief Store \p value to the object pointed by \p ptr with release semantics.
+ */
+#define ATOMIC_STORE(ptr, value) /* Empty definition for Doxygen */
+#undef ATOMIC_STORE
+
+/**
+ * @def ATOMIC_STORE_RELAXED(ptr, value)
+ * @brief Store \p value to the object pointed by \p ptr without ordering constraints.
+ */
+#define ATOMIC_STORE_RELAXED(ptr, value) /* Empty definition for Doxygen */
+#undef ATOMIC_STORE_RELAXED
+
+/**
+ * @def ATOMIC_EXCHANGE(ptr, value)
+ * @brief Replace the object pointed by \p ptr with \p value.
+ * @return the previous value.
+ */
+#define ATOMIC_EXCHANGE(ptr, value) /* Empty definition for Doxygen */
+#undef ATOMIC_EXCHANGE
+
+/**
+ * @def ATOMIC_CAS(ptr, expected, desired)
+ * @brief Compare and swap.
+ * @return nonzero if the object pointed by \p ptr equaled to \p expected and was replaced by \p desired.
+ */
+#define ATOMIC_CAS(ptr, expected, desired) /* Empty definition for Doxygen */
+#undef ATOMIC_CAS
+
+/**
+ * @def ATOMIC_FETCH_ADD(ptr, value)
+ * @brief Add \p value to the object pointed by \p ptr.
+ * @return the previous value.
+ */
+#define ATOMIC_FETCH_ADD(ptr, value) /* Empty definition for Doxygen */
+#undef ATOMIC_FETCH_ADD
+
+/**
+ * @def ATOMIC_FETCH_SUB(ptr, value)
+ * @brief Subtract \p value from the object pointed by \p ptr.
+ * @return the previous value.
+ */
+#define ATOMIC_FETCH_SUB(ptr, value) /* Empty definition for Doxygen */
+#undef ATOMIC_FETCH_SUB
+
+/**
+ * @def ATOMIC_FENCE()
+ * @brief Full memory barrier.
+ */
+#define ATOMIC_FENCE() /* Empty definition for Doxygen */
+#undef ATOMIC_FENCE
+
+/**
+ * @def ATOMIC_CPU_RELAX()
+ * @brief Hint the processor that the caller is spinning.
+ */
+#define ATOMIC_CPU_RELAX() /* Empty definition for Doxygen */
+#undef ATOMIC_CPU_RELAX
+
+/** @cond */
+#if defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7))
+# define ATOMIC_LOAD(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+# define ATOMIC_LOAD_RELAXED(ptr) __atomic_load_n(ptr, __ATOMIC_RELAXED)
+# define ATOMIC_STORE(ptr, value) __atomic_store_n(ptr, value, __ATOMIC_RELEASE)
+# define ATOMIC_STORE_RELAXED(ptr, value) __atomic_store_n(ptr, value, __ATOMIC_RELAXED)
+# define ATOMIC_EXCHANGE(ptr, value) __atomic_exchange_n(ptr, value, __ATOMIC_SEQ_CST)
+# define ATOMIC_CAS(ptr, expected, desired) __sync_bool_compare_and_swap(ptr, expected, desired)
+# define ATOMIC_FETCH_ADD(ptr, value) __atomic_fetch_add(ptr, value, __ATOMIC_SEQ_CST)
+# define ATOMIC_FETCH_SUB(ptr, value) __atomic_fetch_sub(ptr, value, __ATOMIC_SEQ_CST)
+# define ATOMIC_FENCE() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#elif defined(__GNUC__)
+# define ATOMIC_LOAD(ptr) __sync_fetch_and_add(ptr, 0)
+# define ATOMIC_LOAD_RELAXED(ptr) (*(volatile __typeof__(*(ptr)) *)(ptr))
+# define ATOMIC_STORE(ptr, value) do { __sync_synchronize(); *(volatile __typeof__(*(ptr)) *)(ptr) = (value); } while (0)
+# define ATOMIC_STORE_RELAXED(ptr, value) (*(volatile __typeof__(*(ptr)) *)(ptr) = (value))
+# define ATOMIC_EXCHANGE(ptr, value) __atomic_exchange_fallback(ptr, value)
+# define __atomic_exchange_fallback(ptr, value) \
+  ({ __typeof__(*(ptr)) __old; do { __old = *(volatile __typeof__(*(ptr)) *)(ptr); } \
+     while (!__sync_bool_compare_and_swap(ptr, __old, value)); __old; })
+# define ATOMIC_CAS(ptr, expected, desired) __sync_bool_compare_and_swap(ptr, expected, desired)
+# define ATOMIC_FETCH_ADD(ptr, value) __sync_fetch_and_add(ptr, value)
+# define ATOMIC_FETCH_SUB(ptr, value) __sync_fetch_and_sub(ptr, value)
+# define ATOMIC_FENCE() __sync_synchronize()
+#else
+# error "no atomic operations available for the compiler"
+#endif
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+# define ATOMIC_CPU_RELAX() __asm__ __volatile__("pause" ::: "memory")
+#elif defined(__GNUC__) && defined(__aarch64__)
+# define ATOMIC_CPU_RELAX() __asm__ __volatile__("yield" ::: "memory")
+#else
+# define ATOMIC_CPU_RELAX() ((void)0)
+#endif
+/** @endcond */
+
+#endif /* __CONTINUATION_ATOMIC_H */
@@ -0,0 +1,332 @@
+/*
+ * Copyright 2013, Zhou Zhenghui <zhouzhenghui@gmail.com>
+ */
+
+#ifndef __CONTINUATION_CONCURRENT_VECTOR_H
+#define __CONTINUATION_CONCURRENT_VECTOR_H
+
+#include <assert.h>
+#include <stdlib.h>
+#include <static_assert/static_assert.h>
+#include "atomic.h"
+
+/**
+ * @file
+ * @ingroup continuation
+ * @brief Append-only array type of user specified objects, which is appended and read concurrently.
+ * @details Unlike VECTOR(), the items are stored in geometrically sized segments which are
+ * never moved, so the pointers to the items keep valid while the vector grows. The segment k
+ * holds CONCURRENT_VECTOR_FIRST_SIZE << k items and is allocated by the first appender reaching it.
+ *
+ * An appender makes sure the segment of the next index is allocated and reserves the index
+ * by a compare-and-swap, stores the item and marks it ready.
+ * The size of the vector is advanced over the ready items by whichever appender finds them,
+ * so that it always counts a prefix of stored items while no appender waits for another.
+ * Reading an item by index is wait-free.
+ *
+ * @see VECTOR()
+ */
+
+/**
+ * @brief Number of items in the first segment of a concurrent vector, as the power of 2.
+ */
+#define CONCURRENT_VECTOR_FIRST_SHIFT 3
+
+/**
+ * @brief Number of items in the first segment of a concurrent vector.
+ */
+#define CONCURRENT_VECTOR_FIRST_SIZE ((size_t)1 << CONCURRENT_VECTOR_FIRST_SHIFT)
+
+/**
+ * @brief Number of segments of a concurrent vector, which cover all of the indexes of size_t.
+ */
+#define CONCURRENT_VECTOR_SEGMENT_COUNT (sizeof(size_t) * 8 - CONCURRENT_VECTOR_FIRST_SHIFT)
+
+/**
+ * @brief The index yielded by CONCURRENT_VECTOR_APPEND_INDEX() if the segment could not be allocated.
+ */
+#define CONCURRENT_VECTOR_NPOS ((size_t)-1)
+
+/**
+ * @internal
+ * @brief Internal type for generic concurrent vector container.
+ */
+struct __ConcurrentVector {
+  void * volatile segment[CONCURRENT_VECTOR_SEGMENT_COUNT]; /**< the segments allocated on demand. */
+  volatile size_t reserved; /**< number of the indexes reserved by the appenders. */
+  volatile size_t size; /**< number of the leading items ready. */
+}
+#if defined(__GNUC__) && (__GNUC__ >= 4 || (__GNUC__ == 3 && __GNUC_MINOR__ >= 3))
+__attribute__((__may_alias__))
+#endif
+;
+
+/**
+ * @brief The concurrent vector type of user specified objects.
+ * @param type: The type of user objects.
+ *
+ * @see CONCURRENT_VECTOR_STATIC_INITIALIZER()
+ * @see CONCURRENT_VECTOR_INIT()
+ * @see CONCURRENT_VECTOR_APPEND()
+ * @see CONCURRENT_VECTOR_FREE()
+ *
+ * @par Example:
+ * @code
+ *   CONCURRENT_VECTOR(SignalSlot *) slot_table;
+ * @endcode
+ */
+#define CONCURRENT_VECTOR(type) \
+  struct {type * volatile segment[CONCURRENT_VECTOR_SEGMENT_COUNT]; volatile size_t reserved; volatile size_t size;}
+
+/**
+ * @brief Static initializer for a concurrent vector at declaration.
+ *
+ * @see CONCURRENT_VECTOR()
+ * @see CONCURRENT_VECTOR_INIT()
+ *
+ * @par Example:
+ * @code
+ *   CONCURRENT_VECTOR(int) int_array = CONCURRENT_VECTOR_STATIC_INITIALIZER();
+ * @endcode
+ */
+#define CONCURRENT_VECTOR_STATIC_INITIALIZER() {{NULL}, 0, 0}
+
+/**
+ * @brief Initialize a concurrent vector at runtime.
+ * @param vector: pointer to the vector.
+ *
+ * @see CONCURRENT_VECTOR()
+ * @see CONCURRENT_VECTOR_STATIC_INITIALIZER()
+ */
+#define CONCURRENT_VECTOR_INIT(vector) \
+do { \
+  (void)STATIC_ASSERT_OR_ZERO(sizeof(struct __ConcurrentVector) == sizeof(*(vector)), incompatible_CONCURRENT_VECTOR_type); \
+  __concurrent_vector_init((struct __ConcurrentVector *)(vector)); \
+} while (0)
+
+/**
+ * @brief Free a concurrent vector.
+ * @param vector: pointer to the vector.
+ * @note No appender or reader should access the vector meanwhile.
+ *
+ * @see CONCURRENT_VECTOR()
+ */
+#define CONCURRENT_VECTOR_FREE(vector) \
+do { \
+  (void)STATIC_ASSERT_OR_ZERO(sizeof(struct __ConcurrentVector) == sizeof(*(vector)), incompatible_CONCURRENT_VECTOR_type); \
+  __concurrent_vector_free((struct __ConcurrentVector *)(vector)); \
+} while (0)
+
+/**
+ * @brief Access specified item.
+ * @details It is evaluated as the reference to the requested element, which never moves.
+ * @param vector: pointer to the vector.
+ * @param i: index in the vector, which is less than CONCURRENT_VECTOR_SIZE().
+ *
+ * @see CONCURRENT_VECTOR()
+ *
+ * @par Example:
+ * @code
+ *   CONCURRENT_VECTOR(int) int_array;
+ *   int i = CONCURRENT_VECTOR_ITEM(&int_array, 0);
+ * @endcode
+ */
+#define CONCURRENT_VECTOR_ITEM(vector, i) \
+  ((vector)->segment[__concurrent_vector_segment(i)][__concurrent_vector_offset(i)])
+
+/**
+ * @brief Number of the items published to a concurrent vector.
+ * @param vector: pointer to the vector.
+ *
+ * @see CONCURRENT_VECTOR()
+ */
+#define CONCURRENT_VECTOR_SIZE(vector) ATOMIC_LOAD(&(vector)->size)
+
+/**
+ * @brief Append an item to the end of a concurrent vector.
+ * @details It is safe to be called by multiple threads concurrently.
+ * The item is dropped if its segment could not be allocated,
+ * use CONCURRENT_VECTOR_APPEND_INDEX() to tell.
+ * @param vector: pointer to the vector.
+ * @param elem: the item.
+ *
+ * @see CONCURRENT_VECTOR()
+ * @see CONCURRENT_VECTOR_APPEND_INDEX()
+ *
+ * @par Example:
+ * @code
+ *   CONCURRENT_VECTOR(int) int_array;
+ *   CONCURRENT_VECTOR_INIT(&int_array);
+ *   CONCURRENT_VECTOR_APPEND(&int_array, 1);
+ * @endcode
+ */
+#define CONCURRENT_VECTOR_APPEND(vector, elem) \
+do { \
+  size_t __index; \
+  CONCURRENT_VECTOR_APPEND_INDEX(vector, elem, __index); \
+  (void)__index; \
+} while (0)
+
+/**
+ * @brief Append an item to the end of a concurrent vector and get its index.
+ * @details It is safe to be called by multiple threads concurrently.
+ * @param vector: pointer to the vector.
+ * @param elem: the item.
+ * @param index: a variable of size_t to store the index of the item,
+ * or CONCURRENT_VECTOR_NPOS if its segment could not be allocated, in which case
+ * the item is not appended.
+ *
+ * @see CONCURRENT_VECTOR()
+ * @see CONCURRENT_VECTOR_APPEND()
+ */
+#define CONCURRENT_VECTOR_APPEND_INDEX(vector, elem, index) \
+do { \
+  size_t __new_index; \
+  (void)STATIC_ASSERT_OR_ZERO(sizeof(struct __ConcurrentVector) == sizeof(*(vector)), incompatible_CONCURRENT_VECTOR_type); \
+  __new_index = __concurrent_vector_reserve((struct __ConcurrentVector *)(vector), sizeof((vector)->segment[0][0])); \
+  if (__new_index != CONCURRENT_VECTOR_NPOS) { \
+    CONCURRENT_VECTOR_ITEM(vector, __new_index) = elem; \
+    __concurrent_vector_publish((struct __ConcurrentVector *)(vector), __new_index, sizeof((vector)->segment[0][0])); \
+  } \
+  (index) = __new_index; \
+} while (0)
+
+/**
+ * @brief Traverse the items published to a concurrent vector.
+ *
+ * The macro expansion is a for-loop, user append
+ * statements block will apply to each traversed item.
+ * The items appended during the traversal are traversed too.
+ *
+ * @param i: pointer to an item of the vector.
+ * @param index: a variable of size_t for the index of the item.
+ * @param vector: pointer to the vector.
+ *
+ * @note \p i and \p index must be declared in advance.
+ *
+ * @see CONCURRENT_VECTOR()
+ * @see VECTOR_FOREACH()
+ *
+ * @par Example:
+ * @code
+ *   CONCURRENT_VECTOR(int) int_array;
+ *   int *i;
+ *   size_t index;
+ *   CONCURRENT_VECTOR_FOREACH(i, index, &int_array) {
+ *     if (*i != 0) ...
+ *   }
+ * @endcode
+ */
+#define CONCURRENT_VECTOR_FOREACH(i, index, vector) \
+  for ((index) = 0; (index) < CONCURRENT_VECTOR_SIZE(vector) && ((i) = &CONCURRENT_VECTOR_ITEM(vector, index), 1); ++(index))
+
+/**
+ * @internal
+ * @brief Internal function for CONCURRENT_VECTOR_ITEM().
+ * @return index of the segment holding the item of index \p i.
+ */
+inline static size_t __concurrent_vector_segment(size_t i)
+{
+  size_t n = (i >> CONCURRENT_VECTOR_FIRST_SHIFT) + 1;
+#if defined(__GNUC__) && (__GNUC__ >= 4)
+  return sizeof(unsigned long long) * 8 - 1 - __builtin_clzll((unsigned long long)n);
+#else
+  size_t k = 0;
+  while (n >>= 1) ++k;
+  return k;
+#endif
+}
+
+/**
+ * @internal
+ * @brief Internal function for CONCURRENT_VECTOR_ITEM().
+ * @return offset of the item of index \p i in its segment.
+ */
+inline static size_t __concurrent_vector_offset(size_t i)
+{
+  return i + CONCURRENT_VECTOR_FIRST_SIZE - (CONCURRENT_VECTOR_FIRST_SIZE << __concurrent_vector_segment(i));
+}
+
+/**
+ * @internal
+ * @brief Internal function for CONCURRENT_VECTOR_INIT().
+ */
+inline static void __concurrent_vector_init(struct __ConcurrentVector *vector)
+{
+  size_t k;
+  for (k = 0; k < CONCURRENT_VECTOR_SEGMENT_COUNT; ++k) vector->segment[k] = NULL;
+  vector->reserved = 0;
+  vector->size = 0;
+}
+
+/**
+ * @internal
+ * @brief Internal function for CONCURRENT_VECTOR_FREE().
+ */
+inline static void __concurrent_vector_free(struct __ConcurrentVector *vector)
+{
+  size_t k;
+  for (k = 0; k < CONCURRENT_VECTOR_SEGMENT_COUNT; ++k) {
+    free(vector->segment[k]);
+    vector->segment[k] = NULL;
+  }
+}
+
+/**
+ * @internal
+ * @brief The ready flag of an item, which follows the items of its segment.
+ * @return pointer to the flag, or NULL if the segment is not allocated yet.
+ */
+inline static volatile char *__concurrent_vector_ready(struct __ConcurrentVector *vector, size_t index, size_t item_size)
+{
+  size_t k = __concurrent_vector_segment(index);
+  char *segment = (char *)ATOMIC_LOAD(&vector->segment[k]);
+  if (segment == NULL) return NULL;
+  return segment + (CONCURRENT_VECTOR_FIRST_SIZE << k) * item_size + __concurrent_vector_offset(index);
+}
+
+/**
+ * @internal
+ * @brief Internal function for CONCURRENT_VECTOR_APPEND() and so on.
+ * @details Make sure the segment of the next index is allocated and reserve the index.
+ * @return the index reserved, or CONCURRENT_VECTOR_NPOS if the segment could not be allocated.
+ */
+inline static size_t __concurrent_vector_reserve(struct __ConcurrentVector *vector, size_t item_size)
+{
+  for (;;) {
+    size_t index = ATOMIC_LOAD(&vector->reserved);
+    size_t k = __concurrent_vector_segment(index);
+    if (ATOMIC_LOAD(&vector->segment[k]) == NULL) {
+      /* the items followed by their ready flags */
+      void *segment = calloc(CONCURRENT_VECTOR_FIRST_SIZE << k, item_size + 1);
+      /* no index is reserved, which would hold the size up forever */
+      if (segment == NULL) return CONCURRENT_VECTOR_NPOS;
+      /* the appenders reaching a new segment race to install it, the losers drop their own */
+      if (!ATOMIC_CAS(&vector->segment[k], NULL, segment)) free(segment);
+    }
+    if (ATOMIC_CAS(&vector->reserved, index, index + 1)) return index;
+  }
+}
+
+/**
+ * @internal
+ * @brief Internal function for CONCURRENT_VECTOR_APPEND() and so on.
+ * @details Mark a stored item ready, and advance the size over the ready items
+ * on behalf of the appenders of the smaller indexes, so that no appender waits for another.
+ */
+inline static void __concurrent_vector_publish(struct __ConcurrentVector *vector, size_t index, size_t item_size)
+{
+  volatile char *ready;
+  size_t size;
+  ATOMIC_STORE(__concurrent_vector_ready(vector, index, item_size), 1);
+  /* against the appender of the previous index checking the flag before it is set */
+  ATOMIC_FENCE();
+  size = ATOMIC_LOAD(&vector->size);
+  /* the flags of the indexes not reserved yet are cleared */
+  while ((ready = __concurrent_vector_ready(vector, size, item_size)) != NULL && ATOMIC_LOAD(ready)) {
+    if (ATOMIC_CAS(&vector->size, size, size + 1)) ++size;
+    else size = ATOMIC_LOAD(&vector->size);
+  }
+}
+
+#endif /* __CONTINUATION_CONCURRENT_VECTOR_H */
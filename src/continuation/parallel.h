@@ -0,0 +1,256 @@
+/*
+ * Copyright 2013, Zhou Zhenghui <zhouzhenghui@gmail.com>
+ */
+
+#ifndef __CONTINUATION_PARALLEL_H
+#define __CONTINUATION_PARALLEL_H
+
+/**
+ * @defgroup parallel parallel loops
+ * @ingroup scheduler
+ * @brief Parallel for and reduce loops run on the workers of a scheduler.
+ * @details ASYNC_FOR() connects the loop body as a continuation and backs up the stack frame
+ * of the host function once. The range of the loop is split in halves on the workers until
+ * a piece is no larger than the grain, the halves are queued to the run queue of the worker
+ * and stolen by the idle workers, which is the work-stealing range splitting. Each piece
+ * restores the same snapshot of the stack frame on its worker and runs the iterations.
+ *
+ * ASYNC_REDUCE() additionally reduces a variable over the iterations. Each worker owns
+ * a private accumulator on its own cache line, the pieces run by the worker accumulate
+ * into it, and the accumulators are merged into the variable after the loop.
+ *
+ * The host function runs pieces as well and returns after all of the iterations are done.
+ *
+ * @{
+ */
+
+/**
+ * @file
+ * @brief The head file for parallel loops.
+ */
+
+#include "scheduler.h"
+
+struct __AsyncFor;
+
+/**
+ * @internal
+ * @brief Structure type represents a piece of the range of a parallel loop.
+ * @details It is the continuation stub of an invocation of the loop body.
+ */
+struct __AsyncForChunk {
+  struct __ContinuationStub cont_stub; /**< the continuation stub. */
+  struct __SchedulerTask task; /**< the scheduler task. */
+  struct __AsyncFor *owner; /**< the loop. */
+  long begin; /**< the first iteration. */
+  long end; /**< the iteration after the last one. */
+  int slot; /**< index of the accumulator of the worker running the piece. */
+  int restored; /**< the stack frame has been restored for the running invocation. */
+};
+
+/** @cond */
+STATIC_ASSERT(offsetof(struct __AsyncForChunk, cont_stub) == 0, self_contraint_of_inheritance_hierarchy_of_struct_AsyncForChunk_failed);
+/** @endcond */
+
+/**
+ * @internal
+ * @brief Structure type represents a parallel loop.
+ * @see ASYNC_FOR()
+ */
+struct __AsyncFor {
+  struct __Continuation cont; /**< the continuation of the loop body. */
+  struct __Scheduler *scheduler; /**< the scheduler to run on. */
+  char *frame; /**< the snapshot of the stack frame of host function shared by the pieces. */
+  long grain; /**< the maximum number of iterations of a piece. */
+  long pending; /**< number of the iterations not done, guarded by \p mutex. */
+  char *accumulators; /**< the accumulators of the workers and the other threads, or NULL. */
+  size_t stride; /**< distance between the accumulators. */
+  int naccumulators; /**< number of the accumulators. */
+  pthread_mutex_t mutex; /**< lock of \p pending. */
+  pthread_cond_t done; /**< signaled when all of the iterations are done. */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  /**
+   * @internal
+   * @brief Internal help function to initialize a parallel loop.
+   * @return the first piece covering the whole range.
+   */
+  extern struct __AsyncForChunk *__async_for_init(struct __AsyncFor *async_for, struct __Scheduler *scheduler
+    , long begin, long end, long grain);
+  /**
+   * @internal
+   * @brief Internal help function to allocate the accumulators initialized with \p value.
+   */
+  extern void __async_for_init_accumulators(struct __AsyncFor *async_for, const void *value, size_t size);
+  /**
+   * @internal
+   * @brief Internal help function to run the loop from the host function and wait for it.
+   */
+  extern void __async_for_run(struct __AsyncFor *async_for, struct __AsyncForChunk *chunk);
+  /**
+   * @internal
+   * @brief Internal help function to free a parallel loop.
+   */
+  extern void __async_for_free(struct __AsyncFor *async_for);
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+/** @cond */
+#define __ASYNC_FOR_ACCUMULATOR(async_for, index, var) \
+  (*(__typeof__(var) *)((async_for)->accumulators + (size_t)(index) * (async_for)->stride))
+
+#define __ASYNC_FOR(scheduler_ptr, i, from, to, grain, prologue, epilogue, finalization, continuation) \
+    { \
+      struct __AsyncFor __async_for; \
+      struct __AsyncForChunk *__ASYNC_TASK = __async_for_init(&__async_for, scheduler_ptr, from, to, grain); \
+      __PP_REMOVE_PARENS(prologue); \
+      CONTINUATION_CONNECT(&__async_for.cont, __ASYNC_TASK \
+        , () \
+        , ( \
+            if (!__ASYNC_TASK->restored) { \
+              CONTINUATION_RESTORE_STACK_FRAME(__ASYNC_TASK, __ASYNC_TASK->owner->frame); \
+              __ASYNC_TASK->restored = 1; \
+              /* enter again, the compiler may load the variables before the restoration */ \
+              __ASYNC_TASK->cont_stub.addr.stack_frame_addr = __ASYNC_TASK->cont_stub.addr.stack_frame_tail \
+                                                              + __ASYNC_TASK->cont_stub.cont->stack_frame_size; \
+              CONTINUATION_STUB_INVOKE(__ASYNC_TASK); \
+            } \
+            for (i = __ASYNC_TASK->begin; i < __ASYNC_TASK->end; ++i) { \
+              __PP_REMOVE_PARENS(continuation); \
+            } \
+            __PP_REMOVE_PARENS(epilogue); \
+        ) \
+      ) { \
+        __async_for.frame = (char *)malloc(__async_for.cont.stack_frame_size); \
+        CONTINUATION_BACKUP_STACK_FRAME(&__async_for.cont, __async_for.frame); \
+      } \
+      __async_for_run(&__async_for, __ASYNC_TASK); \
+      __PP_REMOVE_PARENS(finalization); \
+      CONTINUATION_DESTRUCT(&__async_for.cont); \
+      __async_for_free(&__async_for); \
+    }
+
+#define __ASYNC_REDUCE(scheduler_ptr, var, op, i, from, to, grain, continuation) \
+  __ASYNC_FOR(scheduler_ptr, i, from, to, grain \
+    , ( \
+        __async_for_init_accumulators(&__async_for, &(var), sizeof(var)); \
+    ) \
+    , ( \
+        __ASYNC_FOR_ACCUMULATOR(__ASYNC_TASK->owner, __ASYNC_TASK->slot, var) \
+          = __ASYNC_FOR_ACCUMULATOR(__ASYNC_TASK->owner, __ASYNC_TASK->slot, var) op (var); \
+    ) \
+    , ( \
+        int __async_for_index; \
+        for (__async_for_index = 0; __async_for_index < __async_for.naccumulators; ++__async_for_index) { \
+          (var) = (var) op __ASYNC_FOR_ACCUMULATOR(&__async_for, __async_for_index, var); \
+        } \
+    ) \
+    , continuation)
+/** @endcond */
+
+/**
+ * @brief Run the iterations of a loop in parallel on a scheduler.
+ *
+ * @details The statements are run with \p i from \p begin up to but not including \p end,
+ * in pieces of no more than \p grain iterations. Like ASYNC_SPAWN(), the local variables
+ * of the host function are captured by value, from the same snapshot for all of the pieces,
+ * so an assignment to them in the loop body is seen only by the later iterations of the piece.
+ * The results are written through pointers, or reduced by ASYNC_REDUCE().
+ *
+ * @param scheduler: pointer to the scheduler.
+ * @param i: name of a local variable of integer type as the loop counter.
+ * @param begin: the first iteration.
+ * @param end: the iteration after the last one.
+ * @param grain: the maximum number of iterations of a piece, or 0 to be decided by the number of workers.
+ * @param ...: the statements of the loop body.
+ *
+ * @warning A "break" in the loop body only ends the piece running.
+ *
+ * @see ASYNC_FOR()
+ * @see ASYNC_REDUCE_ON()
+ *
+ * @par Example:
+ * @code
+ *  long i;
+ *  ASYNC_FOR_ON(&scheduler, i, 0, n, 1024,
+ *    y[i] = a * x[i] + y[i];
+ *  );
+ * @endcode
+ */
+#define ASYNC_FOR_ON(scheduler, i, begin, end, grain) /* Empty defintion for Doxygen */
+#undef ASYNC_FOR_ON
+
+/**
+ * @brief Run the iterations of a loop in parallel on the default scheduler.
+ * @see ASYNC_FOR_ON()
+ */
+#define ASYNC_FOR(i, begin, end, grain) /* Empty defintion for Doxygen */
+#undef ASYNC_FOR
+
+/**
+ * @brief Run the iterations of a loop in parallel on a scheduler and reduce a variable.
+ *
+ * @details The variable is accumulated in the loop body by \p op, e.g. "sum += x[i]" for "+",
+ * and the partial results of the workers are combined into it after the loop.
+ *
+ * @param scheduler: pointer to the scheduler.
+ * @param var: name of the local variable to reduce, of a type that \p op applies to.
+ * @param op: a binary operator that is associative and commutative, e.g. +, *, &, | or ^.
+ * @param i: name of a local variable of integer type as the loop counter.
+ * @param begin: the first iteration.
+ * @param end: the iteration after the last one.
+ * @param grain: the maximum number of iterations of a piece, or 0 to be decided by the number of workers.
+ * @param ...: the statements of the loop body.
+ *
+ * @warning \p var must hold the identity of \p op when the loop starts, e.g. 0 for "+" and 1 for "*",
+ * since every piece starts accumulating from it.
+ *
+ * @see ASYNC_FOR_ON()
+ *
+ * @par Example:
+ * @code
+ *  long i;
+ *  double dot = 0;
+ *  ASYNC_REDUCE_ON(&scheduler, dot, +, i, 0, n, 0,
+ *    dot += x[i] * y[i];
+ *  );
+ * @endcode
+ */
+#define ASYNC_REDUCE_ON(scheduler, var, op, i, begin, end, grain) /* Empty defintion for Doxygen */
+#undef ASYNC_REDUCE_ON
+
+/**
+ * @brief Run the iterations of a loop in parallel on the default scheduler and reduce a variable.
+ * @see ASYNC_REDUCE_ON()
+ */
+#define ASYNC_REDUCE(var, op, i, begin, end, grain) /* Empty defintion for Doxygen */
+#undef ASYNC_REDUCE
+
+/** @cond */
+#if BOOST_PP_VARIADICS
+# define ASYNC_FOR_ON(scheduler_ptr, i, begin, end, grain, ...) \
+    __ASYNC_FOR(scheduler_ptr, i, begin, end, grain, (), (), (), (__VA_ARGS__))
+# define ASYNC_FOR(i, begin, end, grain, ...) \
+    __ASYNC_FOR(scheduler_default(), i, begin, end, grain, (), (), (), (__VA_ARGS__))
+# define ASYNC_REDUCE_ON(scheduler_ptr, var, op, i, begin, end, grain, ...) \
+    __ASYNC_REDUCE(scheduler_ptr, var, op, i, begin, end, grain, (__VA_ARGS__))
+# define ASYNC_REDUCE(var, op, i, begin, end, grain, ...) \
+    __ASYNC_REDUCE(scheduler_default(), var, op, i, begin, end, grain, (__VA_ARGS__))
+#else
+# define ASYNC_FOR_ON(scheduler_ptr, i, begin, end, grain, continuation) \
+    __ASYNC_FOR(scheduler_ptr, i, begin, end, grain, (), (), (), continuation)
+# define ASYNC_FOR(i, begin, end, grain, continuation) \
+    __ASYNC_FOR(scheduler_default(), i, begin, end, grain, (), (), (), continuation)
+# define ASYNC_REDUCE_ON __ASYNC_REDUCE
+# define ASYNC_REDUCE(var, op, i, begin, end, grain, continuation) \
+    __ASYNC_REDUCE(scheduler_default(), var, op, i, begin, end, grain, continuation)
+#endif
+/** @endcond */
+
+/** @} */
+
+#endif /* __CONTINUATION_PARALLEL_H */
@@ -0,0 +1,170 @@
+/*
+ * Copyright 2013, Zhou Zhenghui <zhouzhenghui@gmail.com>
+ */
+
+#ifndef __CONTINUATION_PAYLOAD_H
+#define __CONTINUATION_PAYLOAD_H
+
+/**
+ * @defgroup payload payload
+ * @ingroup closure
+ * @brief Reference counted payload buffers for zero-copy emission.
+ * @details The arguments of a closure are copied by value into the closure and again into the
+ * relocated stack frame at every invocation, which is costly for a large message fanned out
+ * to many slots. A payload buffer holds the message once, the emitter passes a pointer to it
+ * as the argument, and each slot that keeps the message beyond its invocation holds
+ * a reference by payload_retain(). The buffer is released when the last reference is dropped.
+ *
+ * The released buffers are cached by size classes in a free list of the releasing thread,
+ * so that the allocation on the hot path neither locks nor calls malloc(). The cache is
+ * flushed by a destructor of thread-specific data when the thread exits under pthread.
+ *
+ * @par Example:
+ * @code
+ *   CLOSURE1(void *) slot;
+ *   struct Quote *quote = (struct Quote *)payload_alloc(sizeof(struct Quote));
+ *   ...
+ *   CLOSURE1_RUN(&slot, quote); // the slot calls payload_retain() to keep the quote
+ *   payload_release(quote);
+ * @endcode
+ *
+ * @{
+ */
+
+/**
+ * @file
+ * @brief The head file for reference counted payload buffers.
+ */
+
+#include "continuation_base.h"
+#include "misc/atomic.h"
+
+/**
+ * @internal
+ * @brief Structure type represents the header of a payload buffer, followed by the data.
+ */
+struct __Payload {
+  struct __Payload *next; /**< link in the free list. */
+  volatile long refcount; /**< the number of references. */
+  size_t length; /**< size of the data requested by payload_alloc(). */
+  int size_class; /**< index of the free list, or -1 for a buffer not cached. */
+  unsigned int magic; /**< __PAYLOAD_MAGIC while the buffer is allocated or cached. */
+};
+
+/**
+ * @internal
+ * @brief The tag telling a payload buffer from other data.
+ */
+#define __PAYLOAD_MAGIC 0x7061796cu
+
+/**
+ * @internal
+ * @brief The usable size of the smallest size class, doubled by each class.
+ */
+#define __PAYLOAD_MIN_SIZE 64
+
+/**
+ * @internal
+ * @brief Size of the header with the data aligned.
+ */
+#define __PAYLOAD_HEADER_SIZE ((sizeof(struct __Payload) + 15) & ~(size_t)15)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  /**
+   * @brief Allocate a payload buffer.
+   * @param size: size of the data.
+   * @return pointer to the data with one reference held by the caller, or NULL if out of memory.
+   * @see payload_release()
+   */
+  extern void *payload_alloc(size_t size);
+  /**
+   * @internal
+   * @brief Recycle a payload buffer without any reference.
+   */
+  extern void __payload_recycle(struct __Payload *payload);
+  /**
+   * @brief Free the payload buffers cached by the calling thread.
+   * @details The cache of a thread is flushed when it exits as well under pthread, so it
+   * only needs to be called by the main thread, or to give the memory back earlier.
+   * Otherwise it should be called before a thread exits.
+   */
+  extern void payload_cache_flush(void);
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+/**
+ * @internal
+ * @brief Get the header of a payload buffer.
+ */
+inline static struct __Payload *__payload_of(const void *data)
+{
+  return (struct __Payload *)((char *)data - __PAYLOAD_HEADER_SIZE);
+}
+
+/**
+ * @brief Hold a reference to a payload buffer.
+ * @param data: pointer to the data of the buffer.
+ * @return \p data.
+ */
+inline static void *payload_retain(void *data)
+{
+  struct __Payload *payload = __payload_of(data);
+  assert(payload->refcount > 0 && "retain a released payload");
+  ATOMIC_FETCH_ADD(&payload->refcount, 1);
+  return data;
+}
+
+/**
+ * @brief Drop a reference to a payload buffer.
+ * @details The buffer is recycled when the last reference is dropped.
+ * @param data: pointer to the data of the buffer.
+ */
+inline static void payload_release(void *data)
+{
+  struct __Payload *payload = __payload_of(data);
+  assert(payload->refcount > 0 && "release a released payload");
+  if (ATOMIC_FETCH_SUB(&payload->refcount, 1) == 1) {
+    __payload_recycle(payload);
+  }
+}
+
+/**
+ * @brief Determine whether a pointer is the data of a payload buffer.
+ * @details It checks the tag in the header, so \p data must be readable
+ * for the header size below it, e.g. a message of a known layout.
+ * @param data: pointer to the data, or NULL.
+ * @return nonzero if \p data is allocated by payload_alloc().
+ */
+inline static int payload_is_buffer(const void *data)
+{
+  return data != NULL && __payload_of(data)->magic == __PAYLOAD_MAGIC;
+}
+
+/**
+ * @brief Get the usable size of a payload buffer.
+ * @param data: pointer to the data of the buffer.
+ * @return the size, which is no less than that allocated.
+ * @see payload_length()
+ */
+inline static size_t payload_size(const void *data)
+{
+  const struct __Payload *payload = __payload_of(data);
+  return payload->size_class < 0 ? payload->length : (size_t)__PAYLOAD_MIN_SIZE << payload->size_class;
+}
+
+/**
+ * @brief Get the size of a payload buffer requested by payload_alloc().
+ * @param data: pointer to the data of the buffer.
+ * @return the size, the rest of the usable size is not initialized.
+ */
+inline static size_t payload_length(const void *data)
+{
+  return __payload_of(data)->length;
+}
+
+/** @} */
+
+#endif /* __CONTINUATION_PAYLOAD_H */
@@ -0,0 +1,129 @@
+/*
+ * Copyright 2013, Zhou Zhenghui <zhouzhenghui@gmail.com>
+ */
+
+#ifndef __CONTINUATION_RECLAIMER_H
+#define __CONTINUATION_RECLAIMER_H
+
+/**
+ * @defgroup reclaimer reclaimer
+ * @ingroup closure
+ * @brief Deferred finalization of closures on a background thread.
+ * @details CLOSURE_FREE() runs the finalization statements of a closure and releases its memory
+ * on the calling thread. CLOSURE_FREE_ASYNC() hands the closure over to a reclaimer instead,
+ * which costs the caller a lock-free push, so that a storm of teardowns doesn't hold up the
+ * request path.
+ *
+ * The reclaimer thread takes all of the closures retired at the moment as a batch, and frees them
+ * in the order they are retired. The closure storage itself belongs to the reclaimer from then on,
+ * since the finalization statements may refer to it, and it is passed to the release function
+ * after the closure is freed, e.g. free() for a closure allocated by malloc().
+ *
+ * @par Example:
+ * @code
+ *  struct Connection *conn = ...;
+ *  // the handler is allocated by malloc() and connected
+ *  CLOSURE_FREE_ASYNC(conn->handler, free);
+ *  conn->handler = NULL;
+ * @endcode
+ * @{
+ */
+
+/**
+ * @file
+ * @brief The head file for deferred finalization of closures.
+ */
+
+#include "continuation_pthread.h"
+#include "closure.h"
+#include "misc/atomic.h"
+
+/**
+ * @internal
+ * @brief Structure type represents a closure retired to a reclaimer.
+ */
+struct __ReclaimerEntry {
+  struct __ReclaimerEntry *next; /**< the entry retired before. */
+  struct __Closure *closure; /**< the closure to be freed. */
+  void (*release)(void *); /**< the function releasing the storage of the closure, or NULL. */
+  void *ptr; /**< the storage of the closure. */
+};
+
+/**
+ * @brief The reclaimer structure.
+ * @see reclaimer_init()
+ */
+struct __Reclaimer {
+  struct __ReclaimerEntry * volatile retired; /**< the closures retired, the latest first. */
+  volatile size_t retired_count; /**< number of the closures ever retired. */
+  size_t reclaimed_count; /**< number of the closures ever freed. */
+  size_t batch_count; /**< number of the batches ever taken. */
+  int stopping; /**< the thread exits once the retired closures are freed. */
+  int error; /**< the error starting the thread, the closures are freed in place if nonzero. */
+  pthread_t thread; /**< the reclaimer thread. */
+  pthread_mutex_t mutex; /**< lock of the counters and the conditions. */
+  pthread_cond_t wakeup; /**< signaled when a closure is retired to an empty reclaimer. */
+  pthread_cond_t reclaimed; /**< signaled when a batch is freed. */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  /**
+   * @brief Initialize a reclaimer and start its thread.
+   * @param reclaimer: pointer to the reclaimer.
+   * @return 0 on success, or an error number of pthread_create().
+   * @see reclaimer_free()
+   */
+  extern int reclaimer_init(struct __Reclaimer *reclaimer);
+  /**
+   * @brief Free the retired closures, stop the thread and free a reclaimer.
+   * @param reclaimer: pointer to the reclaimer.
+   * @note No closure should be retired to the reclaimer meanwhile.
+   */
+  extern void reclaimer_free(struct __Reclaimer *reclaimer);
+  /**
+   * @brief Wait until the closures retired before the call are freed.
+   * @param reclaimer: pointer to the reclaimer.
+   */
+  extern void reclaimer_flush(struct __Reclaimer *reclaimer);
+  /**
+   * @brief Get the default reclaimer of the process.
+   * @details It is created at the first call. If its thread fails to start, the error is
+   * recorded in the reclaimer and the closures retired to it are freed on the calling thread.
+   * @return pointer to the reclaimer.
+   */
+  extern struct __Reclaimer *reclaimer_default(void);
+  /**
+   * @internal
+   * @brief Internal help function to CLOSURE_FREE_ASYNC().
+   */
+  extern void __closure_free_async(struct __Reclaimer *reclaimer, struct __Closure *closure, void (*release)(void *), void *ptr);
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+/**
+ * @brief Disconnect and free a closure on a reclaimer.
+ * @details The finalization statements run on the reclaimer thread if the closure is connected,
+ * then \p closure_ptr is passed to \p release. An unconnected closure is released at once,
+ * and so is any closure if the reclaimer has no thread or the entry can't be allocated.
+ * @param reclaimer: pointer to the reclaimer.
+ * @param closure_ptr: pointer to the closure.
+ * @param release: the function releasing the storage of the closure, or NULL.
+ * @warning The closure must not be invoked or accessed by the caller afterward.
+ * @see CLOSURE_FREE()
+ */
+#define CLOSURE_FREE_ASYNC_ON(reclaimer, closure_ptr, release) \
+  __closure_free_async(reclaimer, &(closure_ptr)->closure, release, (void *)(closure_ptr))
+
+/**
+ * @brief Disconnect and free a closure on the default reclaimer.
+ * @see CLOSURE_FREE_ASYNC_ON()
+ */
+#define CLOSURE_FREE_ASYNC(closure_ptr, release) \
+  CLOSURE_FREE_ASYNC_ON(reclaimer_default(), closure_ptr, release)
+
+/** @} */
+
+#endif /* __CONTINUATION_RECLAIMER_H */
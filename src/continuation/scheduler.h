@@ -0,0 +1,353 @@
+/*
+ * Copyright 2013, Zhou Zhenghui <zhouzhenghui@gmail.com>
+ */
+
+#ifndef __CONTINUATION_SCHEDULER_H
+#define __CONTINUATION_SCHEDULER_H
+
+/**
+ * @defgroup scheduler scheduler
+ * @ingroup continuation_pthread
+ * @brief M:N scheduler that multiplexes continuations over a fixed pool of worker threads.
+ * @details Each worker owns a lock-free work-stealing deque (Chase-Lev), tasks submitted
+ * from outside of the pool are pushed to a lock-free injection list, and idle workers
+ * steal from each other before parking. A task is a tiny intrusive structure, so that
+ * any number of logical tasks can be queued on a few threads.
+ *
+ * ASYNC_SPAWN() connects a statements block as a continuation, backs up the stack frame
+ * of the host function like a closure and queues it to the scheduler. The continuation
+ * is resumed later on any worker by restoring the backup stack frame.
+ *
+ * A task can also be submitted with a delay by scheduler_submit_after(). The timers are
+ * kept in a heap of the scheduler, and the workers submit the expired ones when they run
+ * out of work or every few tasks, and park no longer than the earliest deadline.
+ * @see continuation_pthread
+ *
+ * @{
+ */
+
+/**
+ * @file
+ * @brief The head file for the M:N scheduler of continuations.
+ */
+
+#include <stdint.h>
+#include "continuation_pthread.h"
+#include "fiber.h"
+#include "misc/atomic.h"
+#include "misc/vector.h"
+
+/**
+ * @brief Structure type represents a task to be run by the scheduler.
+ * @details It is intended to be embedded in a user structure.
+ * @see scheduler_task_init()
+ * @see scheduler_submit()
+ */
+struct __SchedulerTask {
+  struct __SchedulerTask *next; /**< link in the injection list of the scheduler. */
+  void (*run)(struct __SchedulerTask *); /**< routine to run the task. */
+};
+
+/**
+ * @internal
+ * @brief The work-stealing deque of a worker.
+ * @details The owner pushes and pops at the bottom, thieves steal from the top.
+ */
+struct __SchedulerDeque {
+  volatile ptrdiff_t top; /**< index to steal from. */
+  char padding[CONTINUATION_CACHE_LINE_SIZE - sizeof(ptrdiff_t)]; /**< keep the thieves and the owner on different cache lines. */
+  volatile ptrdiff_t bottom; /**< index to push to and pop from. */
+  size_t mask; /**< capacity of the circular buffer minus one. */
+  struct __SchedulerTask **tasks; /**< the circular buffer. */
+};
+
+/**
+ * @internal
+ * @brief A task waiting in the timer heap of the scheduler.
+ * @see scheduler_submit_after()
+ */
+struct __SchedulerTimer {
+  uint64_t deadline; /**< time to submit the task in nanoseconds of the monotonic clock. */
+  struct __SchedulerTask *task; /**< the task. */
+};
+
+struct __Scheduler;
+
+/**
+ * @internal
+ * @brief A worker thread of the scheduler.
+ */
+struct __SchedulerWorker {
+  struct __SchedulerDeque deque; /**< the run queue of the worker. */
+  struct __Scheduler *scheduler; /**< the owner scheduler. */
+  pthread_t thread; /**< the worker thread. */
+  unsigned int seed; /**< seed for random victim selection. */
+  int index; /**< index of the worker in the pool. */
+};
+
+/**
+ * @brief The scheduler structure.
+ * @see scheduler_init()
+ * @see scheduler_free()
+ */
+struct __Scheduler {
+  struct __SchedulerTask *injected; /**< lock-free list of tasks submitted from outside of the pool. */
+  struct __SchedulerWorker *workers; /**< the worker pool. */
+  int nworkers; /**< number of workers. */
+  volatile int stopping; /**< the scheduler is going to be freed. */
+  volatile int sleepers; /**< number of parked workers. */
+  pthread_mutex_t mutex; /**< mutex for parking. */
+  pthread_cond_t wakeup; /**< condition variable to wake up parked workers. */
+  VECTOR(struct __SchedulerTimer) timers; /**< min-heap of the timers by deadline, guarded by \p mutex. */
+  volatile uint64_t next_deadline; /**< deadline of the earliest timer, or UINT64_MAX if none. */
+};
+
+/**
+ * @internal
+ * @brief A continuation spawned by ASYNC_SPAWN().
+ * @see ASYNC_SPAWN()
+ */
+struct __AsyncSpawn {
+  struct __ContinuationStub cont_stub; /**< the continuation stub. */
+  struct __Continuation cont; /**< the continuation. */
+  struct __SchedulerTask task; /**< the scheduler task. */
+  struct __Scheduler *scheduler; /**< the scheduler to run on. */
+  char *frame; /**< backup of the stack frame of host function. */
+  int restored; /**< the stack frame has been restored for the running invocation. */
+  int use_fiber; /**< run the continuation on a fiber. */
+  struct __Fiber fiber; /**< the fiber running the continuation if \p use_fiber. */
+};
+
+/** @cond */
+STATIC_ASSERT(offsetof(struct __AsyncSpawn, cont_stub) == 0, self_contraint_of_inheritance_hierarchy_of_struct_AsyncSpawn_failed);
+/** @endcond */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  /**
+   * @brief Initialize a scheduler and start the worker threads.
+   * @param scheduler: pointer to the scheduler.
+   * @param nworkers: number of worker threads, or 0 for the number of online processors.
+   * @return 0 on success, ENOMEM, or an error number of pthread_create(),
+   * in which case nothing is left to be freed.
+   * @see scheduler_free()
+   */
+  extern int scheduler_init(struct __Scheduler *scheduler, int nworkers);
+  /**
+   * @brief Stop the worker threads and free a scheduler.
+   * @details Tasks already submitted are run before the function returns.
+   * @param scheduler: pointer to the scheduler.
+   * @see scheduler_init()
+   */
+  extern void scheduler_free(struct __Scheduler *scheduler);
+  /**
+   * @brief Submit a task to a scheduler.
+   * @details The task is pushed to the run queue of the current worker if called
+   * from a worker of the scheduler, otherwise to the injection list.
+   * @param scheduler: pointer to the scheduler.
+   * @param task: pointer to the task.
+   */
+  extern void scheduler_submit(struct __Scheduler *scheduler, struct __SchedulerTask *task);
+  /**
+   * @brief Submit a task to a scheduler after a delay.
+   * @details The timers still pending when the scheduler is freed are run immediately.
+   * @param scheduler: pointer to the scheduler.
+   * @param task: pointer to the task.
+   * @param delay: the delay in nanoseconds.
+   * @see scheduler_submit()
+   */
+  extern void scheduler_submit_after(struct __Scheduler *scheduler, struct __SchedulerTask *task, uint64_t delay);
+  /**
+   * @brief Take a task submitted by scheduler_submit_after() out of the timers.
+   * @details It is intended to be called by the callbacks of cancel tokens,
+   * which free or submit the task at once.
+   * @param scheduler: pointer to the scheduler.
+   * @param task: pointer to the task.
+   * @return 1 if the task is taken out, or 0 if it is submitted already.
+   * @see cancel_token_register()
+   */
+  extern int scheduler_cancel_timer(struct __Scheduler *scheduler, struct __SchedulerTask *task);
+  /**
+   * @brief Get the default scheduler of the process.
+   * @details It is created at the first call with a worker per online processor,
+   * or a single worker if that many threads can't be created.
+   * @return pointer to the scheduler, or NULL if no worker could be started.
+   */
+  extern struct __Scheduler *scheduler_default(void);
+  /**
+   * @brief Get the index of the worker that runs the calling thread.
+   * @param scheduler: pointer to the scheduler.
+   * @return index of the worker, or -1 if the caller is not a worker of \p scheduler.
+   */
+  extern int scheduler_current_worker(const struct __Scheduler *scheduler);
+  /**
+   * @brief Run a queued task on the calling worker.
+   * @details A task waiting for the others on a worker calls it to keep the worker busy
+   * instead of blocking, which would deadlock if all of the workers are waiting.
+   * @param scheduler: pointer to the scheduler.
+   * @return 1 if a task is run, or 0 if there is none or the caller is not a worker of \p scheduler.
+   */
+  extern int scheduler_help(struct __Scheduler *scheduler);
+  /**
+   * @internal
+   * @brief Internal help function to allocate a continuation for ASYNC_SPAWN().
+   * @details The continuation is taken by __async_spawn_take() on the same thread.
+   * @param scheduler: the scheduler to run on, or NULL if the default one failed to start.
+   * @param use_fiber: run the continuation on a fiber.
+   * @return 0 on success, ENOMEM, or EAGAIN if \p scheduler is NULL.
+   */
+  extern int __async_spawn_new(struct __Scheduler *scheduler, int use_fiber);
+  /**
+   * @internal
+   * @brief Internal help function to take the continuation allocated by __async_spawn_new().
+   * @return the continuation, or NULL if the allocation failed.
+   */
+  extern struct __AsyncSpawn *__async_spawn_take(void);
+  /**
+   * @internal
+   * @brief Internal help function to copy the live stack frame of the host function
+   * into the relocated one, if no backup could be allocated.
+   * @return the continuation, the local variable referring to it may be overwritten by the copy.
+   */
+  extern struct __AsyncSpawn *(*__async_spawn_copy_stack_frame)(struct __AsyncSpawn *);
+  /**
+   * @internal
+   * @brief Internal help function to submit the continuation of ASYNC_SPAWN(),
+   * or run it on the calling thread if the stack frame is not backed up.
+   */
+  extern void __async_spawn_submit(struct __AsyncSpawn *async_spawn);
+  /**
+   * @internal
+   * @brief Internal help function to ASYNC_YIELD().
+   */
+  extern void __async_spawn_yield(struct __AsyncSpawn *async_spawn);
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+/**
+ * @brief Initialize a scheduler task.
+ * @param task: pointer to the task.
+ * @param run: routine to run the task.
+ */
+inline static void scheduler_task_init(struct __SchedulerTask *task, void (*run)(struct __SchedulerTask *))
+{
+  task->next = NULL;
+  task->run = run;
+}
+
+/** @cond */
+#define __ASYNC_SPAWN(scheduler_ptr, continuation) \
+    __async_spawn_new(scheduler_ptr, CONTINUATION_USE_FIBER); \
+    { \
+      struct __AsyncSpawn *__ASYNC_TASK = __async_spawn_take(); \
+      if (__ASYNC_TASK) { \
+        CONTINUATION_CONNECT(&__ASYNC_TASK->cont, __ASYNC_TASK \
+          , () \
+          , ( \
+              if (!__ASYNC_TASK->restored) { \
+                if (__ASYNC_TASK->frame) { \
+                  CONTINUATION_RESTORE_STACK_FRAME(__ASYNC_TASK, __ASYNC_TASK->frame); \
+                } else { \
+                  /* run by the spawning thread, whose stack frame is still live */ \
+                  __ASYNC_TASK = __async_spawn_copy_stack_frame(__ASYNC_TASK); \
+                } \
+                __ASYNC_TASK->restored = 1; \
+                /* enter again, the compiler may load the variables before the restoration */ \
+                __ASYNC_TASK->cont_stub.addr.stack_frame_addr = __ASYNC_TASK->cont_stub.addr.stack_frame_tail \
+                                                                + __ASYNC_TASK->cont.stack_frame_size; \
+                CONTINUATION_STUB_INVOKE(__ASYNC_TASK); \
+              } \
+              { \
+                __PP_REMOVE_PARENS(continuation); \
+              } \
+              CONTINUATION_DESTRUCT(&__ASYNC_TASK->cont); \
+          ) \
+        ) { \
+          __ASYNC_TASK->frame = (char *)malloc(__ASYNC_TASK->cont.stack_frame_size); \
+          if (__ASYNC_TASK->frame) { \
+            CONTINUATION_BACKUP_STACK_FRAME(&__ASYNC_TASK->cont, __ASYNC_TASK->frame); \
+          } \
+        } \
+        __async_spawn_submit(__ASYNC_TASK); \
+      } \
+    }
+/** @endcond */
+
+/**
+ * @brief Run a statements block asynchronously on a scheduler.
+ *
+ * @details Unlike ASYNC_RUN(), no thread is created for the statements block.
+ * The stack frame of the host function is backed up at the moment of spawning,
+ * so the local variables are captured by value and the host function need not
+ * to wait for the continuation.
+ *
+ * With CONTINUATION_USE_FIBER the block runs on a pooled fiber stack and
+ * can be suspended by ASYNC_YIELD().
+ *
+ * It evaluates as an expression of int type like ASYNC_RUN(), which is 0 on success,
+ * or ENOMEM if the continuation could not be allocated, or EAGAIN if the default scheduler
+ * could not be started, in which case the block is not run. If only the backup of the
+ * stack frame could not be allocated, the block is run on the calling thread before
+ * it returns.
+ *
+ * @param scheduler: pointer to the scheduler.
+ * @param ...: the statements to run asynchronously.
+ *
+ * @warning Local variables of the host function, even accessed through a pointer,
+ * may be resolved to the relocated stack frame by the compiler.
+ * Use ASYNC_HOST_VAR() or ASYNC_HOST_VAR_ADDR() to access the variables of the host
+ * function, which are only valid if the host function is still active.
+ *
+ * @see ASYNC_SPAWN()
+ * @see scheduler_init()
+ *
+ * @par Example:
+ * @code
+ *  struct __Scheduler scheduler;
+ *  int *results = (int *)malloc(100 * sizeof(int));
+ *  scheduler_init(&scheduler, 4);
+ *  for (i = 0; i < 100; ++i) {
+ *    int error = ASYNC_SPAWN_ON(&scheduler,
+ *      results[i] = i * i;
+ *    );
+ *    if (error) results[i] = -1;
+ *  }
+ *  scheduler_free(&scheduler);
+ * @endcode
+ */
+#define ASYNC_SPAWN_ON(scheduler) /* Empty defintion for Doxygen */
+#undef ASYNC_SPAWN_ON
+
+/**
+ * @brief Run a statements block asynchronously on the default scheduler.
+ * @param ...: the statements to run asynchronously.
+ * @see ASYNC_SPAWN_ON()
+ * @see scheduler_default()
+ */
+#define ASYNC_SPAWN() /* Empty defintion for Doxygen */
+#undef ASYNC_SPAWN
+
+/**
+ * @brief Suspend the block spawned by ASYNC_SPAWN() to let the other tasks run.
+ * @details The block is queued to the scheduler again and continues later on any worker.
+ * It only works with CONTINUATION_USE_FIBER, otherwise it returns immediately
+ * since the block is run on the stack of the worker.
+ * @see CONTINUATION_USE_FIBER
+ */
+#define ASYNC_YIELD() __async_spawn_yield(__ASYNC_TASK)
+
+/** @cond */
+#if BOOST_PP_VARIADICS
+# define ASYNC_SPAWN_ON(scheduler_ptr, ...) __ASYNC_SPAWN(scheduler_ptr, (__VA_ARGS__))
+# define ASYNC_SPAWN(...) __ASYNC_SPAWN(scheduler_default(), (__VA_ARGS__))
+#else
+# define ASYNC_SPAWN_ON __ASYNC_SPAWN
+# define ASYNC_SPAWN(continuation) __ASYNC_SPAWN(scheduler_default(), continuation)
+#endif
+/** @endcond */
+
+/** @} */
+
+#endif /* __CONTINUATION_SCHEDULER_H */
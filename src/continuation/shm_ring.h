@@ -0,0 +1,174 @@
+/*
+ * Copyright 2013, Zhou Zhenghui <zhouzhenghui@gmail.com>
+ */
+
+#ifndef __CONTINUATION_SHM_RING_H
+#define __CONTINUATION_SHM_RING_H
+
+/**
+ * @defgroup shm_ring shared memory ring
+ * @ingroup closure
+ * @brief Ring buffers in shared memory delivering signals across processes.
+ * @details A shared memory ring is a byte ring of variable sized records mapped by multiple
+ * processes on the same host. Any number of producers append records, and one consumer
+ * dispatches them to a local dispatcher closure, which invokes the slots standing for
+ * the remote ones by the channel number of the records.
+ *
+ * The payloads are zero-copy: a producer reserves the space of a record in the ring,
+ * builds the payload in place and commits it, and the dispatcher reads the payload
+ * in place too. The producers reserve the space by a compare-and-swap of the head, and
+ * commit a record by publishing its length, so that neither side takes a lock.
+ *
+ * The consumer sleeps on a futex in the shared memory when the ring is empty, and only
+ * the producers that find the consumer sleeping issue the wakeup system call. On systems
+ * without futex the consumer naps instead.
+ *
+ * The ring is created on a named POSIX shared memory object, or on an anonymous memory
+ * file whose descriptor is inherited or passed to other processes.
+ *
+ * @par Example:
+ * @code
+ *   // the producer process
+ *   shm_ring_attach(&ring, "/bus.quotes");
+ *   quote = (struct Quote *)shm_ring_reserve(&ring, QUOTE_CHANNEL, sizeof(struct Quote));
+ *   ...
+ *   shm_ring_commit(&ring, quote);
+ *
+ *   // the consumer process
+ *   shm_ring_create(&ring, "/bus.quotes", 1 << 20);
+ *   for (;;) {
+ *     shm_ring_wait(&ring, -1);
+ *     shm_ring_dispatch(&ring, &dispatcher);
+ *   }
+ * @endcode
+ *
+ * @{
+ */
+
+/**
+ * @file
+ * @brief The head file for shared memory rings.
+ */
+
+#include <stdint.h>
+#include "closure.h"
+#include "misc/atomic.h"
+
+/**
+ * @brief Type of the dispatcher closures of shared memory rings.
+ * @details The closure is invoked with the channel number, the pointer to the payload
+ * in the ring and the size of the payload.
+ */
+typedef CLOSURE3(unsigned int, const void *, size_t) ShmRingSlot;
+
+/**
+ * @internal
+ * @brief The control block at the beginning of the shared memory.
+ * @details The positions count bytes from the creation of the ring and never wrap.
+ */
+struct __ShmRingHeader {
+  uint64_t magic; /**< identifies the initialized ring. */
+  uint64_t capacity; /**< size of the data area, a power of 2. */
+  char pad0[48];
+  volatile uint64_t head; /**< position of the next reservation. */
+  char pad1[56];
+  volatile uint64_t tail; /**< position of the next record to dispatch. */
+  volatile uint32_t wakeup; /**< the futex word increased by each wakeup. */
+  volatile uint32_t sleeping; /**< the consumer is going to sleep. */
+  char pad2[48];
+};
+
+/**
+ * @brief The shared memory ring structure, which is local to a process.
+ * @see shm_ring_create()
+ * @see shm_ring_attach()
+ */
+struct __ShmRing {
+  struct __ShmRingHeader *header; /**< the mapped memory. */
+  char *data; /**< the data area following the header. */
+  uint64_t mask; /**< capacity - 1. */
+  size_t size; /**< size of the mapped memory. */
+  int fd; /**< the descriptor of the shared memory. */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  /**
+   * @brief Create a shared memory ring.
+   * @param ring: pointer to the ring.
+   * @param name: name of the POSIX shared memory object beginning with '/',
+   * or NULL to create an anonymous memory file.
+   * @param capacity: size of the data area, which is rounded up to a power of 2.
+   * @return 0 on success, or the error number.
+   * @see shm_ring_close()
+   */
+  extern int shm_ring_create(struct __ShmRing *ring, const char *name, size_t capacity);
+  /**
+   * @brief Attach to a shared memory ring created by another process.
+   * @param ring: pointer to the ring.
+   * @param name: name of the POSIX shared memory object.
+   * @return 0 on success, or the error number.
+   * @see shm_ring_close()
+   */
+  extern int shm_ring_attach(struct __ShmRing *ring, const char *name);
+  /**
+   * @brief Attach to a shared memory ring by a descriptor.
+   * @param ring: pointer to the ring.
+   * @param fd: the descriptor, which is owned by the ring then.
+   * @return 0 on success, or the error number.
+   */
+  extern int shm_ring_attach_fd(struct __ShmRing *ring, int fd);
+  /**
+   * @brief Unmap a shared memory ring and close its descriptor.
+   * @details The named shared memory object persists until shm_unlink() is called.
+   * @param ring: pointer to the ring.
+   */
+  extern void shm_ring_close(struct __ShmRing *ring);
+  /**
+   * @brief Reserve the space of a record in a shared memory ring.
+   * @param ring: pointer to the ring.
+   * @param channel: the channel number of the record.
+   * @param size: size of the payload.
+   * @return pointer to the payload in the ring, or NULL if the ring is full.
+   * @see shm_ring_commit()
+   */
+  extern void *shm_ring_reserve(struct __ShmRing *ring, unsigned int channel, size_t size);
+  /**
+   * @brief Commit a record reserved in a shared memory ring and wake the consumer up.
+   * @param ring: pointer to the ring.
+   * @param payload: pointer to the payload returned by shm_ring_reserve().
+   */
+  extern void shm_ring_commit(struct __ShmRing *ring, void *payload);
+  /**
+   * @brief Copy a payload into a shared memory ring.
+   * @param ring: pointer to the ring.
+   * @param channel: the channel number of the record.
+   * @param payload: the payload.
+   * @param size: size of the payload.
+   * @return 0 on success, or EAGAIN if the ring is full.
+   */
+  extern int shm_ring_send(struct __ShmRing *ring, unsigned int channel, const void *payload, size_t size);
+  /**
+   * @brief Dispatch the committed records of a shared memory ring to a dispatcher closure.
+   * @param ring: pointer to the ring.
+   * @param dispatcher: the dispatcher closure.
+   * @return number of the records dispatched.
+   * @note It must be called by the consumer only.
+   */
+  extern int shm_ring_dispatch(struct __ShmRing *ring, ShmRingSlot *dispatcher);
+  /**
+   * @brief Wait until a record is committed to a shared memory ring.
+   * @param ring: pointer to the ring.
+   * @param timeout: timeout in milliseconds, or -1 to wait infinitely.
+   * @return nonzero if a record is available, or 0 on timeout.
+   * @note It must be called by the consumer only.
+   */
+  extern int shm_ring_wait(struct __ShmRing *ring, int timeout);
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+/** @} */
+
+#endif /* __CONTINUATION_SHM_RING_H */
@@ -0,0 +1,164 @@
+/*
+ * Copyright 2013, Zhou Zhenghui <zhouzhenghui@gmail.com>
+ */
+
+#ifndef __CONTINUATION_SIGNAL_QUEUE_H
+#define __CONTINUATION_SIGNAL_QUEUE_H
+
+/**
+ * @defgroup signal_queue signal queue
+ * @ingroup scheduler
+ * @brief Bounded queues delivering signals to a slot on the scheduler.
+ * @details A signal queue connects the emitters to a slot running on the workers of a scheduler.
+ * The emitted messages are queued and delivered to the slot one by one in order by a task of
+ * the scheduler, so that the slot is never invoked concurrently.
+ *
+ * The queue is bounded. When it is full, an emission is handled by the overflow policy of the queue:
+ * - SIGNAL_QUEUE_BLOCK: the emitter waits until the slot takes a message out.
+ * - SIGNAL_QUEUE_DROP_NEWEST: the emitted message is dropped.
+ * - SIGNAL_QUEUE_DROP_OLDEST: the oldest queued message is dropped.
+ * - SIGNAL_QUEUE_COALESCE: a queued message of the same key is replaced by the emitted one
+ *   regardless of whether the queue is full, or the oldest queued message is dropped if full.
+ *
+ * A slow slot only holds up the emitters of its own queue, and only with SIGNAL_QUEUE_BLOCK.
+ * The task delivering the messages yields the worker after a batch, so that the other queues
+ * and tasks on the scheduler are not starved.
+ *
+ * The dropped and replaced messages are passed to the discard function of the queue
+ * to release the resources, e.g. payload_release().
+ *
+ * @{
+ */
+
+/**
+ * @file
+ * @brief The head file for bounded signal queues.
+ */
+
+#include "scheduler.h"
+#include "closure.h"
+#include "cancel_token.h"
+
+/**
+ * @name Overflow policies
+ * @see signal_queue_init()
+ * @{
+ */
+/** @brief Block the emitter until there is room. */
+#define SIGNAL_QUEUE_BLOCK 0
+/** @brief Drop the emitted message. */
+#define SIGNAL_QUEUE_DROP_NEWEST 1
+/** @brief Drop the oldest queued message. */
+#define SIGNAL_QUEUE_DROP_OLDEST 2
+/** @brief Replace the queued message of the same key, or drop the oldest one. */
+#define SIGNAL_QUEUE_COALESCE 3
+/** @} */
+
+/**
+ * @brief Type of the closures connected to signal queues.
+ * @details The closure is invoked with the message emitted.
+ */
+typedef CLOSURE1(void *) SignalQueueSlot;
+
+/**
+ * @brief The counters of a signal queue.
+ * @see signal_queue_get_stats()
+ */
+struct __SignalQueueStats {
+  size_t emitted; /**< number of the messages emitted. */
+  size_t delivered; /**< number of the messages delivered to the slot. */
+  size_t dropped; /**< number of the messages dropped on overflow. */
+  size_t coalesced; /**< number of the messages replaced by the ones of the same key. */
+  size_t blocked; /**< number of the emissions that have waited for room. */
+  size_t cancelled; /**< number of the emissions cancelled while waiting for room. */
+  size_t high_water; /**< the maximum number of the messages ever queued. */
+};
+
+/**
+ * @internal
+ * @brief Structure type represents a queued message.
+ */
+struct __SignalQueueEntry {
+  long key; /**< the key to coalesce. */
+  void *message; /**< the message. */
+};
+
+/**
+ * @brief The signal queue structure.
+ * @see signal_queue_init()
+ */
+struct __SignalQueue {
+  struct __SchedulerTask task; /**< the task delivering the messages. */
+  struct __Scheduler *scheduler; /**< the scheduler to run the slot on. */
+  SignalQueueSlot *slot; /**< the connected slot. */
+  void (*discard)(void *); /**< the function called with the dropped messages, or NULL. */
+  int policy; /**< the overflow policy. */
+  int scheduled; /**< the task is submitted or running. */
+  struct __SignalQueueEntry *entries; /**< the circular buffer. */
+  size_t capacity; /**< capacity of the buffer. */
+  size_t head; /**< index of the oldest message. */
+  size_t count; /**< number of the messages queued. */
+  struct __SignalQueueStats stats; /**< the counters. */
+  pthread_mutex_t mutex; /**< lock of the queue. */
+  pthread_cond_t not_full; /**< signaled when a message is taken out. */
+  pthread_cond_t idle; /**< signaled when the task finishes with the queue empty. */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  /**
+   * @brief Initialize a signal queue.
+   * @param queue: pointer to the queue.
+   * @param scheduler: the scheduler to run the slot on, or NULL for the default one.
+   * @param slot: the connected slot.
+   * @param capacity: the maximum number of messages queued, which must not be 0.
+   * @param policy: the overflow policy.
+   * @param discard: the function called with the dropped messages, or NULL.
+   * @return 0 on success, or ENOMEM.
+   * @see signal_queue_free()
+   */
+  extern int signal_queue_init(struct __SignalQueue *queue, struct __Scheduler *scheduler, SignalQueueSlot *slot
+    , size_t capacity, int policy, void (*discard)(void *));
+  /**
+   * @brief Wait until the queued messages are delivered and free a signal queue.
+   * @param queue: pointer to the queue.
+   * @note No emission to the queue should happen meanwhile.
+   */
+  extern void signal_queue_free(struct __SignalQueue *queue);
+  /**
+   * @brief Emit a message to a signal queue.
+   * @param queue: pointer to the queue.
+   * @param key: the key to coalesce with SIGNAL_QUEUE_COALESCE, which is ignored otherwise.
+   * @param message: the message.
+   * @return 0 if the message is queued, or EAGAIN if it is dropped.
+   * @warning With SIGNAL_QUEUE_BLOCK, emitting from the workers of the scheduler may
+   * deadlock if all of the workers are blocked.
+   */
+  extern int signal_queue_emit(struct __SignalQueue *queue, long key, void *message);
+  /**
+   * @brief Emit a message to a signal queue, giving up waiting for room on cancellation.
+   * @details With SIGNAL_QUEUE_BLOCK, the emitter stops waiting for room as soon as the token
+   * is cancelled, and the message is passed to the discard function as if dropped.
+   * Otherwise it is the same as signal_queue_emit().
+   * @param queue: pointer to the queue.
+   * @param key: the key to coalesce.
+   * @param message: the message.
+   * @param token: the cancel token, or NULL.
+   * @return 0 if the message is queued, EAGAIN if it is dropped, or ECANCELED if cancelled.
+   * @see signal_queue_emit()
+   */
+  extern int signal_queue_emit_cancellable(struct __SignalQueue *queue, long key, void *message, struct __CancelToken *token);
+  /**
+   * @brief Get a snapshot of the counters of a signal queue.
+   * @param queue: pointer to the queue.
+   * @param stats: pointer to the structure to be filled.
+   */
+  extern void signal_queue_get_stats(struct __SignalQueue *queue, struct __SignalQueueStats *stats);
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+/** @} */
+
+#endif /* __CONTINUATION_SIGNAL_QUEUE_H */
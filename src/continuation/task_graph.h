@@ -0,0 +1,137 @@
+/*
+ * Copyright 2013, Zhou Zhenghui <zhouzhenghui@gmail.com>
+ */
+
+#ifndef __CONTINUATION_TASK_GRAPH_H
+#define __CONTINUATION_TASK_GRAPH_H
+
+/**
+ * @defgroup task_graph task graph
+ * @ingroup scheduler
+ * @brief Dataflow graphs of closures run on the scheduler.
+ * @details A task graph is a directed acyclic graph whose nodes are connected closures and
+ * whose edges are the dependencies between them. A node runs on the workers of a scheduler
+ * as soon as all of its predecessors have run, so the independent nodes run in parallel.
+ *
+ * Each node counts down its predecessors by an atomic counter. The worker finishing a node
+ * continues with one of the successors made ready by it and queues the others, where the
+ * idle workers steal them.
+ *
+ * A graph is built once and run as many times as needed, e.g. once per batch. A run only
+ * resets the counters, so no memory is allocated after the graph is built. The argument
+ * of task_graph_run() is passed to every node of the run.
+ *
+ * @par Example:
+ * @code
+ *  struct __TaskGraph graph;
+ *  TaskGraphClosure *parse = ..., *index = ..., *stats = ..., *commit = ...;
+ *  struct __TaskGraphNode *a, *b, *c, *d;
+ *  task_graph_init(&graph, NULL);
+ *  a = task_graph_add(&graph, parse);
+ *  b = task_graph_add(&graph, index);
+ *  c = task_graph_add(&graph, stats);
+ *  d = task_graph_add(&graph, commit);
+ *  task_graph_depend(b, a);
+ *  task_graph_depend(c, a);
+ *  task_graph_depend(d, b);
+ *  task_graph_depend(d, c);
+ *  while ((batch = next_batch()) != NULL) {
+ *    task_graph_run(&graph, batch);
+ *  }
+ *  task_graph_free(&graph);
+ * @endcode
+ * @{
+ */
+
+/**
+ * @file
+ * @brief The head file for task graphs.
+ */
+
+#include "scheduler.h"
+#include "closure.h"
+
+/**
+ * @brief Type of the closures of task graph nodes.
+ * @details The closure is invoked with the argument of task_graph_run().
+ */
+typedef CLOSURE1(void *) TaskGraphClosure;
+
+struct __TaskGraph;
+
+/**
+ * @brief Structure type represents a node of task graph.
+ * @see task_graph_add()
+ */
+struct __TaskGraphNode {
+  struct __SchedulerTask task; /**< the scheduler task. */
+  struct __TaskGraph *graph; /**< the graph. */
+  TaskGraphClosure *closure; /**< the connected closure. */
+  struct __TaskGraphNode **successors; /**< the nodes depending on this one. */
+  int nsuccessors; /**< number of the successors. */
+  int capacity; /**< capacity of \p successors. */
+  int npredecessors; /**< number of the nodes this one depends on. */
+  volatile int pending; /**< number of the predecessors not run in the current run. */
+};
+
+/**
+ * @brief The task graph structure.
+ * @see task_graph_init()
+ */
+struct __TaskGraph {
+  struct __Scheduler *scheduler; /**< the scheduler to run the nodes on. */
+  struct __TaskGraphNode **nodes; /**< the nodes in the order they are added. */
+  int nnodes; /**< number of the nodes. */
+  int capacity; /**< capacity of \p nodes. */
+  void *arg; /**< the argument of the current run. */
+  int remaining; /**< number of the nodes not run in the current run, guarded by \p mutex. */
+  pthread_mutex_t mutex; /**< lock of \p remaining. */
+  pthread_cond_t done; /**< signaled when all of the nodes have run. */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  /**
+   * @brief Initialize an empty task graph.
+   * @param graph: pointer to the graph.
+   * @param scheduler: the scheduler to run the nodes on, or NULL for the default one.
+   * @see task_graph_free()
+   */
+  extern void task_graph_init(struct __TaskGraph *graph, struct __Scheduler *scheduler);
+  /**
+   * @brief Free a task graph and its nodes.
+   * @details The closures are owned by the caller and not freed.
+   * @param graph: pointer to the graph, which must not be running.
+   */
+  extern void task_graph_free(struct __TaskGraph *graph);
+  /**
+   * @brief Add a node to a task graph.
+   * @param graph: pointer to the graph, which must not be running.
+   * @param closure: the connected closure run by the node.
+   * @return the node, or NULL if out of memory.
+   */
+  extern struct __TaskGraphNode *task_graph_add(struct __TaskGraph *graph, TaskGraphClosure *closure);
+  /**
+   * @brief Make a node run after another one.
+   * @param node: the node.
+   * @param predecessor: the node to run before \p node, of the same graph.
+   * @return 0 on success, or ENOMEM.
+   * @warning The dependencies must not form a cycle, or the run never finishes.
+   */
+  extern int task_graph_depend(struct __TaskGraphNode *node, struct __TaskGraphNode *predecessor);
+  /**
+   * @brief Run all of the nodes of a task graph and wait for them.
+   * @details A worker of the scheduler running a graph keeps running the tasks of the
+   * scheduler while waiting.
+   * @param graph: pointer to the graph, which must not be running.
+   * @param arg: the argument passed to the closures of the nodes.
+   */
+  extern void task_graph_run(struct __TaskGraph *graph, void *arg);
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+/** @} */
+
+#endif /* __CONTINUATION_TASK_GRAPH_H */
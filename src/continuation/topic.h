@@ -0,0 +1,193 @@
+/*
+ * Copyright 2013, Zhou Zhenghui <zhouzhenghui@gmail.com>
+ */
+
+#ifndef __CONTINUATION_TOPIC_H
+#define __CONTINUATION_TOPIC_H
+
+/**
+ * @defgroup topic topic
+ * @ingroup closure
+ * @brief Publish/subscribe of closures by hierarchical topic names.
+ * @details A topic name consists of segments separated by '.', e.g. "orders.eu.fill".
+ * The closures subscribe to topic patterns, in which a segment "*" matches exactly one
+ * segment and a segment "#" matches zero or more segments, e.g. "orders.*.fill" or "orders.#".
+ *
+ * The patterns are kept in a trie of segments held by a topic registry. The trie is
+ * read-mostly: the subscribers are serialized by a spin lock of the registry, while the
+ * publishers walk the trie without any lock. The nodes of the trie are never freed until
+ * the registry is freed, so that a publisher never sees a dangling node.
+ *
+ * A topic name can be resolved to a topic handle, which caches the matched nodes of the trie,
+ * so that the publishers of a hot topic skip string matching entirely. The handle is
+ * resolved again only when new nodes have been added to the trie since.
+ *
+ * @par Example:
+ * @code
+ *   struct __TopicRegistry registry;
+ *   struct __TopicHandle handle;
+ *   TopicSlot slot;
+ *
+ *   topic_registry_init(&registry);
+ *   CLOSURE_INIT(&slot);
+ *   CLOSURE_CONNECT(&slot
+ *     , ()
+ *     , (
+ *       printf("%s: %s\n", CLOSURE_ARG_OF_(&slot)->_1, (char *)CLOSURE_ARG_OF_(&slot)->_2);
+ *     )
+ *     , ()
+ *   );
+ *   topic_subscribe(&registry, "orders.*.fill", &slot);
+ *
+ *   topic_publish(&registry, "orders.eu.fill", "filled");
+ *
+ *   topic_resolve(&registry, "orders.us.fill", &handle);
+ *   topic_publish_handle(&handle, "filled");
+ *   topic_handle_free(&handle);
+ *
+ *   topic_registry_free(&registry);
+ *   CLOSURE_FREE(&slot);
+ * @endcode
+ *
+ * @{
+ */
+
+/**
+ * @file
+ * @brief The head file for publish/subscribe by topics.
+ */
+
+#include "closure.h"
+#include "misc/vector.h"
+#include "misc/atomic.h"
+
+/**
+ * @brief Type of the closures subscribed to topics.
+ * @details The closure is invoked with the name of the topic published as the first
+ * argument and the message as the second argument.
+ * @warning A closure is not reentrant, so a slot must not be published concurrently from
+ * multiple threads.
+ */
+typedef CLOSURE2(const char *, void *) TopicSlot;
+
+struct __TopicNode;
+
+/**
+ * @brief Structure type represents a subscription of a slot to a topic pattern.
+ * @see topic_subscribe()
+ */
+struct __TopicSubscription {
+  struct __TopicSubscription *next; /**< next subscription of the node. */
+  struct __TopicSubscription *retired_next; /**< next subscription retired by the registry. */
+  struct __TopicNode *node; /**< the node of the topic pattern. */
+  TopicSlot *slot; /**< the subscribed slot. */
+  volatile int active; /**< the subscription is not cancelled. */
+};
+
+/**
+ * @internal
+ * @brief Structure type represents a segment in the topic trie.
+ */
+struct __TopicNode {
+  struct __TopicNode *next; /**< next sibling. */
+  struct __TopicNode *children; /**< the first child. */
+  struct __TopicSubscription *subscriptions; /**< the subscriptions of the pattern ended at the node. */
+  size_t length; /**< length of the segment. */
+  char segment[1]; /**< the segment terminated by '\0'. */
+};
+
+/**
+ * @brief Structure type represents a topic registry.
+ * @see topic_registry_init()
+ */
+struct __TopicRegistry {
+  struct __TopicNode *root; /**< the root of the trie. */
+  struct __TopicSubscription *retired; /**< the cancelled subscriptions to be freed with the registry. */
+  volatile unsigned int version; /**< increased whenever a node is added to the trie. */
+  volatile int lock; /**< spin lock of the subscribers. */
+};
+
+/**
+ * @brief Structure type represents a resolved topic name.
+ * @see topic_resolve()
+ */
+struct __TopicHandle {
+  struct __TopicRegistry *registry; /**< the registry resolved in. */
+  char *name; /**< copy of the topic name. */
+  unsigned int version; /**< version of the registry when resolved. */
+  VECTOR(struct __TopicNode *) nodes; /**< the matched nodes. */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  /**
+   * @brief Initialize a topic registry.
+   * @param registry: pointer to the registry.
+   * @return 0 on success, or ENOMEM.
+   * @see topic_registry_free()
+   */
+  extern int topic_registry_init(struct __TopicRegistry *registry);
+  /**
+   * @brief Free a topic registry with all of its subscriptions.
+   * @param registry: pointer to the registry.
+   * @note The slots are not freed, and no publisher should be running.
+   */
+  extern void topic_registry_free(struct __TopicRegistry *registry);
+  /**
+   * @brief Subscribe a slot to a topic pattern.
+   * @param registry: pointer to the registry.
+   * @param pattern: the topic pattern, in which "*" and "#" must be whole segments.
+   * @param slot: pointer to the slot, which should be connected already.
+   * @return pointer to the subscription, or NULL if out of memory.
+   * @see topic_unsubscribe()
+   */
+  extern struct __TopicSubscription *topic_subscribe(struct __TopicRegistry *registry, const char *pattern, TopicSlot *slot);
+  /**
+   * @brief Cancel a subscription.
+   * @details The slot is not invoked by the publishing started after it returns,
+   * and the subscription is freed with the registry.
+   * @param registry: pointer to the registry.
+   * @param subscription: pointer to the subscription.
+   */
+  extern void topic_unsubscribe(struct __TopicRegistry *registry, struct __TopicSubscription *subscription);
+  /**
+   * @brief Publish a message to all of the slots subscribed to the patterns matching a topic name.
+   * @param registry: pointer to the registry.
+   * @param name: the topic name.
+   * @param message: the message passed to the slots.
+   * @return number of the slots invoked, or -ENOMEM if the matched patterns could not be
+   * collected, in which case none of the slots is invoked.
+   * @see topic_publish_handle()
+   */
+  extern int topic_publish(struct __TopicRegistry *registry, const char *name, void *message);
+  /**
+   * @brief Resolve a topic name to a handle.
+   * @param registry: pointer to the registry.
+   * @param name: the topic name.
+   * @param handle: pointer to the handle to be initialized.
+   * @return 0 on success, or ENOMEM.
+   * @see topic_handle_free()
+   */
+  extern int topic_resolve(struct __TopicRegistry *registry, const char *name, struct __TopicHandle *handle);
+  /**
+   * @brief Free a topic handle.
+   * @param handle: pointer to the handle.
+   */
+  extern void topic_handle_free(struct __TopicHandle *handle);
+  /**
+   * @brief Publish a message by a topic handle.
+   * @details The name is matched again only if the trie has changed since the handle was resolved.
+   * @param handle: pointer to the handle.
+   * @param message: the message passed to the slots.
+   * @return number of the slots invoked, or -ENOMEM like topic_publish().
+   * @warning A handle must not be used by multiple threads concurrently.
+   */
+  extern int topic_publish_handle(struct __TopicHandle *handle, void *message);
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+/** @} */
+
+#endif /* __CONTINUATION_TOPIC_H */
@@ -3,21 +3,32 @@
  */
 
 #include "continuation/continuation_pthread.h"
+#include <errno.h>
+
+#if ASYNC_SCOPE_USE_FUTEX
+# include <limits.h>
+# include <linux/futex.h>
+# include <sys/syscall.h>
+# include <unistd.h>
+#endif
 
 pthread_key_t __async_pthread_key;
 
 static void * __async_pthread_run(struct __AsyncTask * async_task);
 static struct __AsyncTask *async_copy_stack_frame(struct __AsyncTask *async_task);
+static struct __AsyncSharedTask *async_shared_copy_stack_frame(struct __AsyncSharedTask *task);
+static void async_scope_leave(struct __AsyncScope *scope);
 
 /* these function pointers prevent link-time optimization */
 struct __AsyncTask *(*__async_copy_stack_frame)(struct __AsyncTask *) = &async_copy_stack_frame;
+struct __AsyncSharedTask *(*__async_shared_copy_stack_frame)(struct __AsyncSharedTask *) = &async_shared_copy_stack_frame;
 
 static void make_key()
 {
   pthread_key_create(&__async_pthread_key, NULL);
 }
 
-pthread_t __async_pthread_create()
+pthread_t __async_pthread_create(struct __AsyncScope *scope)
 {
   static pthread_once_t __async_pthread_once = PTHREAD_ONCE_INIT;
   pthread_t pthread_id;
@@ -25,14 +36,21 @@ pthread_t __async_pthread_create()
   struct __AsyncTask *async_task = (struct __AsyncTask *)malloc(sizeof(struct __AsyncTask));
   pthread_once(&__async_pthread_once, make_key);
   async_task->quitable = 0;
+  async_task->scope = scope;
   pthread_mutex_init(&async_task->mutex, NULL);
   pthread_cond_init(&async_task->running, NULL);
+  /* counted before the thread may leave the scope */
+  if (scope) ATOMIC_FETCH_ADD(&scope->pending, 1);
   /* run thread with async_task as it's argument */
   pthread_mutex_lock(&async_task->mutex);
   error = pthread_create(&pthread_id, NULL, (void *(*)(void *))&__async_pthread_run, (void *)async_task);
   if (error) {
+      if (scope) ATOMIC_FETCH_SUB(&scope->pending, 1);
       free(async_task);
       async_task = NULL;
+  } else if (scope) {
+      /* waited by the scope instead of being joined */
+      pthread_detach(pthread_id);
   }
   pthread_setspecific(__async_pthread_key, async_task);
   return pthread_id;
@@ -40,11 +58,13 @@ pthread_t __async_pthread_create()
 
 static void * __async_pthread_run(struct __AsyncTask * async_task)
 {
+  struct __AsyncScope *scope = async_task->scope;
   /* ensure the parent thread had prepared the continuation */
   pthread_mutex_lock(&async_task->mutex);
   pthread_mutex_unlock(&async_task->mutex);
   assert(async_task->cont_stub.cont == &async_task->cont);
   continuation_stub_invoke(&async_task->cont_stub);
+  continuation_invoke_stack_free();
   /* ensure the parent thread had released the lock */
   pthread_mutex_lock(&async_task->mutex);
   if (!async_task->quitable) {
@@ -54,15 +74,137 @@ static void * __async_pthread_run(struct __AsyncTask * async_task)
   pthread_cond_destroy(&async_task->running);
   pthread_mutex_destroy(&async_task->mutex);
   free(async_task);
+  if (scope) async_scope_leave(scope);
   return NULL;
 }
 
+void __async_scope_init(struct __AsyncScope *scope, struct __AsyncScope *parent)
+{
+  scope->parent = parent;
+  scope->pending = 0;
+  scope->cancelled = 0;
+#if !ASYNC_SCOPE_USE_FUTEX
+  pthread_mutex_init(&scope->mutex, NULL);
+  pthread_cond_init(&scope->done, NULL);
+#endif
+}
+
+void __async_scope_join(struct __AsyncScope *scope)
+{
+#if ASYNC_SCOPE_USE_FUTEX
+  int pending;
+  /* only the last task wakes up the scope, the others just change the word */
+  while ((pending = ATOMIC_LOAD(&scope->pending)) != 0) {
+    syscall(SYS_futex, &scope->pending, FUTEX_WAIT_PRIVATE, pending, NULL, NULL, 0);
+  }
+#else
+  pthread_mutex_lock(&scope->mutex);
+  while (ATOMIC_LOAD(&scope->pending) != 0) {
+    pthread_cond_wait(&scope->done, &scope->mutex);
+  }
+  pthread_mutex_unlock(&scope->mutex);
+  pthread_cond_destroy(&scope->done);
+  pthread_mutex_destroy(&scope->mutex);
+#endif
+}
+
+static void async_scope_leave(struct __AsyncScope *scope)
+{
+#if ASYNC_SCOPE_USE_FUTEX
+  /* the scope may be left before the wakeup, which is harmless on a stale address */
+  if (ATOMIC_FETCH_SUB(&scope->pending, 1) == 1) {
+    syscall(SYS_futex, &scope->pending, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+  }
+#else
+  pthread_mutex_lock(&scope->mutex);
+  if (ATOMIC_FETCH_SUB(&scope->pending, 1) == 1) {
+    pthread_cond_broadcast(&scope->done);
+  }
+  pthread_mutex_unlock(&scope->mutex);
+#endif
+}
+
+/* the snapshot allocated by __async_shared_new() and not yet taken */
+static CONTINUATION_THREAD_LOCAL struct __AsyncShared *async_shared_pending = NULL;
+
+int __async_shared_new(void)
+{
+  struct __AsyncShared *shared = (struct __AsyncShared *)malloc(sizeof(struct __AsyncShared));
+  async_shared_pending = shared;
+  if (shared == NULL) return ENOMEM;
+  shared->frame = NULL;
+  shared->refcount = 1;
+  return 0;
+}
+
+struct __AsyncShared *__async_shared_take(void)
+{
+  struct __AsyncShared *shared = async_shared_pending;
+  async_shared_pending = NULL;
+  return shared;
+}
+
+void __async_shared_free(struct __AsyncShared *shared)
+{
+  free(shared->frame);
+  free(shared);
+}
+
+static void *async_shared_task_run(struct __AsyncSharedTask *task)
+{
+  struct __AsyncShared *shared = task->shared;
+  struct __AsyncScope *scope = task->scope;
+  continuation_stub_invoke(&task->cont_stub);
+  continuation_invoke_stack_free();
+  if (task->last) __async_shared_free(shared);
+  free(task);
+  if (scope) async_scope_leave(scope);
+  return NULL;
+}
+
+void __async_shared_run(struct __AsyncShared *shared, long n, struct __AsyncScope *scope)
+{
+  long i;
+  for (i = 0; i < n; ++i) {
+    pthread_t pthread_id;
+    struct __AsyncSharedTask inline_task;
+    struct __AsyncSharedTask *task = (struct __AsyncSharedTask *)malloc(sizeof(struct __AsyncSharedTask));
+    if (task == NULL) task = &inline_task;
+    continuation_stub_init(&task->cont_stub, &shared->cont);
+    task->shared = shared;
+    task->scope = scope;
+    task->index = i;
+    task->restored = 0;
+    task->last = 0;
+    ATOMIC_FETCH_ADD(&shared->refcount, 1);
+    /* without a snapshot, the tasks read the stack frame of the host function */
+    if (task != &inline_task && shared->frame != NULL) {
+      if (scope) ATOMIC_FETCH_ADD(&scope->pending, 1);
+      if (pthread_create(&pthread_id, NULL, (void *(*)(void *))&async_shared_task_run, (void *)task) == 0) {
+        pthread_detach(pthread_id);
+        continue;
+      }
+      if (scope) ATOMIC_FETCH_SUB(&scope->pending, 1);
+    }
+    /* run on the calling thread, the host function still holds a reference of the snapshot */
+    continuation_stub_invoke(&task->cont_stub);
+    assert(!task->last);
+    if (task != &inline_task) free(task);
+  }
+}
+
 static struct __AsyncTask *async_copy_stack_frame(struct __AsyncTask *async_task)
 {
   struct __ContinuationStub *cont_stub = &async_task->cont_stub;
   struct __Continuation *cont = &async_task->cont;
-  memcpy(cont_stub->addr.stack_frame_tail
-          , cont->stack_frame_tail
-          , cont->stack_frame_size);
+  continuation_copy_frame(cont, cont_stub->addr.stack_frame_tail, cont->stack_frame_tail);
   return async_task;
 }
+
+static struct __AsyncSharedTask *async_shared_copy_stack_frame(struct __AsyncSharedTask *task)
+{
+  struct __ContinuationStub *cont_stub = &task->cont_stub;
+  struct __Continuation *cont = cont_stub->cont;
+  continuation_copy_frame(cont, cont_stub->addr.stack_frame_tail, cont->stack_frame_tail);
+  return task;
+}
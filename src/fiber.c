@@ -0,0 +1,340 @@
+/*
+ * Copyright 2013, Zhou Zhenghui <zhouzhenghui@gmail.com>
+ */
+
+#include "continuation/fiber.h"
+#include "continuation/misc/atomic.h"
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(__GNUC__) && ((defined(__x86_64__) && !defined(_WIN64)) || defined(__aarch64__))
+# define FIBER_USE_ASM 1
+#else
+# define FIBER_USE_ASM 0
+# include <ucontext.h>
+#endif
+
+#ifndef MAP_ANONYMOUS
+# define MAP_ANONYMOUS MAP_ANON
+#endif
+
+/* default number of stacks cached by a pool */
+#define FIBER_STACK_POOL_CAPACITY 64
+
+/*
+ * The structure lives at the top of the mapped memory,
+ * the stack grows downward from it to the guard page.
+ */
+struct __FiberStack {
+  struct __FiberStack *next; /* link in the pool */
+  char *memory; /* the mapped memory, beginning with the guard page */
+  size_t size; /* size of the mapped memory */
+#if !FIBER_USE_ASM
+  ucontext_t context;
+  ucontext_t caller_context;
+#endif
+};
+
+void __fiber_main(struct __Fiber *fiber);
+
+#if FIBER_USE_ASM
+/*
+ * Save the callee-saved registers on the current stack, store the stack pointer
+ * to *sp_ptr, then switch to the stack pointer sp and restore the registers from it.
+ * The floating-point control registers, MXCSR and the x87 control word on x86-64,
+ * are callee-saved as well, so a fiber changing the rounding mode keeps it to itself.
+ */
+void __fiber_switch(void **sp_ptr, void *sp);
+void __fiber_trampoline(void);
+
+# if defined(__APPLE__)
+#   define FIBER_SYMBOL(name) "_" #name
+#   define FIBER_CALL(name) FIBER_SYMBOL(name)
+#   define FIBER_FUNCTION(name) ".globl " FIBER_SYMBOL(name) "\n" ".private_extern " FIBER_SYMBOL(name) "\n" FIBER_SYMBOL(name) ":\n"
+# else
+#   define FIBER_SYMBOL(name) #name
+#   define FIBER_CALL(name) #name "@PLT"
+#   define FIBER_FUNCTION(name) ".globl " #name "\n" ".hidden " #name "\n" ".type " #name ", @function\n" #name ":\n"
+# endif
+
+# if defined(__x86_64__)
+__asm__(
+  ".text\n"
+  FIBER_FUNCTION(__fiber_switch)
+  "  pushq %rbp\n"
+  "  pushq %rbx\n"
+  "  pushq %r12\n"
+  "  pushq %r13\n"
+  "  pushq %r14\n"
+  "  pushq %r15\n"
+  "  subq $8, %rsp\n"
+  "  stmxcsr (%rsp)\n"
+  "  fnstcw 4(%rsp)\n"
+  "  movq %rsp, (%rdi)\n"
+  "  movq %rsi, %rsp\n"
+  "  ldmxcsr (%rsp)\n"
+  "  fldcw 4(%rsp)\n"
+  "  addq $8, %rsp\n"
+  "  popq %r15\n"
+  "  popq %r14\n"
+  "  popq %r13\n"
+  "  popq %r12\n"
+  "  popq %rbx\n"
+  "  popq %rbp\n"
+  "  ret\n"
+  FIBER_FUNCTION(__fiber_trampoline)
+  "  movq %rbx, %rdi\n"
+  "  call " FIBER_CALL(__fiber_main) "\n"
+  "  ud2\n"
+);
+
+static void *fiber_stack_prepare(struct __Fiber *fiber, char *stack_top)
+{
+  /* control registers, r15, r14, r13, r12, rbx, rbp, return address, padding to align the call in trampoline */
+  void **sp = (void **)((size_t)stack_top & ~(size_t)15) - 10;
+  sp[0] = sp[1] = sp[2] = sp[3] = sp[4] = NULL;
+  sp[5] = fiber; /* rbx */
+  sp[6] = NULL; /* rbp */
+  sp[7] = (void *)&__fiber_trampoline;
+  sp[8] = sp[9] = NULL;
+  /* the fiber starts with the floating-point modes of its creator */
+  __asm__ __volatile__(
+    "stmxcsr (%0)\n"
+    "fnstcw 4(%0)\n"
+    : : "r"(sp) : "memory"
+  );
+  return sp;
+}
+# elif defined(__aarch64__)
+__asm__(
+  ".text\n"
+  ".p2align 2\n"
+  FIBER_FUNCTION(__fiber_switch)
+  "  sub sp, sp, #160\n"
+  "  stp x19, x20, [sp, #0]\n"
+  "  stp x21, x22, [sp, #16]\n"
+  "  stp x23, x24, [sp, #32]\n"
+  "  stp x25, x26, [sp, #48]\n"
+  "  stp x27, x28, [sp, #64]\n"
+  "  stp x29, x30, [sp, #80]\n"
+  "  stp d8, d9, [sp, #96]\n"
+  "  stp d10, d11, [sp, #112]\n"
+  "  stp d12, d13, [sp, #128]\n"
+  "  stp d14, d15, [sp, #144]\n"
+  "  mov x9, sp\n"
+  "  str x9, [x0]\n"
+  "  mov sp, x1\n"
+  "  ldp x19, x20, [sp, #0]\n"
+  "  ldp x21, x22, [sp, #16]\n"
+  "  ldp x23, x24, [sp, #32]\n"
+  "  ldp x25, x26, [sp, #48]\n"
+  "  ldp x27, x28, [sp, #64]\n"
+  "  ldp x29, x30, [sp, #80]\n"
+  "  ldp d8, d9, [sp, #96]\n"
+  "  ldp d10, d11, [sp, #112]\n"
+  "  ldp d12, d13, [sp, #128]\n"
+  "  ldp d14, d15, [sp, #144]\n"
+  "  add sp, sp, #160\n"
+  "  ret\n"
+  FIBER_FUNCTION(__fiber_trampoline)
+  "  mov x0, x19\n"
+  "  bl " FIBER_SYMBOL(__fiber_main) "\n"
+  "  brk #0\n"
+);
+
+static void *fiber_stack_prepare(struct __Fiber *fiber, char *stack_top)
+{
+  void **sp = (void **)((size_t)stack_top & ~(size_t)15) - 20;
+  memset(sp, 0, 20 * sizeof(void *));
+  sp[0] = fiber; /* x19 */
+  sp[11] = (void *)&__fiber_trampoline; /* x30 */
+  return sp;
+}
+# endif
+#else /* FIBER_USE_ASM */
+/* makecontext() passes int arguments only */
+static void fiber_context_main(unsigned int high, unsigned int low)
+{
+  __fiber_main((struct __Fiber *)(((size_t)high << 16 << 16) | (size_t)low));
+}
+#endif /* !FIBER_USE_ASM */
+
+static size_t fiber_page_size()
+{
+  static size_t page_size = 0;
+  if (page_size == 0) {
+    page_size = (size_t)sysconf(_SC_PAGESIZE);
+  }
+  return page_size;
+}
+
+static void fiber_stack_pool_lock(struct __FiberStackPool *pool)
+{
+  while (ATOMIC_EXCHANGE(&pool->lock, 1)) {
+    while (ATOMIC_LOAD_RELAXED(&pool->lock)) ATOMIC_CPU_RELAX();
+  }
+}
+
+static void fiber_stack_pool_unlock(struct __FiberStackPool *pool)
+{
+  ATOMIC_STORE(&pool->lock, 0);
+}
+
+static struct __FiberStack *fiber_stack_alloc(struct __FiberStackPool *pool)
+{
+  struct __FiberStack *stack;
+  char *memory;
+  size_t size;
+  fiber_stack_pool_lock(pool);
+  stack = pool->stacks;
+  if (stack) {
+    pool->stacks = stack->next;
+    --pool->count;
+  }
+  fiber_stack_pool_unlock(pool);
+  if (stack) return stack;
+
+  size = fiber_page_size() + pool->stack_size;
+  memory = (char *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == (char *)MAP_FAILED) return NULL;
+  /* the guard page */
+  if (mprotect(memory, fiber_page_size(), PROT_NONE) != 0) {
+    munmap(memory, size);
+    return NULL;
+  }
+  stack = (struct __FiberStack *)((size_t)(memory + size - sizeof(struct __FiberStack)) & ~(size_t)15);
+  stack->memory = memory;
+  stack->size = size;
+  return stack;
+}
+
+static void fiber_stack_release(struct __FiberStackPool *pool, struct __FiberStack *stack)
+{
+  fiber_stack_pool_lock(pool);
+  if (pool->count < pool->capacity) {
+    stack->next = pool->stacks;
+    pool->stacks = stack;
+    ++pool->count;
+    stack = NULL;
+  }
+  fiber_stack_pool_unlock(pool);
+  if (stack) {
+    munmap(stack->memory, stack->size);
+  }
+}
+
+void fiber_stack_pool_init(struct __FiberStackPool *pool, size_t stack_size, int capacity)
+{
+  size_t page_size = fiber_page_size();
+  if (stack_size == 0) stack_size = CONTINUATION_FIBER_STACK_SIZE;
+  pool->stacks = NULL;
+  pool->stack_size = (stack_size + page_size - 1) / page_size * page_size;
+  pool->count = 0;
+  pool->capacity = capacity;
+  pool->lock = 0;
+}
+
+void fiber_stack_pool_free(struct __FiberStackPool *pool)
+{
+  struct __FiberStack *stack;
+  fiber_stack_pool_lock(pool);
+  stack = pool->stacks;
+  pool->stacks = NULL;
+  pool->count = 0;
+  fiber_stack_pool_unlock(pool);
+  while (stack) {
+    struct __FiberStack *next = stack->next;
+    munmap(stack->memory, stack->size);
+    stack = next;
+  }
+}
+
+static CONTINUATION_THREAD_LOCAL struct __Fiber *fiber_running = NULL;
+
+static struct __FiberStackPool fiber_stack_pool_default_instance = {
+  NULL, CONTINUATION_FIBER_STACK_SIZE, 0, FIBER_STACK_POOL_CAPACITY, 0
+};
+
+struct __FiberStackPool *fiber_stack_pool_default(void)
+{
+  return &fiber_stack_pool_default_instance;
+}
+
+int fiber_init(struct __Fiber *fiber, struct __FiberStackPool *pool, void (*func)(void *), void *arg)
+{
+  if (pool == NULL) pool = fiber_stack_pool_default();
+  fiber->stack = fiber_stack_alloc(pool);
+  if (fiber->stack == NULL) return ENOMEM;
+  fiber->pool = pool;
+  fiber->caller_sp = NULL;
+  fiber_reset(fiber, func, arg, 0);
+  return 0;
+}
+
+void fiber_reset(struct __Fiber *fiber, void (*func)(void *), void *arg, size_t reserve)
+{
+  assert(fiber->caller_sp == NULL && "reset a running fiber");
+  assert(reserve < fiber->pool->stack_size);
+  fiber->func = func;
+  fiber->arg = arg;
+  fiber->finished = 0;
+#if FIBER_USE_ASM
+  fiber->sp = fiber_stack_prepare(fiber, (char *)fiber->stack - reserve);
+#else
+  getcontext(&fiber->stack->context);
+  fiber->stack->context.uc_stack.ss_sp = fiber->stack->memory + fiber_page_size();
+  fiber->stack->context.uc_stack.ss_size = (size_t)((char *)fiber->stack - reserve - (char *)fiber->stack->context.uc_stack.ss_sp);
+  fiber->stack->context.uc_link = NULL;
+  makecontext(&fiber->stack->context, (void (*)())fiber_context_main, 2
+    , (unsigned int)((size_t)fiber >> 16 >> 16), (unsigned int)(size_t)fiber);
+  fiber->sp = &fiber->stack->context;
+#endif
+}
+
+void fiber_free(struct __Fiber *fiber)
+{
+  assert(fiber->caller_sp == NULL && "free a running fiber");
+  fiber_stack_release(fiber->pool, fiber->stack);
+  fiber->stack = NULL;
+}
+
+void fiber_resume(struct __Fiber *fiber)
+{
+  struct __Fiber *resumer = fiber_running;
+  assert(!fiber->finished && "resume a finished fiber");
+  assert(fiber->caller_sp == NULL && "resume a running fiber");
+  fiber_running = fiber;
+#if FIBER_USE_ASM
+  __fiber_switch(&fiber->caller_sp, fiber->sp);
+#else
+  fiber->caller_sp = &fiber->stack->caller_context;
+  swapcontext(&fiber->stack->caller_context, &fiber->stack->context);
+#endif
+  fiber->caller_sp = NULL;
+  fiber_running = resumer;
+}
+
+void fiber_yield(struct __Fiber *fiber)
+{
+  assert(fiber->caller_sp != NULL && "yield from a fiber not running");
+#if FIBER_USE_ASM
+  __fiber_switch(&fiber->sp, fiber->caller_sp);
+#else
+  swapcontext(&fiber->stack->context, &fiber->stack->caller_context);
+#endif
+}
+
+struct __Fiber *fiber_current(void)
+{
+  return fiber_running;
+}
+
+void __fiber_main(struct __Fiber *fiber)
+{
+  fiber->func(fiber->arg);
+  fiber->finished = 1;
+  fiber_yield(fiber);
+  assert(0 && "resume a finished fiber");
+}
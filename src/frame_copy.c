@@ -0,0 +1,139 @@
+/*
+ * Copyright 2013, Zhou Zhenghui <zhouzhenghui@gmail.com>
+ */
+
+#include "continuation/continuation_base.h"
+#include "continuation/misc/atomic.h"
+#include <string.h>
+
+/*
+ * The size classes of stack frames: below 16, up to 32, 64, 128, 256 bytes and the larger.
+ * Each class is copied by a straight-line kernel of the widest vectors that fit,
+ * and the largest class by a loop of 4 vectors.
+ */
+#define FRAME_COPY_CLASS_COUNT 6
+
+static ContinuationFrameCopy frame_copy_kernels[FRAME_COPY_CLASS_COUNT];
+static volatile int frame_copy_selected = 0;
+
+inline static int frame_copy_class(size_t size)
+{
+  if (size < 16) return 0;
+  if (size <= 32) return 1;
+  if (size <= 64) return 2;
+  if (size <= 128) return 3;
+  if (size <= 256) return 4;
+  return 5;
+}
+
+#if CONTINUATION_USE_VECTOR_FRAME_COPY
+
+#include <immintrin.h>
+
+/*
+ * Define the kernels of a vector type:
+ *  frame_copy_<isa>_2 copies from 1 to 2 vectors by 2 overlapped vectors;
+ *  frame_copy_<isa>_4 copies from 2 to 4 vectors by 4 overlapped vectors;
+ *  frame_copy_<isa>_loop copies 4 vectors or more, the tail by the overlapped last 4 vectors.
+ */
+#define FRAME_COPY_KERNELS(isa, isa_target, vector, load, store) \
+  __attribute__((target(isa_target))) \
+  static void *frame_copy_##isa##_2(void *dst, const void *src, size_t size) \
+  { \
+    vector a = load((const vector *)src); \
+    vector b = load((const vector *)((const char *)src + size - sizeof(vector))); \
+    store((vector *)dst, a); \
+    store((vector *)((char *)dst + size - sizeof(vector)), b); \
+    return dst; \
+  } \
+  __attribute__((target(isa_target))) \
+  static void *frame_copy_##isa##_4(void *dst, const void *src, size_t size) \
+  { \
+    const char *tail = (const char *)src + size - 2 * sizeof(vector); \
+    vector a = load((const vector *)src); \
+    vector b = load((const vector *)src + 1); \
+    vector c = load((const vector *)tail); \
+    vector d = load((const vector *)tail + 1); \
+    store((vector *)dst, a); \
+    store((vector *)dst + 1, b); \
+    store((vector *)((char *)dst + size - 2 * sizeof(vector)), c); \
+    store((vector *)((char *)dst + size - 2 * sizeof(vector)) + 1, d); \
+    return dst; \
+  } \
+  __attribute__((target(isa_target))) \
+  static void *frame_copy_##isa##_loop(void *dst, const void *src, size_t size) \
+  { \
+    const char *s = (const char *)src; \
+    char *d = (char *)dst; \
+    const char *tail = s + size - 4 * sizeof(vector); \
+    vector t0 = load((const vector *)tail); \
+    vector t1 = load((const vector *)tail + 1); \
+    vector t2 = load((const vector *)tail + 2); \
+    vector t3 = load((const vector *)tail + 3); \
+    for (; s < tail; s += 4 * sizeof(vector), d += 4 * sizeof(vector)) { \
+      vector a = load((const vector *)s); \
+      vector b = load((const vector *)s + 1); \
+      vector c = load((const vector *)s + 2); \
+      vector e = load((const vector *)s + 3); \
+      store((vector *)d, a); \
+      store((vector *)d + 1, b); \
+      store((vector *)d + 2, c); \
+      store((vector *)d + 3, e); \
+    } \
+    d = (char *)dst + size - 4 * sizeof(vector); \
+    store((vector *)d, t0); \
+    store((vector *)d + 1, t1); \
+    store((vector *)d + 2, t2); \
+    store((vector *)d + 3, t3); \
+    return dst; \
+  }
+
+FRAME_COPY_KERNELS(sse2, "sse2", __m128i, _mm_loadu_si128, _mm_storeu_si128)
+FRAME_COPY_KERNELS(avx2, "avx2", __m256i, _mm256_loadu_si256, _mm256_storeu_si256)
+FRAME_COPY_KERNELS(avx512, "avx512f", __m512i, _mm512_loadu_si512, _mm512_storeu_si512)
+
+static void frame_copy_select_kernels(void)
+{
+  int i;
+  for (i = 0; i < FRAME_COPY_CLASS_COUNT; ++i) frame_copy_kernels[i] = memcpy;
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    frame_copy_kernels[1] = frame_copy_sse2_2;
+    frame_copy_kernels[2] = frame_copy_avx2_2;
+    frame_copy_kernels[3] = frame_copy_avx512_2;
+    frame_copy_kernels[4] = frame_copy_avx512_4;
+    frame_copy_kernels[5] = frame_copy_avx512_loop;
+  } else if (__builtin_cpu_supports("avx2")) {
+    frame_copy_kernels[1] = frame_copy_sse2_2;
+    frame_copy_kernels[2] = frame_copy_avx2_2;
+    frame_copy_kernels[3] = frame_copy_avx2_4;
+    frame_copy_kernels[4] = frame_copy_avx2_loop;
+    frame_copy_kernels[5] = frame_copy_avx2_loop;
+  } else if (__builtin_cpu_supports("sse2")) {
+    frame_copy_kernels[1] = frame_copy_sse2_2;
+    frame_copy_kernels[2] = frame_copy_sse2_4;
+    frame_copy_kernels[3] = frame_copy_sse2_loop;
+    frame_copy_kernels[4] = frame_copy_sse2_loop;
+    frame_copy_kernels[5] = frame_copy_sse2_loop;
+  }
+}
+
+#else
+
+static void frame_copy_select_kernels(void)
+{
+  int i;
+  for (i = 0; i < FRAME_COPY_CLASS_COUNT; ++i) frame_copy_kernels[i] = memcpy;
+}
+
+#endif /* CONTINUATION_USE_VECTOR_FRAME_COPY */
+
+ContinuationFrameCopy continuation_select_frame_copy(size_t size)
+{
+  /* racing threads select the same kernels */
+  if (!ATOMIC_LOAD(&frame_copy_selected)) {
+    frame_copy_select_kernels();
+    ATOMIC_STORE(&frame_copy_selected, 1);
+  }
+  return frame_copy_kernels[frame_copy_class(size)];
+}
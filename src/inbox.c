@@ -0,0 +1,144 @@
+/*
+ * Copyright 2013, Zhou Zhenghui <zhouzhenghui@gmail.com>
+ */
+
+#include "continuation/inbox.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+# define INBOX_USE_EVENTFD 1
+# include <sys/eventfd.h>
+#else
+# define INBOX_USE_EVENTFD 0
+#endif
+
+static CONTINUATION_THREAD_LOCAL struct __Inbox *inbox_bound = NULL;
+
+int inbox_init(struct __Inbox *inbox)
+{
+  inbox->items = NULL;
+#if INBOX_USE_EVENTFD
+  inbox->fds[0] = inbox->fds[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (inbox->fds[0] < 0) return errno;
+#else
+  if (pipe(inbox->fds) != 0) return errno;
+  fcntl(inbox->fds[0], F_SETFL, fcntl(inbox->fds[0], F_GETFL) | O_NONBLOCK);
+  fcntl(inbox->fds[1], F_SETFL, fcntl(inbox->fds[1], F_GETFL) | O_NONBLOCK);
+  fcntl(inbox->fds[0], F_SETFD, FD_CLOEXEC);
+  fcntl(inbox->fds[1], F_SETFD, FD_CLOEXEC);
+#endif
+  return 0;
+}
+
+void inbox_free(struct __Inbox *inbox)
+{
+  struct __InboxItem *item = ATOMIC_EXCHANGE(&inbox->items, NULL);
+  while (item) {
+    struct __InboxItem *next = item->next;
+    if (item->allocated) free(item);
+    item = next;
+  }
+  close(inbox->fds[0]);
+  if (inbox->fds[1] != inbox->fds[0]) close(inbox->fds[1]);
+  if (inbox_bound == inbox) inbox_bound = NULL;
+}
+
+static void inbox_wake(struct __Inbox *inbox)
+{
+#if INBOX_USE_EVENTFD
+  uint64_t value = 1;
+#else
+  char value = 1;
+#endif
+  /* a full pipe or counter is already readable */
+  while (write(inbox->fds[1], &value, sizeof(value)) < 0 && errno == EINTR);
+}
+
+static void inbox_reset(struct __Inbox *inbox)
+{
+#if INBOX_USE_EVENTFD
+  uint64_t value;
+  while (read(inbox->fds[0], &value, sizeof(value)) < 0 && errno == EINTR);
+#else
+  char buf[64];
+  while (read(inbox->fds[0], buf, sizeof(buf)) > 0 || errno == EINTR);
+#endif
+}
+
+void inbox_post(struct __Inbox *inbox, struct __InboxItem *item)
+{
+  struct __InboxItem *head;
+  do {
+    head = ATOMIC_LOAD_RELAXED(&inbox->items);
+    item->next = head;
+  } while (!ATOMIC_CAS(&inbox->items, head, item));
+  /* the owner has taken all of the items before, wake it up for the new batch */
+  if (head == NULL) {
+    inbox_wake(inbox);
+  }
+}
+
+int inbox_emit(struct __Inbox *inbox, InboxSlot *slot, void *message)
+{
+  struct __InboxItem *item = (struct __InboxItem *)malloc(sizeof(struct __InboxItem));
+  if (item == NULL) return ENOMEM;
+  item->slot = slot;
+  item->message = message;
+  item->allocated = 1;
+  inbox_post(inbox, item);
+  return 0;
+}
+
+int inbox_drain(struct __Inbox *inbox)
+{
+  struct __InboxItem *item, *batch = NULL;
+  int count = 0;
+
+  /* reset before taking the items, so that a later post wakes the owner again */
+  inbox_reset(inbox);
+  item = ATOMIC_EXCHANGE(&inbox->items, NULL);
+  /* restore the order of emission */
+  while (item) {
+    struct __InboxItem *next = item->next;
+    item->next = batch;
+    batch = item;
+    item = next;
+  }
+  while (batch) {
+    InboxSlot *slot = batch->slot;
+    void *message = batch->message;
+    item = batch;
+    batch = batch->next;
+    if (item->allocated) free(item);
+    CLOSURE_RUN_N(1, slot, (message));
+    ++count;
+  }
+  return count;
+}
+
+int inbox_wait(struct __Inbox *inbox, int timeout)
+{
+  struct pollfd pfd;
+  int result;
+  if (ATOMIC_LOAD_RELAXED(&inbox->items)) return 1;
+  pfd.fd = inbox->fds[0];
+  pfd.events = POLLIN;
+  do {
+    result = poll(&pfd, 1, timeout);
+  } while (result < 0 && errno == EINTR);
+  return result > 0;
+}
+
+void inbox_bind(struct __Inbox *inbox)
+{
+  inbox_bound = inbox;
+}
+
+struct __Inbox *inbox_current(void)
+{
+  return inbox_bound;
+}
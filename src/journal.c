@@ -0,0 +1,282 @@
+/*
+ * Copyright 2013, Zhou Zhenghui <zhouzhenghui@gmail.com>
+ */
+
+#include "continuation/journal.h"
+#include "continuation/payload.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/* the file header of a segment: magic and index */
+#define JOURNAL_MAGIC "SBJOURNL"
+#define JOURNAL_HEADER_SIZE 16
+#define JOURNAL_ALIGN(size) (((size) + 7) & ~(size_t)7)
+/* the suffix of segment file names */
+#define JOURNAL_SUFFIX_FORMAT ".%06u"
+#define JOURNAL_SUFFIX_SIZE 16
+
+struct __JournalSegment {
+  struct __JournalSegment *next; /* link in the segments of the journal */
+  char *memory; /* the mapped file */
+  int fd;
+  unsigned int index;
+  volatile size_t reserved; /* offset of the next record, may exceed the segment */
+  volatile long writers; /* number of the emitters writing into the segment */
+};
+
+static uint64_t journal_now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static char *journal_segment_path(const char *prefix, unsigned int index)
+{
+  size_t size = strlen(prefix) + JOURNAL_SUFFIX_SIZE;
+  char *path = (char *)malloc(size);
+  if (path) snprintf(path, size, "%s" JOURNAL_SUFFIX_FORMAT, prefix, index);
+  return path;
+}
+
+static struct __JournalSegment *journal_segment_create(struct __Journal *journal, unsigned int index)
+{
+  struct __JournalSegment *segment;
+  char *path = journal_segment_path(journal->prefix, index);
+  int fd, error;
+
+  if (path == NULL) {
+    errno = ENOMEM;
+    return NULL;
+  }
+  fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  error = errno;
+  free(path);
+  if (fd < 0) {
+    errno = error;
+    return NULL;
+  }
+  segment = (struct __JournalSegment *)malloc(sizeof(struct __JournalSegment));
+  if (segment == NULL || ftruncate(fd, (off_t)journal->segment_size) != 0) {
+    error = segment ? errno : ENOMEM;
+    free(segment);
+    close(fd);
+    errno = error;
+    return NULL;
+  }
+  segment->memory = (char *)mmap(NULL, journal->segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (segment->memory == (char *)MAP_FAILED) {
+    error = errno;
+    free(segment);
+    close(fd);
+    errno = error;
+    return NULL;
+  }
+  memcpy(segment->memory, JOURNAL_MAGIC, 8);
+  *(uint32_t *)(segment->memory + 8) = index;
+  segment->fd = fd;
+  segment->index = index;
+  segment->reserved = JOURNAL_HEADER_SIZE;
+  segment->writers = 0;
+  /* only the rotating emitter and journal_open() get here */
+  segment->next = journal->segments;
+  journal->segments = segment;
+  return segment;
+}
+
+/* unmap a segment no longer written and cut the file to the records */
+static void journal_segment_finish(struct __Journal *journal, struct __JournalSegment *segment, size_t used)
+{
+  while (ATOMIC_LOAD(&segment->writers)) sched_yield();
+  munmap(segment->memory, journal->segment_size);
+  segment->memory = NULL;
+  if (ftruncate(segment->fd, (off_t)used) != 0) {
+    /* the rest is zero filled and ends the records anyway */
+  }
+  close(segment->fd);
+  segment->fd = -1;
+}
+
+int journal_open(struct __Journal *journal, const char *prefix, size_t segment_size)
+{
+  size_t size = strlen(prefix) + 1;
+  assert(segment_size > JOURNAL_HEADER_SIZE + sizeof(struct __JournalRecord));
+  journal->prefix = (char *)malloc(size);
+  if (journal->prefix == NULL) return ENOMEM;
+  memcpy(journal->prefix, prefix, size);
+  journal->segment_size = JOURNAL_ALIGN(segment_size);
+  journal->segments = NULL;
+  journal->sequence = 0;
+  journal->error = 0;
+  journal->segment = journal_segment_create(journal, 0);
+  if (journal->segment == NULL) {
+    int error = errno;
+    free(journal->prefix);
+    return error;
+  }
+  return 0;
+}
+
+void journal_close(struct __Journal *journal)
+{
+  struct __JournalSegment *segment = journal->segments;
+  if (journal->segment) {
+    size_t used = journal->segment->reserved;
+    journal_segment_finish(journal, journal->segment, used < journal->segment_size ? used : journal->segment_size);
+  }
+  while (segment) {
+    struct __JournalSegment *next = segment->next;
+    free(segment);
+    segment = next;
+  }
+  journal->segments = NULL;
+  journal->segment = NULL;
+  free(journal->prefix);
+  journal->prefix = NULL;
+}
+
+static int journal_rotate(struct __Journal *journal, struct __JournalSegment *segment, size_t used)
+{
+  struct __JournalSegment *next = journal_segment_create(journal, segment->index + 1);
+  if (next == NULL) {
+    ATOMIC_STORE(&journal->error, errno);
+    return errno;
+  }
+  /* a full barrier against the emitters entering the old segment */
+  ATOMIC_EXCHANGE(&journal->segment, next);
+  journal_segment_finish(journal, segment, used);
+  return 0;
+}
+
+int journal_append(struct __Journal *journal, const char *name, const void *data, size_t size)
+{
+  size_t name_size = strlen(name);
+  size_t length = JOURNAL_ALIGN(sizeof(struct __JournalRecord) + name_size + 1 + size);
+  uint64_t timestamp = journal_now();
+
+  if (length > journal->segment_size - JOURNAL_HEADER_SIZE) return EMSGSIZE;
+  for (;;) {
+    struct __JournalSegment *segment = ATOMIC_LOAD(&journal->segment);
+    size_t offset;
+    int error = ATOMIC_LOAD_RELAXED(&journal->error);
+    if (error) return error;
+    ATOMIC_FETCH_ADD(&segment->writers, 1);
+    if (ATOMIC_LOAD(&journal->segment) != segment) {
+      /* rotated meanwhile */
+      ATOMIC_FETCH_SUB(&segment->writers, 1);
+      continue;
+    }
+    offset = ATOMIC_FETCH_ADD(&segment->reserved, length);
+    if (offset + length <= journal->segment_size) {
+      struct __JournalRecord *record = (struct __JournalRecord *)(segment->memory + offset);
+      char *p = (char *)(record + 1);
+      record->name_size = (uint32_t)name_size;
+      record->size = size;
+      record->timestamp = timestamp;
+      record->sequence = ATOMIC_FETCH_ADD(&journal->sequence, 1);
+      memcpy(p, name, name_size + 1);
+      memcpy(p + name_size + 1, data, size);
+      /* commit the record */
+      ATOMIC_STORE(&record->length, (uint32_t)length);
+      ATOMIC_FETCH_SUB(&segment->writers, 1);
+      return 0;
+    }
+    ATOMIC_FETCH_SUB(&segment->writers, 1);
+    if (offset <= journal->segment_size) {
+      /* the first reservation overflowing the segment rotates it */
+      error = journal_rotate(journal, segment, offset);
+      if (error) return error;
+    } else {
+      while (ATOMIC_LOAD(&journal->segment) == segment && !ATOMIC_LOAD_RELAXED(&journal->error)) {
+        sched_yield();
+      }
+    }
+  }
+}
+
+void journal_tap_init(struct __JournalTap *tap, struct __Journal *journal, size_t size)
+{
+  tap->journal = journal;
+  tap->size = size;
+  CLOSURE_INIT(&tap->slot);
+  CLOSURE_CONNECT(&tap->slot
+    , (
+      CLOSURE_RETAIN_VAR(tap);
+    )
+    , (
+      void *message = CLOSURE_ARG_OF_(&tap->slot)->_2;
+      size_t size = tap->size;
+      if (size == 0) {
+        /* only a payload buffer knows its length, anything else is recorded empty */
+        assert(payload_is_buffer(message) && "the messages of a tap without size must be payload buffers");
+        if (payload_is_buffer(message)) size = payload_length(message);
+      }
+      journal_append(tap->journal, CLOSURE_ARG_OF_(&tap->slot)->_1, message, size);
+    )
+    , ()
+  );
+}
+
+void journal_tap_free(struct __JournalTap *tap)
+{
+  CLOSURE_FREE(&tap->slot);
+}
+
+static void journal_sleep_until(uint64_t deadline)
+{
+  uint64_t now = journal_now();
+  struct timespec ts;
+  if (now >= deadline) return;
+  ts.tv_sec = (time_t)((deadline - now) / 1000000000u);
+  ts.tv_nsec = (long)((deadline - now) % 1000000000u);
+  while (nanosleep(&ts, &ts) != 0 && errno == EINTR);
+}
+
+long journal_replay(const char *prefix, struct __TopicRegistry *registry, int realtime)
+{
+  uint64_t first_timestamp = 0, start = journal_now();
+  unsigned int index;
+  long count = 0;
+
+  for (index = 0; ; ++index) {
+    char *path = journal_segment_path(prefix, index), *memory;
+    struct stat st;
+    size_t offset;
+    int fd = path ? open(path, O_RDONLY) : -1;
+    free(path);
+    if (fd < 0) break;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < JOURNAL_HEADER_SIZE) {
+      close(fd);
+      break;
+    }
+    memory = (char *)mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (memory == (char *)MAP_FAILED) break;
+    if (memcmp(memory, JOURNAL_MAGIC, 8) != 0) {
+      munmap(memory, (size_t)st.st_size);
+      break;
+    }
+    for (offset = JOURNAL_HEADER_SIZE; offset + sizeof(struct __JournalRecord) <= (size_t)st.st_size; ) {
+      const struct __JournalRecord *record = (const struct __JournalRecord *)(memory + offset);
+      const char *name = (const char *)(record + 1);
+      if (record->length == 0 || offset + record->length > (size_t)st.st_size) break;
+      if (count == 0) first_timestamp = record->timestamp;
+      /* the concurrent emitters may commit the records slightly out of the order of time */
+      if (realtime && record->timestamp > first_timestamp) {
+        journal_sleep_until(start + (record->timestamp - first_timestamp));
+      }
+      topic_publish(registry, name, (void *)(name + record->name_size + 1));
+      ++count;
+      offset += record->length;
+    }
+    munmap(memory, (size_t)st.st_size);
+  }
+  return index == 0 ? -1 : count;
+}
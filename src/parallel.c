@@ -0,0 +1,123 @@
+/*
+ * Copyright 2013, Zhou Zhenghui <zhouzhenghui@gmail.com>
+ */
+
+#include "continuation/parallel.h"
+#include <sched.h>
+#include <string.h>
+
+/* pieces per worker when the grain is decided by the loop */
+#define ASYNC_FOR_PIECES_PER_WORKER 8
+
+static void async_for_chunk_run(struct __SchedulerTask *task);
+
+static struct __AsyncForChunk *async_for_chunk_new(struct __AsyncFor *async_for, long begin, long end)
+{
+  struct __AsyncForChunk *chunk = (struct __AsyncForChunk *)malloc(sizeof(struct __AsyncForChunk));
+  if (chunk == NULL) return NULL;
+  scheduler_task_init(&chunk->task, async_for_chunk_run);
+  chunk->owner = async_for;
+  chunk->begin = begin;
+  chunk->end = end;
+  return chunk;
+}
+
+static void async_for_chunk_invoke(struct __AsyncForChunk *chunk)
+{
+  struct __AsyncFor *async_for = chunk->owner;
+  int slot;
+  long count;
+  /* give the halves to the thieves, the worker keeps the first piece */
+  while (async_for->scheduler && chunk->end - chunk->begin > async_for->grain) {
+    long middle = chunk->begin + (chunk->end - chunk->begin) / 2;
+    struct __AsyncForChunk *half = async_for_chunk_new(async_for, middle, chunk->end);
+    /* keep the rest of the iterations if the piece can't be allocated */
+    if (half == NULL) break;
+    chunk->end = middle;
+    scheduler_submit(async_for->scheduler, &half->task);
+  }
+  slot = async_for->scheduler ? scheduler_current_worker(async_for->scheduler) : -1;
+  chunk->slot = slot < 0 ? async_for->naccumulators - 1 : slot;
+  chunk->restored = 0;
+  continuation_stub_init(&chunk->cont_stub, &async_for->cont);
+  continuation_stub_invoke(&chunk->cont_stub);
+  count = chunk->end - chunk->begin;
+  free(chunk);
+  pthread_mutex_lock(&async_for->mutex);
+  async_for->pending -= count;
+  if (async_for->pending == 0) pthread_cond_broadcast(&async_for->done);
+  pthread_mutex_unlock(&async_for->mutex);
+}
+
+static void async_for_chunk_run(struct __SchedulerTask *task)
+{
+  async_for_chunk_invoke((struct __AsyncForChunk *)((char *)task - offsetof(struct __AsyncForChunk, task)));
+}
+
+struct __AsyncForChunk *__async_for_init(struct __AsyncFor *async_for, struct __Scheduler *scheduler
+  , long begin, long end, long grain)
+{
+  async_for->scheduler = scheduler;
+  async_for->frame = NULL;
+  async_for->pending = end > begin ? end - begin : 0;
+  if (scheduler == NULL) {
+    /* the default scheduler failed to start, run the loop on the calling thread */
+    grain = async_for->pending;
+  } else if (grain <= 0) {
+    grain = async_for->pending / ((long)scheduler->nworkers * ASYNC_FOR_PIECES_PER_WORKER);
+    if (grain <= 0) grain = 1;
+  }
+  async_for->grain = grain;
+  async_for->accumulators = NULL;
+  async_for->stride = 0;
+  /* one for each worker and one for the other threads */
+  async_for->naccumulators = (scheduler ? scheduler->nworkers : 0) + 1;
+  pthread_mutex_init(&async_for->mutex, NULL);
+  pthread_cond_init(&async_for->done, NULL);
+  return async_for_chunk_new(async_for, begin, end > begin ? end : begin);
+}
+
+void __async_for_init_accumulators(struct __AsyncFor *async_for, const void *value, size_t size)
+{
+  int i;
+  /* keep the workers off the cache lines of each other */
+  async_for->stride = (size + CONTINUATION_CACHE_LINE_SIZE - 1) / CONTINUATION_CACHE_LINE_SIZE * CONTINUATION_CACHE_LINE_SIZE;
+  async_for->accumulators = (char *)malloc(async_for->stride * async_for->naccumulators);
+  for (i = 0; i < async_for->naccumulators; ++i) {
+    memcpy(async_for->accumulators + async_for->stride * i, value, size);
+  }
+}
+
+void __async_for_run(struct __AsyncFor *async_for, struct __AsyncForChunk *chunk)
+{
+  if (async_for->pending == 0) {
+    free(chunk);
+    return;
+  }
+  async_for_chunk_invoke(chunk);
+  if (async_for->scheduler && scheduler_current_worker(async_for->scheduler) >= 0) {
+    /* a worker waiting would hold up the pieces in its run queue */
+    for (;;) {
+      long pending;
+      pthread_mutex_lock(&async_for->mutex);
+      pending = async_for->pending;
+      pthread_mutex_unlock(&async_for->mutex);
+      if (pending == 0) break;
+      if (!scheduler_help(async_for->scheduler)) sched_yield();
+    }
+  } else {
+    pthread_mutex_lock(&async_for->mutex);
+    while (async_for->pending) {
+      pthread_cond_wait(&async_for->done, &async_for->mutex);
+    }
+    pthread_mutex_unlock(&async_for->mutex);
+  }
+}
+
+void __async_for_free(struct __AsyncFor *async_for)
+{
+  free(async_for->accumulators);
+  free(async_for->frame);
+  pthread_cond_destroy(&async_for->done);
+  pthread_mutex_destroy(&async_for->mutex);
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright 2013, Zhou Zhenghui <zhouzhenghui@gmail.com>
+ */
+
+#include "continuation/payload.h"
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
+
+/* number of size classes, the buffers larger than the last class are not cached */
+#define PAYLOAD_SIZE_CLASSES 8
+/* maximum number of buffers cached by each size class of a thread */
+#define PAYLOAD_CACHE_CAPACITY 64
+
+struct __PayloadCache {
+  struct __Payload *buffers[PAYLOAD_SIZE_CLASSES];
+  int count[PAYLOAD_SIZE_CLASSES];
+  int registered; /* the cache is flushed when the thread exits */
+};
+
+static CONTINUATION_THREAD_LOCAL struct __PayloadCache payload_cache;
+#ifdef HAVE_PTHREAD
+static pthread_key_t payload_cache_key;
+static pthread_once_t payload_cache_once = PTHREAD_ONCE_INIT;
+
+static void payload_cache_destroy(void *arg)
+{
+  (void)arg;
+  payload_cache.registered = 0;
+  payload_cache_flush();
+}
+
+static void make_key()
+{
+  pthread_key_create(&payload_cache_key, payload_cache_destroy);
+}
+#endif
+
+void *payload_alloc(size_t size)
+{
+  struct __Payload *payload;
+  size_t class_size = __PAYLOAD_MIN_SIZE;
+  int size_class = 0;
+
+  while (class_size < size && size_class < PAYLOAD_SIZE_CLASSES) {
+    class_size <<= 1;
+    ++size_class;
+  }
+  if (size_class < PAYLOAD_SIZE_CLASSES) {
+    payload = payload_cache.buffers[size_class];
+    if (payload) {
+      payload_cache.buffers[size_class] = payload->next;
+      --payload_cache.count[size_class];
+    } else {
+      payload = (struct __Payload *)malloc(__PAYLOAD_HEADER_SIZE + class_size);
+      if (payload == NULL) return NULL;
+      payload->size_class = size_class;
+    }
+  } else {
+    payload = (struct __Payload *)malloc(__PAYLOAD_HEADER_SIZE + size);
+    if (payload == NULL) return NULL;
+    payload->size_class = -1;
+  }
+  payload->next = NULL;
+  payload->length = size;
+  payload->refcount = 1;
+  payload->magic = __PAYLOAD_MAGIC;
+  return (char *)payload + __PAYLOAD_HEADER_SIZE;
+}
+
+void __payload_recycle(struct __Payload *payload)
+{
+  int size_class = payload->size_class;
+  if (size_class < 0 || payload_cache.count[size_class] >= PAYLOAD_CACHE_CAPACITY) {
+    payload->magic = 0;
+    free(payload);
+    return;
+  }
+  /* the buffer is cached by the thread dropping the last reference */
+#ifdef HAVE_PTHREAD
+  if (!payload_cache.registered) {
+    pthread_once(&payload_cache_once, make_key);
+    pthread_setspecific(payload_cache_key, &payload_cache);
+    payload_cache.registered = 1;
+  }
+#endif
+  payload->next = payload_cache.buffers[size_class];
+  payload_cache.buffers[size_class] = payload;
+  ++payload_cache.count[size_class];
+}
+
+void payload_cache_flush(void)
+{
+  int i;
+  for (i = 0; i < PAYLOAD_SIZE_CLASSES; ++i) {
+    struct __Payload *payload = payload_cache.buffers[i];
+    while (payload) {
+      struct __Payload *next = payload->next;
+      payload->magic = 0;
+      free(payload);
+      payload = next;
+    }
+    payload_cache.buffers[i] = NULL;
+    payload_cache.count[i] = 0;
+  }
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright 2013, Zhou Zhenghui <zhouzhenghui@gmail.com>
+ */
+
+#include "continuation/reclaimer.h"
+#include <errno.h>
+
+static void *reclaimer_run(void *arg)
+{
+  struct __Reclaimer *reclaimer = (struct __Reclaimer *)arg;
+  for (;;) {
+    struct __ReclaimerEntry *batch, *entry, *next;
+    size_t count = 0;
+    pthread_mutex_lock(&reclaimer->mutex);
+    while (ATOMIC_LOAD(&reclaimer->retired) == NULL && !reclaimer->stopping) {
+      pthread_cond_wait(&reclaimer->wakeup, &reclaimer->mutex);
+    }
+    pthread_mutex_unlock(&reclaimer->mutex);
+    batch = ATOMIC_EXCHANGE(&reclaimer->retired, NULL);
+    if (batch == NULL) break;
+    /* free in the order of retirement */
+    for (entry = NULL; batch; batch = next) {
+      next = batch->next;
+      batch->next = entry;
+      entry = batch;
+    }
+    for (; entry; entry = next) {
+      next = entry->next;
+      __closure_free(entry->closure);
+      if (entry->release) entry->release(entry->ptr);
+      free(entry);
+      ++count;
+    }
+    pthread_mutex_lock(&reclaimer->mutex);
+    reclaimer->reclaimed_count += count;
+    ++reclaimer->batch_count;
+    pthread_cond_broadcast(&reclaimer->reclaimed);
+    pthread_mutex_unlock(&reclaimer->mutex);
+  }
+  return NULL;
+}
+
+int reclaimer_init(struct __Reclaimer *reclaimer)
+{
+  int error;
+  reclaimer->retired = NULL;
+  reclaimer->retired_count = 0;
+  reclaimer->reclaimed_count = 0;
+  reclaimer->batch_count = 0;
+  reclaimer->stopping = 0;
+  reclaimer->error = 0;
+  pthread_mutex_init(&reclaimer->mutex, NULL);
+  pthread_cond_init(&reclaimer->wakeup, NULL);
+  pthread_cond_init(&reclaimer->reclaimed, NULL);
+  error = pthread_create(&reclaimer->thread, NULL, reclaimer_run, reclaimer);
+  if (error) {
+    reclaimer->error = error;
+    pthread_cond_destroy(&reclaimer->reclaimed);
+    pthread_cond_destroy(&reclaimer->wakeup);
+    pthread_mutex_destroy(&reclaimer->mutex);
+  }
+  return error;
+}
+
+void reclaimer_free(struct __Reclaimer *reclaimer)
+{
+  pthread_mutex_lock(&reclaimer->mutex);
+  reclaimer->stopping = 1;
+  pthread_cond_signal(&reclaimer->wakeup);
+  pthread_mutex_unlock(&reclaimer->mutex);
+  pthread_join(reclaimer->thread, NULL);
+  assert(reclaimer->retired == NULL);
+  pthread_cond_destroy(&reclaimer->reclaimed);
+  pthread_cond_destroy(&reclaimer->wakeup);
+  pthread_mutex_destroy(&reclaimer->mutex);
+}
+
+void reclaimer_flush(struct __Reclaimer *reclaimer)
+{
+  size_t retired_count = ATOMIC_LOAD(&reclaimer->retired_count);
+  /* nothing is retired without the thread */
+  if (reclaimer->error) return;
+  pthread_mutex_lock(&reclaimer->mutex);
+  while (reclaimer->reclaimed_count < retired_count) {
+    pthread_cond_wait(&reclaimer->reclaimed, &reclaimer->mutex);
+  }
+  pthread_mutex_unlock(&reclaimer->mutex);
+}
+
+static struct __Reclaimer reclaimer_default_instance;
+static pthread_once_t reclaimer_default_once = PTHREAD_ONCE_INIT;
+
+static void reclaimer_default_init()
+{
+  /* the error is recorded in the reclaimer, which frees the closures in place then */
+  reclaimer_init(&reclaimer_default_instance);
+}
+
+struct __Reclaimer *reclaimer_default(void)
+{
+  pthread_once(&reclaimer_default_once, reclaimer_default_init);
+  return &reclaimer_default_instance;
+}
+
+void __closure_free_async(struct __Reclaimer *reclaimer, struct __Closure *closure, void (*release)(void *), void *ptr)
+{
+  struct __ReclaimerEntry *entry, *head;
+  if (reclaimer->error || !closure->connected
+      || (entry = (struct __ReclaimerEntry *)malloc(sizeof(struct __ReclaimerEntry))) == NULL) {
+    /* no thread, nothing to finalize, or free in place rather than leak */
+    __closure_free(closure);
+    if (release) release(ptr);
+    return;
+  }
+  entry->closure = closure;
+  entry->release = release;
+  entry->ptr = ptr;
+  /* counted ahead of the push for reclaimer_flush() */
+  ATOMIC_FETCH_ADD(&reclaimer->retired_count, 1);
+  do {
+    head = ATOMIC_LOAD(&reclaimer->retired);
+    entry->next = head;
+  } while (!ATOMIC_CAS(&reclaimer->retired, head, entry));
+  /* only the first retirement of a batch wakes the thread up */
+  if (head == NULL) {
+    pthread_mutex_lock(&reclaimer->mutex);
+    pthread_cond_signal(&reclaimer->wakeup);
+    pthread_mutex_unlock(&reclaimer->mutex);
+  }
+}
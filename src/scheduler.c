@@ -0,0 +1,603 @@
+/*
+ * Copyright 2013, Zhou Zhenghui <zhouzhenghui@gmail.com>
+ */
+
+#include "continuation/scheduler.h"
+#include <errno.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+/* capacity of the run queue of a worker, overflowed tasks go to the injection list */
+#define SCHEDULER_DEQUE_SIZE 4096
+/* rounds of looking for work before a worker parks */
+#define SCHEDULER_SPIN_COUNT 64
+/* number of tasks a busy worker runs between checks of the timers */
+#define SCHEDULER_TIMER_INTERVAL 64
+/* fibers are not available on windows */
+#if defined(_WIN32)
+# define SCHEDULER_USE_FIBER 0
+#else
+# define SCHEDULER_USE_FIBER 1
+#endif
+
+static pthread_key_t scheduler_worker_key;
+static pthread_once_t scheduler_worker_once = PTHREAD_ONCE_INIT;
+
+static void make_key()
+{
+  pthread_key_create(&scheduler_worker_key, NULL);
+}
+
+/*
+ * Chase-Lev work-stealing deque,
+ * see "Correct and Efficient Work-Stealing for Weak Memory Models" by Le et al.
+ */
+static int deque_push(struct __SchedulerDeque *deque, struct __SchedulerTask *task)
+{
+  ptrdiff_t bottom = ATOMIC_LOAD_RELAXED(&deque->bottom);
+  ptrdiff_t top = ATOMIC_LOAD(&deque->top);
+  if ((size_t)(bottom - top) > deque->mask) {
+    return 0;
+  }
+  ATOMIC_STORE_RELAXED(&deque->tasks[bottom & deque->mask], task);
+  ATOMIC_STORE(&deque->bottom, bottom + 1);
+  return 1;
+}
+
+static struct __SchedulerTask *deque_pop(struct __SchedulerDeque *deque)
+{
+  ptrdiff_t bottom = ATOMIC_LOAD_RELAXED(&deque->bottom) - 1;
+  ptrdiff_t top;
+  struct __SchedulerTask *task = NULL;
+  ATOMIC_STORE_RELAXED(&deque->bottom, bottom);
+  ATOMIC_FENCE();
+  top = ATOMIC_LOAD_RELAXED(&deque->top);
+  if (top <= bottom) {
+    task = ATOMIC_LOAD_RELAXED(&deque->tasks[bottom & deque->mask]);
+    if (top == bottom) {
+      /* the last one, race against thieves */
+      if (!ATOMIC_CAS(&deque->top, top, top + 1)) {
+        task = NULL;
+      }
+      ATOMIC_STORE_RELAXED(&deque->bottom, bottom + 1);
+    }
+  } else {
+    ATOMIC_STORE_RELAXED(&deque->bottom, bottom + 1);
+  }
+  return task;
+}
+
+static struct __SchedulerTask *deque_steal(struct __SchedulerDeque *deque)
+{
+  ptrdiff_t top = ATOMIC_LOAD(&deque->top);
+  ptrdiff_t bottom;
+  ATOMIC_FENCE();
+  bottom = ATOMIC_LOAD(&deque->bottom);
+  if (top < bottom) {
+    struct __SchedulerTask *task = ATOMIC_LOAD_RELAXED(&deque->tasks[top & deque->mask]);
+    if (ATOMIC_CAS(&deque->top, top, top + 1)) {
+      return task;
+    }
+  }
+  return NULL;
+}
+
+static int deque_empty(struct __SchedulerDeque *deque)
+{
+  return ATOMIC_LOAD(&deque->bottom) <= ATOMIC_LOAD(&deque->top);
+}
+
+static void scheduler_inject(struct __Scheduler *scheduler, struct __SchedulerTask *first, struct __SchedulerTask *last)
+{
+  struct __SchedulerTask *head;
+  do {
+    head = ATOMIC_LOAD_RELAXED(&scheduler->injected);
+    last->next = head;
+  } while (!ATOMIC_CAS(&scheduler->injected, head, first));
+}
+
+static void scheduler_notify(struct __Scheduler *scheduler)
+{
+  /* pairs with the increment of sleepers in scheduler_park() */
+  ATOMIC_FENCE();
+  if (ATOMIC_LOAD(&scheduler->sleepers) > 0) {
+    pthread_mutex_lock(&scheduler->mutex);
+    pthread_cond_signal(&scheduler->wakeup);
+    pthread_mutex_unlock(&scheduler->mutex);
+  }
+}
+
+static int scheduler_has_work(struct __Scheduler *scheduler)
+{
+  int i;
+  if (ATOMIC_LOAD(&scheduler->injected) != NULL) return 1;
+  for (i = 0; i < scheduler->nworkers; ++i) {
+    if (!deque_empty(&scheduler->workers[i].deque)) return 1;
+  }
+  return 0;
+}
+
+/* take the whole injection list at once, so that there is no ABA problem */
+static struct __SchedulerTask *scheduler_grab_injected(struct __SchedulerWorker *worker)
+{
+  struct __Scheduler *scheduler = worker->scheduler;
+  struct __SchedulerTask *task, *next;
+  if (ATOMIC_LOAD_RELAXED(&scheduler->injected) == NULL) return NULL;
+  task = ATOMIC_EXCHANGE(&scheduler->injected, (struct __SchedulerTask *)NULL);
+  if (task == NULL) return NULL;
+  /*
+   * the list is in reverse order of submission, push the newer tasks first
+   * so that the owner pops them in the order of submission, and run the oldest.
+   */
+  for (next = task->next; next; next = task->next) {
+    if (!deque_push(&worker->deque, task)) {
+      struct __SchedulerTask *last = task;
+      while (last->next->next) last = last->next;
+      next = last->next;
+      last->next = NULL;
+      scheduler_inject(scheduler, task, last);
+      task = next;
+      break;
+    }
+    task = next;
+  }
+  if (!deque_empty(&worker->deque)) {
+    scheduler_notify(scheduler);
+  }
+  return task;
+}
+
+static struct __SchedulerTask *scheduler_steal(struct __SchedulerWorker *worker)
+{
+  struct __Scheduler *scheduler = worker->scheduler;
+  int i, victim;
+  if (scheduler->nworkers < 2) return NULL;
+  worker->seed = worker->seed * 1103515245 + 12345;
+  victim = (int)((worker->seed >> 16) % (unsigned int)scheduler->nworkers);
+  for (i = 0; i < scheduler->nworkers; ++i, victim = (victim + 1) % scheduler->nworkers) {
+    if (victim != worker->index) {
+      struct __SchedulerTask *task = deque_steal(&scheduler->workers[victim].deque);
+      if (task) return task;
+    }
+  }
+  return NULL;
+}
+
+static struct __SchedulerTask *scheduler_find_task(struct __SchedulerWorker *worker)
+{
+  struct __SchedulerTask *task = deque_pop(&worker->deque);
+  if (task == NULL) {
+    task = scheduler_grab_injected(worker);
+    if (task == NULL) {
+      task = scheduler_steal(worker);
+    }
+  }
+  return task;
+}
+
+static uint64_t scheduler_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/* the timer heap is guarded by the mutex of the scheduler */
+static void timer_heap_push(struct __Scheduler *scheduler, struct __SchedulerTimer timer)
+{
+  size_t i = VECTOR_SIZE(&scheduler->timers);
+  VECTOR_APPEND_ITEM(&scheduler->timers, timer);
+  while (i > 0 && VECTOR_ITEM(&scheduler->timers, (i - 1) / 2).deadline > timer.deadline) {
+    VECTOR_ITEM(&scheduler->timers, i) = VECTOR_ITEM(&scheduler->timers, (i - 1) / 2);
+    i = (i - 1) / 2;
+  }
+  VECTOR_ITEM(&scheduler->timers, i) = timer;
+  ATOMIC_STORE(&scheduler->next_deadline, VECTOR_ITEM(&scheduler->timers, 0).deadline);
+}
+
+static struct __SchedulerTask *timer_heap_remove(struct __Scheduler *scheduler, size_t i)
+{
+  struct __SchedulerTask *task = VECTOR_ITEM(&scheduler->timers, i).task;
+  size_t size = VECTOR_SIZE(&scheduler->timers) - 1;
+  struct __SchedulerTimer last = VECTOR_ITEM(&scheduler->timers, size);
+  /* the last one may be earlier than the parent of the hole */
+  while (i > 0 && i < size && VECTOR_ITEM(&scheduler->timers, (i - 1) / 2).deadline > last.deadline) {
+    VECTOR_ITEM(&scheduler->timers, i) = VECTOR_ITEM(&scheduler->timers, (i - 1) / 2);
+    i = (i - 1) / 2;
+  }
+  for (;;) {
+    size_t child = 2 * i + 1;
+    if (child >= size) break;
+    if (child + 1 < size && VECTOR_ITEM(&scheduler->timers, child + 1).deadline < VECTOR_ITEM(&scheduler->timers, child).deadline) {
+      ++child;
+    }
+    if (VECTOR_ITEM(&scheduler->timers, child).deadline >= last.deadline) break;
+    VECTOR_ITEM(&scheduler->timers, i) = VECTOR_ITEM(&scheduler->timers, child);
+    i = child;
+  }
+  if (i < size) VECTOR_ITEM(&scheduler->timers, i) = last;
+  VECTOR_RESIZE(&scheduler->timers, size);
+  ATOMIC_STORE(&scheduler->next_deadline, size ? VECTOR_ITEM(&scheduler->timers, 0).deadline : UINT64_MAX);
+  return task;
+}
+
+static struct __SchedulerTask *timer_heap_pop(struct __Scheduler *scheduler)
+{
+  return timer_heap_remove(scheduler, 0);
+}
+
+/* submit the expired timers, returns nonzero if any */
+static int scheduler_fire_timers(struct __Scheduler *scheduler)
+{
+  struct __SchedulerTask *expired = NULL;
+  uint64_t now;
+  /* the clock is not read unless there is a timer */
+  if (ATOMIC_LOAD_RELAXED(&scheduler->next_deadline) == UINT64_MAX) return 0;
+  now = scheduler_now();
+  if (now < ATOMIC_LOAD_RELAXED(&scheduler->next_deadline)) return 0;
+  pthread_mutex_lock(&scheduler->mutex);
+  while (VECTOR_SIZE(&scheduler->timers) > 0 && VECTOR_ITEM(&scheduler->timers, 0).deadline <= now) {
+    struct __SchedulerTask *task = timer_heap_pop(scheduler);
+    task->next = expired;
+    expired = task;
+  }
+  pthread_mutex_unlock(&scheduler->mutex);
+  if (expired == NULL) return 0;
+  while (expired) {
+    struct __SchedulerTask *next = expired->next;
+    scheduler_submit(scheduler, expired);
+    expired = next;
+  }
+  return 1;
+}
+
+static void scheduler_park(struct __Scheduler *scheduler)
+{
+  pthread_mutex_lock(&scheduler->mutex);
+  ATOMIC_FETCH_ADD(&scheduler->sleepers, 1);
+  if (!scheduler->stopping && !scheduler_has_work(scheduler)) {
+    uint64_t deadline = scheduler->next_deadline;
+    if (deadline == UINT64_MAX) {
+      pthread_cond_wait(&scheduler->wakeup, &scheduler->mutex);
+    } else {
+      uint64_t now = scheduler_now();
+      if (deadline > now) {
+        struct timespec ts;
+#ifdef HAVE_PTHREAD_CONDATTR_SETCLOCK
+        /* the condition variable waits by the monotonic clock as the deadline */
+        ts.tv_sec = (time_t)(deadline / 1000000000u);
+        ts.tv_nsec = (long)(deadline % 1000000000u);
+#else
+        /* the condition variable waits by the realtime clock */
+        uint64_t nsec;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        nsec = (uint64_t)ts.tv_nsec + (deadline - now);
+        ts.tv_sec += (time_t)(nsec / 1000000000u);
+        ts.tv_nsec = (long)(nsec % 1000000000u);
+#endif
+        pthread_cond_timedwait(&scheduler->wakeup, &scheduler->mutex, &ts);
+      }
+    }
+  }
+  ATOMIC_FETCH_SUB(&scheduler->sleepers, 1);
+  pthread_mutex_unlock(&scheduler->mutex);
+}
+
+static void *scheduler_worker_run(struct __SchedulerWorker *worker)
+{
+  struct __Scheduler *scheduler = worker->scheduler;
+  int spin = 0, ran = 0;
+  pthread_setspecific(scheduler_worker_key, worker);
+  for (;;) {
+    struct __SchedulerTask *task = scheduler_find_task(worker);
+    if (task) {
+      spin = 0;
+      task->run(task);
+      if (++ran == SCHEDULER_TIMER_INTERVAL) {
+        ran = 0;
+        scheduler_fire_timers(scheduler);
+      }
+    } else if (scheduler_fire_timers(scheduler)) {
+      spin = 0;
+    } else if (ATOMIC_LOAD(&scheduler->stopping)) {
+      break;
+    } else if (++spin < SCHEDULER_SPIN_COUNT) {
+      ATOMIC_CPU_RELAX();
+    } else {
+      spin = 0;
+      scheduler_park(scheduler);
+    }
+  }
+  continuation_invoke_stack_free();
+  return NULL;
+}
+
+/* free the deques and the pool of the workers */
+static void scheduler_release(struct __Scheduler *scheduler, int nworkers)
+{
+  int i;
+  for (i = 0; i < nworkers; ++i) {
+    free(scheduler->workers[i].deque.tasks);
+  }
+  free(scheduler->workers);
+  scheduler->workers = NULL;
+}
+
+/* stop and join the first nworkers workers */
+static void scheduler_stop(struct __Scheduler *scheduler, int nworkers)
+{
+  int i;
+  pthread_mutex_lock(&scheduler->mutex);
+  ATOMIC_STORE(&scheduler->stopping, 1);
+  pthread_cond_broadcast(&scheduler->wakeup);
+  pthread_mutex_unlock(&scheduler->mutex);
+  for (i = 0; i < nworkers; ++i) {
+    pthread_join(scheduler->workers[i].thread, NULL);
+  }
+}
+
+int scheduler_init(struct __Scheduler *scheduler, int nworkers)
+{
+  int i, error = 0;
+#ifdef HAVE_PTHREAD_CONDATTR_SETCLOCK
+  pthread_condattr_t condattr;
+#endif
+  pthread_once(&scheduler_worker_once, make_key);
+  if (nworkers <= 0) {
+#ifdef _SC_NPROCESSORS_ONLN
+    nworkers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (nworkers <= 0) nworkers = 1;
+  }
+  scheduler->workers = (struct __SchedulerWorker *)calloc(nworkers, sizeof(struct __SchedulerWorker));
+  if (scheduler->workers == NULL) return ENOMEM;
+  for (i = 0; i < nworkers; ++i) {
+    struct __SchedulerWorker *worker = &scheduler->workers[i];
+    worker->deque.mask = SCHEDULER_DEQUE_SIZE - 1;
+    worker->deque.tasks = (struct __SchedulerTask **)malloc(SCHEDULER_DEQUE_SIZE * sizeof(struct __SchedulerTask *));
+    if (worker->deque.tasks == NULL) {
+      /* the others are NULL by calloc() */
+      scheduler_release(scheduler, nworkers);
+      return ENOMEM;
+    }
+    worker->scheduler = scheduler;
+    worker->seed = (unsigned int)i * 2654435761u + 1;
+    worker->index = i;
+  }
+  scheduler->injected = NULL;
+  scheduler->nworkers = nworkers;
+  scheduler->stopping = 0;
+  scheduler->sleepers = 0;
+  pthread_mutex_init(&scheduler->mutex, NULL);
+#ifdef HAVE_PTHREAD_CONDATTR_SETCLOCK
+  pthread_condattr_init(&condattr);
+  pthread_condattr_setclock(&condattr, CLOCK_MONOTONIC);
+  pthread_cond_init(&scheduler->wakeup, &condattr);
+  pthread_condattr_destroy(&condattr);
+#else
+  pthread_cond_init(&scheduler->wakeup, NULL);
+#endif
+  VECTOR_INIT(&scheduler->timers);
+  scheduler->next_deadline = UINT64_MAX;
+  for (i = 0; i < nworkers; ++i) {
+    error = pthread_create(&scheduler->workers[i].thread, NULL, (void *(*)(void *))&scheduler_worker_run, &scheduler->workers[i]);
+    if (error) {
+      /* nothing is submitted yet, stop the workers started and release all of the deques */
+      scheduler_stop(scheduler, i);
+      pthread_cond_destroy(&scheduler->wakeup);
+      pthread_mutex_destroy(&scheduler->mutex);
+      scheduler_release(scheduler, nworkers);
+      break;
+    }
+  }
+  return error;
+}
+
+void scheduler_free(struct __Scheduler *scheduler)
+{
+  struct __SchedulerTask *task;
+  scheduler_stop(scheduler, scheduler->nworkers);
+  /* tasks submitted by the last running tasks, and the pending timers */
+  for (;;) {
+    task = ATOMIC_EXCHANGE(&scheduler->injected, (struct __SchedulerTask *)NULL);
+    if (task == NULL) {
+      if (VECTOR_SIZE(&scheduler->timers) == 0) break;
+      task = timer_heap_pop(scheduler);
+      task->next = NULL;
+    }
+    while (task) {
+      struct __SchedulerTask *next = task->next;
+      task->run(task);
+      task = next;
+    }
+  }
+  VECTOR_FREE(&scheduler->timers);
+  pthread_cond_destroy(&scheduler->wakeup);
+  pthread_mutex_destroy(&scheduler->mutex);
+  scheduler_release(scheduler, scheduler->nworkers);
+}
+
+void scheduler_submit(struct __Scheduler *scheduler, struct __SchedulerTask *task)
+{
+  struct __SchedulerWorker *worker;
+  pthread_once(&scheduler_worker_once, make_key);
+  worker = (struct __SchedulerWorker *)pthread_getspecific(scheduler_worker_key);
+  if (worker == NULL || worker->scheduler != scheduler || ATOMIC_LOAD(&scheduler->stopping)
+      || !deque_push(&worker->deque, task)) {
+    scheduler_inject(scheduler, task, task);
+  }
+  scheduler_notify(scheduler);
+}
+
+void scheduler_submit_after(struct __Scheduler *scheduler, struct __SchedulerTask *task, uint64_t delay)
+{
+  struct __SchedulerTimer timer;
+  timer.deadline = scheduler_now() + delay;
+  timer.task = task;
+  pthread_mutex_lock(&scheduler->mutex);
+  timer_heap_push(scheduler, timer);
+  if (VECTOR_ITEM(&scheduler->timers, 0).task == task) {
+    /* a parked worker waits for the new earliest deadline */
+    pthread_cond_signal(&scheduler->wakeup);
+  }
+  pthread_mutex_unlock(&scheduler->mutex);
+}
+
+int scheduler_cancel_timer(struct __Scheduler *scheduler, struct __SchedulerTask *task)
+{
+  size_t i;
+  int removed = 0;
+  pthread_mutex_lock(&scheduler->mutex);
+  for (i = 0; i < VECTOR_SIZE(&scheduler->timers); ++i) {
+    if (VECTOR_ITEM(&scheduler->timers, i).task == task) {
+      timer_heap_remove(scheduler, i);
+      removed = 1;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&scheduler->mutex);
+  return removed;
+}
+
+int scheduler_current_worker(const struct __Scheduler *scheduler)
+{
+  struct __SchedulerWorker *worker;
+  pthread_once(&scheduler_worker_once, make_key);
+  worker = (struct __SchedulerWorker *)pthread_getspecific(scheduler_worker_key);
+  return (worker && worker->scheduler == scheduler) ? worker->index : -1;
+}
+
+int scheduler_help(struct __Scheduler *scheduler)
+{
+  struct __SchedulerWorker *worker;
+  struct __SchedulerTask *task;
+  pthread_once(&scheduler_worker_once, make_key);
+  worker = (struct __SchedulerWorker *)pthread_getspecific(scheduler_worker_key);
+  if (worker == NULL || worker->scheduler != scheduler) return 0;
+  task = scheduler_find_task(worker);
+  if (task == NULL && scheduler_fire_timers(scheduler)) task = scheduler_find_task(worker);
+  if (task == NULL) return 0;
+  task->run(task);
+  return 1;
+}
+
+static struct __Scheduler scheduler_default_instance;
+static struct __Scheduler *scheduler_default_ptr = NULL;
+static pthread_once_t scheduler_default_once = PTHREAD_ONCE_INIT;
+
+static void scheduler_default_init()
+{
+  /* a single worker may still start when a worker per processor can't */
+  if (scheduler_init(&scheduler_default_instance, 0) == 0
+      || scheduler_init(&scheduler_default_instance, 1) == 0) {
+    scheduler_default_ptr = &scheduler_default_instance;
+  }
+}
+
+struct __Scheduler *scheduler_default(void)
+{
+  pthread_once(&scheduler_default_once, scheduler_default_init);
+  return scheduler_default_ptr;
+}
+
+static void async_spawn_free(struct __AsyncSpawn *async_spawn)
+{
+  free(async_spawn->frame);
+  free(async_spawn);
+}
+
+#if SCHEDULER_USE_FIBER
+static void async_spawn_fiber_run(void *arg)
+{
+  struct __AsyncSpawn *async_spawn = (struct __AsyncSpawn *)arg;
+  continuation_stub_invoke(&async_spawn->cont_stub);
+}
+#endif
+
+static void async_spawn_run(struct __SchedulerTask *task)
+{
+  struct __AsyncSpawn *async_spawn = (struct __AsyncSpawn *)((char *)task - offsetof(struct __AsyncSpawn, task));
+  assert(async_spawn->cont_stub.cont == &async_spawn->cont);
+#if SCHEDULER_USE_FIBER
+  if (async_spawn->use_fiber) {
+    if (async_spawn->fiber.stack != NULL
+        || fiber_init(&async_spawn->fiber, NULL, async_spawn_fiber_run, async_spawn) == 0) {
+      fiber_resume(&async_spawn->fiber);
+      if (!fiber_is_finished(&async_spawn->fiber)) {
+        /* yielded */
+        scheduler_submit(async_spawn->scheduler, task);
+        return;
+      }
+      fiber_free(&async_spawn->fiber);
+      async_spawn_free(async_spawn);
+      return;
+    }
+    /* run on the stack of worker if out of memory */
+    async_spawn->use_fiber = 0;
+  }
+#endif
+  continuation_stub_invoke(&async_spawn->cont_stub);
+  async_spawn_free(async_spawn);
+}
+
+/* the continuation allocated by __async_spawn_new() and not yet taken */
+static CONTINUATION_THREAD_LOCAL struct __AsyncSpawn *async_spawn_pending = NULL;
+
+int __async_spawn_new(struct __Scheduler *scheduler, int use_fiber)
+{
+  struct __AsyncSpawn *async_spawn;
+  async_spawn_pending = NULL;
+  if (scheduler == NULL) return EAGAIN;
+  async_spawn = (struct __AsyncSpawn *)malloc(sizeof(struct __AsyncSpawn));
+  if (async_spawn == NULL) return ENOMEM;
+  scheduler_task_init(&async_spawn->task, async_spawn_run);
+  async_spawn->scheduler = scheduler;
+  async_spawn->frame = NULL;
+  async_spawn->restored = 0;
+  async_spawn->use_fiber = use_fiber && SCHEDULER_USE_FIBER;
+  async_spawn->fiber.stack = NULL;
+  async_spawn_pending = async_spawn;
+  return 0;
+}
+
+struct __AsyncSpawn *__async_spawn_take(void)
+{
+  struct __AsyncSpawn *async_spawn = async_spawn_pending;
+  async_spawn_pending = NULL;
+  return async_spawn;
+}
+
+static struct __AsyncSpawn *async_spawn_copy_stack_frame(struct __AsyncSpawn *async_spawn)
+{
+  struct __ContinuationStub *cont_stub = &async_spawn->cont_stub;
+  struct __Continuation *cont = &async_spawn->cont;
+  continuation_copy_frame(cont, cont_stub->addr.stack_frame_tail, cont->stack_frame_tail);
+  return async_spawn;
+}
+
+/* the function pointer prevents link-time optimization */
+struct __AsyncSpawn *(*__async_spawn_copy_stack_frame)(struct __AsyncSpawn *) = &async_spawn_copy_stack_frame;
+
+void __async_spawn_submit(struct __AsyncSpawn *async_spawn)
+{
+  if (async_spawn->frame == NULL) {
+    /* no backup of the stack frame, run while the host frame is still live */
+    async_spawn->use_fiber = 0;
+    continuation_stub_invoke(&async_spawn->cont_stub);
+    async_spawn_free(async_spawn);
+    return;
+  }
+  scheduler_submit(async_spawn->scheduler, &async_spawn->task);
+}
+
+void __async_spawn_yield(struct __AsyncSpawn *async_spawn)
+{
+#if SCHEDULER_USE_FIBER
+  if (async_spawn->use_fiber) {
+    fiber_yield(&async_spawn->fiber);
+  }
+#else
+  (void)async_spawn;
+#endif
+}
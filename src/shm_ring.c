@@ -0,0 +1,258 @@
+/*
+ * Copyright 2013, Zhou Zhenghui <zhouzhenghui@gmail.com>
+ */
+
+#include "continuation/shm_ring.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+# define SHM_RING_USE_FUTEX 1
+# include <linux/futex.h>
+# include <sys/syscall.h>
+#else
+# define SHM_RING_USE_FUTEX 0
+#endif
+
+#define SHM_RING_MAGIC 0x53424d52494e4731ull
+#define SHM_RING_ALIGN(size) (((size) + 7) & ~(uint64_t)7)
+/* the channel number marking the padding to the end of the data area */
+#define SHM_RING_PADDING 0xffffffffu
+/* the interval in microseconds the consumer naps without futex */
+#define SHM_RING_NAP 50
+
+/*
+ * A record is committed by storing its length, which is cleared again by the consumer
+ * after dispatching, so that the zeroed area never looks like a committed record.
+ */
+struct __ShmRingRecord {
+  volatile uint32_t length;
+  uint32_t channel;
+  uint64_t size;
+};
+
+STATIC_ASSERT(sizeof(struct __ShmRingHeader) == 192, unexpected_size_of_struct_ShmRingHeader);
+
+static int shm_ring_map(struct __ShmRing *ring, int fd, size_t size)
+{
+  ring->header = (struct __ShmRingHeader *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (ring->header == (struct __ShmRingHeader *)MAP_FAILED) return errno;
+  ring->data = (char *)(ring->header + 1);
+  ring->size = size;
+  ring->fd = fd;
+  return 0;
+}
+
+static int shm_ring_open_anonymous(void)
+{
+#if defined(__linux__) && defined(SYS_memfd_create)
+  return (int)syscall(SYS_memfd_create, "signalbus", 1 /* MFD_CLOEXEC */);
+#else
+  char name[64];
+  int fd;
+  snprintf(name, sizeof(name), "/signalbus.%ld.%p", (long)getpid(), (void *)&name);
+  fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd >= 0) shm_unlink(name);
+  return fd;
+#endif
+}
+
+int shm_ring_create(struct __ShmRing *ring, const char *name, size_t capacity)
+{
+  uint64_t data_size = sizeof(struct __ShmRingRecord);
+  size_t size;
+  int fd, error;
+
+  while (data_size < capacity) data_size <<= 1;
+  size = sizeof(struct __ShmRingHeader) + (size_t)data_size;
+  fd = name ? shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0600) : shm_ring_open_anonymous();
+  if (fd < 0) return errno;
+  error = ftruncate(fd, (off_t)size) == 0 ? shm_ring_map(ring, fd, size) : errno;
+  if (error) {
+    close(fd);
+    return error;
+  }
+  ring->mask = data_size - 1;
+  ring->header->capacity = data_size;
+  ring->header->head = 0;
+  ring->header->tail = 0;
+  ring->header->wakeup = 0;
+  ring->header->sleeping = 0;
+  /* the attaching processes check the magic number last */
+  ATOMIC_STORE(&ring->header->magic, SHM_RING_MAGIC);
+  return 0;
+}
+
+int shm_ring_attach_fd(struct __ShmRing *ring, int fd)
+{
+  struct stat st;
+  int error;
+  if (fstat(fd, &st) != 0) return errno;
+  if ((size_t)st.st_size <= sizeof(struct __ShmRingHeader)) return EINVAL;
+  error = shm_ring_map(ring, fd, (size_t)st.st_size);
+  if (error) return error;
+  if (ATOMIC_LOAD(&ring->header->magic) != SHM_RING_MAGIC
+      || sizeof(struct __ShmRingHeader) + ring->header->capacity != ring->size) {
+    munmap(ring->header, ring->size);
+    return EINVAL;
+  }
+  ring->mask = ring->header->capacity - 1;
+  return 0;
+}
+
+int shm_ring_attach(struct __ShmRing *ring, const char *name)
+{
+  int error, fd = shm_open(name, O_RDWR, 0600);
+  if (fd < 0) return errno;
+  error = shm_ring_attach_fd(ring, fd);
+  if (error) close(fd);
+  return error;
+}
+
+void shm_ring_close(struct __ShmRing *ring)
+{
+  munmap(ring->header, ring->size);
+  close(ring->fd);
+  ring->header = NULL;
+  ring->data = NULL;
+  ring->fd = -1;
+}
+
+void *shm_ring_reserve(struct __ShmRing *ring, unsigned int channel, size_t size)
+{
+  struct __ShmRingHeader *header = ring->header;
+  struct __ShmRingRecord *record;
+  uint64_t length = SHM_RING_ALIGN(sizeof(struct __ShmRingRecord) + size);
+  uint64_t capacity = ring->mask + 1;
+  uint64_t head;
+
+  if (length > capacity || length > 0xffffffffu) return NULL;
+  for (;;) {
+    uint64_t offset, tail, pad;
+    head = ATOMIC_LOAD(&header->head);
+    tail = ATOMIC_LOAD(&header->tail);
+    offset = head & ring->mask;
+    if (offset + length > capacity) {
+      /*
+       * A record never wraps around, the rest of the data area is skipped.
+       * The padding is reserved on its own, since the space of the padding and
+       * a record longer than the offset is never free at once.
+       */
+      pad = capacity - offset;
+      if (head + pad - tail > capacity) return NULL;
+      if (ATOMIC_CAS(&header->head, head, head + pad)) {
+        record = (struct __ShmRingRecord *)(ring->data + offset);
+        record->channel = SHM_RING_PADDING;
+        ATOMIC_STORE(&record->length, (uint32_t)pad);
+      }
+      continue;
+    }
+    if (head + length - tail > capacity) return NULL;
+    if (ATOMIC_CAS(&header->head, head, head + length)) break;
+  }
+  record = (struct __ShmRingRecord *)(ring->data + (head & ring->mask));
+  record->channel = channel;
+  record->size = size;
+  return record + 1;
+}
+
+static void shm_ring_wake(struct __ShmRing *ring)
+{
+  struct __ShmRingHeader *header = ring->header;
+  /* against the consumer checking the ring after announcing to sleep */
+  ATOMIC_FENCE();
+  if (ATOMIC_LOAD_RELAXED(&header->sleeping)) {
+    ATOMIC_FETCH_ADD(&header->wakeup, 1);
+#if SHM_RING_USE_FUTEX
+    syscall(SYS_futex, &header->wakeup, FUTEX_WAKE, 1, NULL, NULL, 0);
+#endif
+  }
+}
+
+void shm_ring_commit(struct __ShmRing *ring, void *payload)
+{
+  struct __ShmRingRecord *record = (struct __ShmRingRecord *)payload - 1;
+  ATOMIC_STORE(&record->length, (uint32_t)SHM_RING_ALIGN(sizeof(struct __ShmRingRecord) + record->size));
+  shm_ring_wake(ring);
+}
+
+int shm_ring_send(struct __ShmRing *ring, unsigned int channel, const void *payload, size_t size)
+{
+  void *p = shm_ring_reserve(ring, channel, size);
+  if (p == NULL) return EAGAIN;
+  memcpy(p, payload, size);
+  shm_ring_commit(ring, p);
+  return 0;
+}
+
+static int shm_ring_is_ready(struct __ShmRing *ring)
+{
+  uint64_t tail = ATOMIC_LOAD_RELAXED(&ring->header->tail);
+  struct __ShmRingRecord *record = (struct __ShmRingRecord *)(ring->data + (tail & ring->mask));
+  return ATOMIC_LOAD(&record->length) != 0;
+}
+
+int shm_ring_dispatch(struct __ShmRing *ring, ShmRingSlot *dispatcher)
+{
+  struct __ShmRingHeader *header = ring->header;
+  uint64_t tail = ATOMIC_LOAD_RELAXED(&header->tail);
+  int count = 0;
+
+  for (;;) {
+    struct __ShmRingRecord *record = (struct __ShmRingRecord *)(ring->data + (tail & ring->mask));
+    uint32_t length = ATOMIC_LOAD(&record->length);
+    if (length == 0) break;
+    if (record->channel != SHM_RING_PADDING) {
+      unsigned int channel = record->channel;
+      const void *payload = record + 1;
+      size_t size = (size_t)record->size;
+      CLOSURE_RUN_N(3, dispatcher, (channel, payload, size));
+      ++count;
+    }
+    memset(record, 0, length);
+    tail += length;
+    /* release the cleared space to the producers */
+    ATOMIC_STORE(&header->tail, tail);
+  }
+  return count;
+}
+
+int shm_ring_wait(struct __ShmRing *ring, int timeout)
+{
+  struct __ShmRingHeader *header = ring->header;
+  uint32_t wakeup;
+  int ready;
+
+  if (shm_ring_is_ready(ring)) return 1;
+  wakeup = ATOMIC_LOAD(&header->wakeup);
+  ATOMIC_STORE(&header->sleeping, 1);
+  ATOMIC_FENCE();
+  ready = shm_ring_is_ready(ring);
+  if (!ready) {
+#if SHM_RING_USE_FUTEX
+    struct timespec ts;
+    ts.tv_sec = timeout / 1000;
+    ts.tv_nsec = (long)(timeout % 1000) * 1000000;
+    syscall(SYS_futex, &header->wakeup, FUTEX_WAIT, wakeup, timeout < 0 ? NULL : &ts, NULL, 0);
+#else
+    struct timespec ts;
+    long waited = 0;
+    (void)wakeup;
+    ts.tv_sec = 0;
+    ts.tv_nsec = SHM_RING_NAP * 1000;
+    while (!shm_ring_is_ready(ring) && (timeout < 0 || waited < (long)timeout * 1000)) {
+      nanosleep(&ts, NULL);
+      waited += SHM_RING_NAP;
+    }
+#endif
+    ready = shm_ring_is_ready(ring);
+  }
+  ATOMIC_STORE(&header->sleeping, 0);
+  return ready;
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright 2013, Zhou Zhenghui <zhouzhenghui@gmail.com>
+ */
+
+#include "continuation/signal_queue.h"
+#include <errno.h>
+#include <string.h>
+
+/* number of messages delivered by a run of the task before it yields the worker */
+#define SIGNAL_QUEUE_BATCH 64
+
+static void signal_queue_run(struct __SchedulerTask *task);
+
+int signal_queue_init(struct __SignalQueue *queue, struct __Scheduler *scheduler, SignalQueueSlot *slot
+  , size_t capacity, int policy, void (*discard)(void *))
+{
+  assert(capacity > 0);
+  assert(policy >= SIGNAL_QUEUE_BLOCK && policy <= SIGNAL_QUEUE_COALESCE);
+  queue->entries = (struct __SignalQueueEntry *)malloc(capacity * sizeof(struct __SignalQueueEntry));
+  if (queue->entries == NULL) return ENOMEM;
+  scheduler_task_init(&queue->task, signal_queue_run);
+  queue->scheduler = scheduler ? scheduler : scheduler_default();
+  queue->slot = slot;
+  queue->discard = discard;
+  queue->policy = policy;
+  queue->scheduled = 0;
+  queue->capacity = capacity;
+  queue->head = 0;
+  queue->count = 0;
+  memset(&queue->stats, 0, sizeof(queue->stats));
+  pthread_mutex_init(&queue->mutex, NULL);
+  pthread_cond_init(&queue->not_full, NULL);
+  pthread_cond_init(&queue->idle, NULL);
+  return 0;
+}
+
+void signal_queue_free(struct __SignalQueue *queue)
+{
+  pthread_mutex_lock(&queue->mutex);
+  while (queue->scheduled) {
+    pthread_cond_wait(&queue->idle, &queue->mutex);
+  }
+  pthread_mutex_unlock(&queue->mutex);
+  assert(queue->count == 0);
+  pthread_cond_destroy(&queue->idle);
+  pthread_cond_destroy(&queue->not_full);
+  pthread_mutex_destroy(&queue->mutex);
+  free(queue->entries);
+  queue->entries = NULL;
+}
+
+#define SIGNAL_QUEUE_ENTRY(queue, i) (&(queue)->entries[((queue)->head + (i)) % (queue)->capacity])
+
+/* wakes up the emitters to see the cancellation */
+static void signal_queue_wake(void *arg)
+{
+  struct __SignalQueue *queue = (struct __SignalQueue *)arg;
+  pthread_mutex_lock(&queue->mutex);
+  pthread_cond_broadcast(&queue->not_full);
+  pthread_mutex_unlock(&queue->mutex);
+}
+
+int signal_queue_emit(struct __SignalQueue *queue, long key, void *message)
+{
+  return signal_queue_emit_cancellable(queue, key, message, NULL);
+}
+
+int signal_queue_emit_cancellable(struct __SignalQueue *queue, long key, void *message, struct __CancelToken *token)
+{
+  struct __SignalQueueEntry *entry;
+  struct __CancelCallback *callback = NULL;
+  void *discarded = NULL;
+  int submit = 0, result = 0;
+  size_t i;
+
+  pthread_mutex_lock(&queue->mutex);
+  ++queue->stats.emitted;
+  if (queue->policy == SIGNAL_QUEUE_COALESCE) {
+    for (i = 0; i < queue->count; ++i) {
+      entry = SIGNAL_QUEUE_ENTRY(queue, i);
+      if (entry->key == key) {
+        discarded = entry->message;
+        entry->message = message;
+        ++queue->stats.coalesced;
+        pthread_mutex_unlock(&queue->mutex);
+        if (queue->discard) queue->discard(discarded);
+        return 0;
+      }
+    }
+  }
+  if (queue->count == queue->capacity) {
+    switch (queue->policy) {
+    case SIGNAL_QUEUE_BLOCK:
+      ++queue->stats.blocked;
+      if (token) callback = cancel_token_register(token, signal_queue_wake, queue);
+      while (queue->count == queue->capacity && !cancel_token_is_cancelled(token)) {
+        pthread_cond_wait(&queue->not_full, &queue->mutex);
+      }
+      if (queue->count == queue->capacity) {
+        ++queue->stats.cancelled;
+        discarded = message;
+        result = ECANCELED;
+      }
+      break;
+    case SIGNAL_QUEUE_DROP_NEWEST:
+      ++queue->stats.dropped;
+      discarded = message;
+      result = EAGAIN;
+      break;
+    default:
+      ++queue->stats.dropped;
+      discarded = queue->entries[queue->head].message;
+      queue->head = (queue->head + 1) % queue->capacity;
+      --queue->count;
+      break;
+    }
+  }
+  if (result == 0) {
+    entry = SIGNAL_QUEUE_ENTRY(queue, queue->count);
+    entry->key = key;
+    entry->message = message;
+    if (++queue->count > queue->stats.high_water) {
+      queue->stats.high_water = queue->count;
+    }
+    if (!queue->scheduled) {
+      queue->scheduled = 1;
+      submit = 1;
+    }
+  }
+  pthread_mutex_unlock(&queue->mutex);
+
+  /* the callback may be waiting for the lock */
+  cancel_token_unregister(callback);
+  if (discarded && queue->discard) queue->discard(discarded);
+  if (submit) scheduler_submit(queue->scheduler, &queue->task);
+  return result;
+}
+
+static void signal_queue_run(struct __SchedulerTask *task)
+{
+  struct __SignalQueue *queue = (struct __SignalQueue *)task;
+  SignalQueueSlot *slot = queue->slot;
+  int n;
+
+  for (n = 0; n < SIGNAL_QUEUE_BATCH; ++n) {
+    void *message;
+    pthread_mutex_lock(&queue->mutex);
+    if (queue->count == 0) {
+      queue->scheduled = 0;
+      pthread_cond_broadcast(&queue->idle);
+      pthread_mutex_unlock(&queue->mutex);
+      return;
+    }
+    message = queue->entries[queue->head].message;
+    queue->head = (queue->head + 1) % queue->capacity;
+    --queue->count;
+    ++queue->stats.delivered;
+    pthread_cond_signal(&queue->not_full);
+    pthread_mutex_unlock(&queue->mutex);
+
+    CLOSURE_RUN_N(1, slot, (message));
+  }
+  /* give the worker to others, the queue stays scheduled */
+  scheduler_submit(queue->scheduler, &queue->task);
+}
+
+void signal_queue_get_stats(struct __SignalQueue *queue, struct __SignalQueueStats *stats)
+{
+  pthread_mutex_lock(&queue->mutex);
+  *stats = queue->stats;
+  pthread_mutex_unlock(&queue->mutex);
+}
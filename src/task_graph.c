@@ -0,0 +1,142 @@
+/*
+ * Copyright 2013, Zhou Zhenghui <zhouzhenghui@gmail.com>
+ */
+
+#include "continuation/task_graph.h"
+#include <errno.h>
+#include <sched.h>
+
+static void task_graph_node_run(struct __SchedulerTask *task);
+
+void task_graph_init(struct __TaskGraph *graph, struct __Scheduler *scheduler)
+{
+  graph->scheduler = scheduler ? scheduler : scheduler_default();
+  graph->nodes = NULL;
+  graph->nnodes = 0;
+  graph->capacity = 0;
+  graph->arg = NULL;
+  graph->remaining = 0;
+  pthread_mutex_init(&graph->mutex, NULL);
+  pthread_cond_init(&graph->done, NULL);
+}
+
+void task_graph_free(struct __TaskGraph *graph)
+{
+  int i;
+  assert(graph->remaining == 0);
+  for (i = 0; i < graph->nnodes; ++i) {
+    free(graph->nodes[i]->successors);
+    free(graph->nodes[i]);
+  }
+  free(graph->nodes);
+  graph->nodes = NULL;
+  graph->nnodes = 0;
+  graph->capacity = 0;
+  pthread_cond_destroy(&graph->done);
+  pthread_mutex_destroy(&graph->mutex);
+}
+
+struct __TaskGraphNode *task_graph_add(struct __TaskGraph *graph, TaskGraphClosure *closure)
+{
+  struct __TaskGraphNode *node;
+  assert(graph->remaining == 0);
+  if (graph->nnodes == graph->capacity) {
+    int capacity = graph->capacity ? graph->capacity * 2 : 8;
+    struct __TaskGraphNode **nodes = (struct __TaskGraphNode **)realloc(graph->nodes, capacity * sizeof(struct __TaskGraphNode *));
+    if (nodes == NULL) return NULL;
+    graph->nodes = nodes;
+    graph->capacity = capacity;
+  }
+  node = (struct __TaskGraphNode *)malloc(sizeof(struct __TaskGraphNode));
+  if (node == NULL) return NULL;
+  scheduler_task_init(&node->task, task_graph_node_run);
+  node->graph = graph;
+  node->closure = closure;
+  node->successors = NULL;
+  node->nsuccessors = 0;
+  node->capacity = 0;
+  node->npredecessors = 0;
+  node->pending = 0;
+  graph->nodes[graph->nnodes++] = node;
+  return node;
+}
+
+int task_graph_depend(struct __TaskGraphNode *node, struct __TaskGraphNode *predecessor)
+{
+  assert(node->graph == predecessor->graph && node != predecessor);
+  assert(node->graph->remaining == 0);
+  if (predecessor->nsuccessors == predecessor->capacity) {
+    int capacity = predecessor->capacity ? predecessor->capacity * 2 : 4;
+    struct __TaskGraphNode **successors = (struct __TaskGraphNode **)realloc(predecessor->successors, capacity * sizeof(struct __TaskGraphNode *));
+    if (successors == NULL) return ENOMEM;
+    predecessor->successors = successors;
+    predecessor->capacity = capacity;
+  }
+  predecessor->successors[predecessor->nsuccessors++] = node;
+  ++node->npredecessors;
+  return 0;
+}
+
+static void task_graph_node_run(struct __SchedulerTask *task)
+{
+  struct __TaskGraphNode *node = (struct __TaskGraphNode *)task;
+  struct __TaskGraph *graph = node->graph;
+  void *arg = graph->arg;
+
+  do {
+    struct __TaskGraphNode *next = NULL;
+    int i;
+    CLOSURE_RUN_N(1, node->closure, (arg));
+    for (i = 0; i < node->nsuccessors; ++i) {
+      struct __TaskGraphNode *successor = node->successors[i];
+      if (ATOMIC_FETCH_SUB(&successor->pending, 1) == 1) {
+        /* run the first one ready on this worker, leave the others to the thieves */
+        if (next == NULL) {
+          next = successor;
+        } else {
+          scheduler_submit(graph->scheduler, &successor->task);
+        }
+      }
+    }
+    /* the graph may be gone after the last node, don't touch it afterward */
+    pthread_mutex_lock(&graph->mutex);
+    if (--graph->remaining == 0) pthread_cond_broadcast(&graph->done);
+    pthread_mutex_unlock(&graph->mutex);
+    node = next;
+  } while (node);
+}
+
+void task_graph_run(struct __TaskGraph *graph, void *arg)
+{
+  int i;
+  assert(graph->remaining == 0);
+  if (graph->nnodes == 0) return;
+  graph->arg = arg;
+  for (i = 0; i < graph->nnodes; ++i) {
+    graph->nodes[i]->pending = graph->nodes[i]->npredecessors;
+  }
+  graph->remaining = graph->nnodes;
+  /* the counters are published by the queue of the scheduler */
+  for (i = 0; i < graph->nnodes; ++i) {
+    if (graph->nodes[i]->npredecessors == 0) {
+      scheduler_submit(graph->scheduler, &graph->nodes[i]->task);
+    }
+  }
+  if (scheduler_current_worker(graph->scheduler) >= 0) {
+    /* a worker waiting would hold up the nodes in its run queue */
+    for (;;) {
+      int remaining;
+      pthread_mutex_lock(&graph->mutex);
+      remaining = graph->remaining;
+      pthread_mutex_unlock(&graph->mutex);
+      if (remaining == 0) break;
+      if (!scheduler_help(graph->scheduler)) sched_yield();
+    }
+  } else {
+    pthread_mutex_lock(&graph->mutex);
+    while (graph->remaining) {
+      pthread_cond_wait(&graph->done, &graph->mutex);
+    }
+    pthread_mutex_unlock(&graph->mutex);
+  }
+}
@@ -0,0 +1,326 @@
+/*
+ * Copyright 2013, Zhou Zhenghui <zhouzhenghui@gmail.com>
+ */
+
+#include "continuation/topic.h"
+#include <errno.h>
+#include <string.h>
+
+/* number of the matched nodes kept on the stack of a publisher */
+#define TOPIC_MATCH_INLINE 16
+
+/* the nodes matching a topic name, in the buffer of its own until it overflows */
+struct TopicMatch {
+  struct __TopicNode **nodes;
+  size_t size;
+  size_t capacity;
+  int error; /* ENOMEM if some of the nodes could not be kept */
+  struct __TopicNode *buffer[TOPIC_MATCH_INLINE];
+};
+
+static void topic_registry_lock(struct __TopicRegistry *registry)
+{
+  while (ATOMIC_EXCHANGE(&registry->lock, 1)) {
+    while (ATOMIC_LOAD_RELAXED(&registry->lock)) ATOMIC_CPU_RELAX();
+  }
+}
+
+static void topic_registry_unlock(struct __TopicRegistry *registry)
+{
+  ATOMIC_STORE(&registry->lock, 0);
+}
+
+static struct __TopicNode *topic_node_new(const char *segment, size_t length)
+{
+  struct __TopicNode *node = (struct __TopicNode *)malloc(sizeof(struct __TopicNode) + length);
+  if (node == NULL) return NULL;
+  node->next = NULL;
+  node->children = NULL;
+  node->subscriptions = NULL;
+  node->length = length;
+  memcpy(node->segment, segment, length);
+  node->segment[length] = '\0';
+  return node;
+}
+
+static void topic_node_free(struct __TopicNode *node)
+{
+  while (node) {
+    struct __TopicNode *next = node->next;
+    struct __TopicSubscription *subscription = node->subscriptions;
+    while (subscription) {
+      struct __TopicSubscription *next_subscription = subscription->next;
+      free(subscription);
+      subscription = next_subscription;
+    }
+    topic_node_free(node->children);
+    free(node);
+    node = next;
+  }
+}
+
+static int topic_node_is(const struct __TopicNode *node, const char *segment, size_t length)
+{
+  return node->length == length && memcmp(node->segment, segment, length) == 0;
+}
+
+/* end of the segment beginning at s */
+static const char *topic_segment_end(const char *s)
+{
+  while (*s != '\0' && *s != '.') ++s;
+  return s;
+}
+
+int topic_registry_init(struct __TopicRegistry *registry)
+{
+  registry->root = topic_node_new("", 0);
+  if (registry->root == NULL) return ENOMEM;
+  registry->retired = NULL;
+  registry->version = 0;
+  registry->lock = 0;
+  return 0;
+}
+
+void topic_registry_free(struct __TopicRegistry *registry)
+{
+  struct __TopicSubscription *subscription = registry->retired;
+  while (subscription) {
+    struct __TopicSubscription *next = subscription->retired_next;
+    free(subscription);
+    subscription = next;
+  }
+  registry->retired = NULL;
+  topic_node_free(registry->root);
+  registry->root = NULL;
+}
+
+struct __TopicSubscription *topic_subscribe(struct __TopicRegistry *registry, const char *pattern, TopicSlot *slot)
+{
+  struct __TopicSubscription *subscription, **tail;
+  struct __TopicNode *node;
+  int created = 0;
+
+  subscription = (struct __TopicSubscription *)malloc(sizeof(struct __TopicSubscription));
+  if (subscription == NULL) return NULL;
+  subscription->next = NULL;
+  subscription->retired_next = NULL;
+  subscription->slot = slot;
+  subscription->active = 1;
+
+  topic_registry_lock(registry);
+  node = registry->root;
+  for (;;) {
+    const char *end = topic_segment_end(pattern);
+    size_t length = (size_t)(end - pattern);
+    struct __TopicNode *child;
+    assert((length == 1 || (memchr(pattern, '*', length) == NULL && memchr(pattern, '#', length) == NULL))
+      && "wildcard in part of a segment");
+    for (child = node->children; child; child = child->next) {
+      if (topic_node_is(child, pattern, length)) break;
+    }
+    if (child == NULL) {
+      child = topic_node_new(pattern, length);
+      if (child == NULL) {
+        node = NULL;
+        break;
+      }
+      child->next = node->children;
+      /* publish the node after it is initialized */
+      ATOMIC_STORE(&node->children, child);
+      created = 1;
+    }
+    node = child;
+    if (*end == '\0') break;
+    pattern = end + 1;
+  }
+  if (node) {
+    subscription->node = node;
+    /* append to keep the slots invoked in the order of subscription */
+    for (tail = &node->subscriptions; *tail; tail = &(*tail)->next);
+    ATOMIC_STORE(tail, subscription);
+  }
+  if (created) {
+    /* invalidate the resolved handles */
+    ATOMIC_FETCH_ADD(&registry->version, 1);
+  }
+  topic_registry_unlock(registry);
+
+  if (node == NULL) {
+    free(subscription);
+    return NULL;
+  }
+  return subscription;
+}
+
+void topic_unsubscribe(struct __TopicRegistry *registry, struct __TopicSubscription *subscription)
+{
+  struct __TopicSubscription **prev;
+  topic_registry_lock(registry);
+  assert(subscription->active && "unsubscribe twice");
+  ATOMIC_STORE_RELAXED(&subscription->active, 0);
+  for (prev = &subscription->node->subscriptions; *prev != subscription; prev = &(*prev)->next) {
+    assert(*prev && "subscription not found");
+  }
+  /*
+   * A publisher may still be visiting the subscription, so its next link is kept intact
+   * and it is retired rather than freed.
+   */
+  ATOMIC_STORE(prev, subscription->next);
+  subscription->retired_next = registry->retired;
+  registry->retired = subscription;
+  topic_registry_unlock(registry);
+}
+
+static void topic_match_init(struct TopicMatch *match)
+{
+  match->nodes = match->buffer;
+  match->size = 0;
+  match->capacity = TOPIC_MATCH_INLINE;
+  match->error = 0;
+}
+
+static void topic_match_free(struct TopicMatch *match)
+{
+  if (match->nodes != match->buffer) free(match->nodes);
+}
+
+static void topic_match_add(struct TopicMatch *match, struct __TopicNode *node)
+{
+  size_t i;
+  /* a node may be reached by multiple paths through "#" */
+  for (i = 0; i < match->size; ++i) {
+    if (match->nodes[i] == node) return;
+  }
+  if (match->size == match->capacity) {
+    /* more matches than the buffer holds, move to the heap */
+    struct __TopicNode **nodes;
+    if (match->nodes == match->buffer) {
+      nodes = (struct __TopicNode **)malloc(2 * match->capacity * sizeof(struct __TopicNode *));
+      if (nodes) memcpy(nodes, match->buffer, sizeof(match->buffer));
+    } else {
+      nodes = (struct __TopicNode **)realloc(match->nodes, 2 * match->capacity * sizeof(struct __TopicNode *));
+    }
+    if (nodes == NULL) {
+      match->error = ENOMEM;
+      return;
+    }
+    match->nodes = nodes;
+    match->capacity *= 2;
+  }
+  match->nodes[match->size++] = node;
+}
+
+static void topic_match_node(struct TopicMatch *match, struct __TopicNode *node, const char *name);
+
+/* the node "#" consumes zero or more segments of the name */
+static void topic_match_any(struct TopicMatch *match, struct __TopicNode *node, const char *name)
+{
+  for (;;) {
+    const char *end;
+    topic_match_node(match, node, name);
+    if (name == NULL) break;
+    end = topic_segment_end(name);
+    name = *end == '\0' ? NULL : end + 1;
+  }
+}
+
+/* match the rest of the name, which is NULL if all of the segments are consumed */
+static void topic_match_node(struct TopicMatch *match, struct __TopicNode *node, const char *name)
+{
+  struct __TopicNode *child;
+  const char *end = NULL, *rest = NULL;
+  size_t length = 0;
+
+  if (name == NULL) {
+    topic_match_add(match, node);
+  } else {
+    end = topic_segment_end(name);
+    length = (size_t)(end - name);
+    rest = *end == '\0' ? NULL : end + 1;
+  }
+  for (child = ATOMIC_LOAD(&node->children); child; child = child->next) {
+    if (topic_node_is(child, "#", 1)) {
+      topic_match_any(match, child, name);
+    } else if (name != NULL && (topic_node_is(child, "*", 1) || topic_node_is(child, name, length))) {
+      topic_match_node(match, child, rest);
+    }
+  }
+}
+
+static int topic_publish_nodes(struct __TopicNode **nodes, size_t size, const char *name, void *message)
+{
+  size_t i;
+  int count = 0;
+  for (i = 0; i < size; ++i) {
+    struct __TopicSubscription *subscription;
+    for (subscription = ATOMIC_LOAD(&nodes[i]->subscriptions); subscription; subscription = ATOMIC_LOAD(&subscription->next)) {
+      TopicSlot *slot = subscription->slot;
+      if (!ATOMIC_LOAD_RELAXED(&subscription->active)) continue;
+      CLOSURE_RUN_N(2, slot, (name, message));
+      ++count;
+    }
+  }
+  return count;
+}
+
+int topic_publish(struct __TopicRegistry *registry, const char *name, void *message)
+{
+  struct TopicMatch match;
+  int count;
+  /* no allocation unless the name matches more patterns than the buffer holds */
+  topic_match_init(&match);
+  topic_match_node(&match, registry->root, name);
+  /* none of the slots is invoked rather than a part of them */
+  count = match.error ? -match.error : topic_publish_nodes(match.nodes, match.size, name, message);
+  topic_match_free(&match);
+  return count;
+}
+
+/* match the name of a handle into its nodes */
+static int topic_handle_match(struct __TopicHandle *handle)
+{
+  struct TopicMatch match;
+  int error;
+  topic_match_init(&match);
+  topic_match_node(&match, handle->registry->root, handle->name);
+  error = match.error;
+  if (error == 0) VECTOR_APPEND_ITEMS(&handle->nodes, match.size, match.nodes);
+  topic_match_free(&match);
+  return error;
+}
+
+int topic_resolve(struct __TopicRegistry *registry, const char *name, struct __TopicHandle *handle)
+{
+  size_t size = strlen(name) + 1;
+  handle->name = (char *)malloc(size);
+  if (handle->name == NULL) return ENOMEM;
+  memcpy(handle->name, name, size);
+  handle->registry = registry;
+  /* read the version before matching, so that a node added meanwhile causes a later resolution */
+  handle->version = ATOMIC_LOAD(&registry->version);
+  VECTOR_INIT(&handle->nodes);
+  if (topic_handle_match(handle) != 0) {
+    topic_handle_free(handle);
+    return ENOMEM;
+  }
+  return 0;
+}
+
+void topic_handle_free(struct __TopicHandle *handle)
+{
+  VECTOR_FREE(&handle->nodes);
+  free(handle->name);
+  handle->name = NULL;
+}
+
+int topic_publish_handle(struct __TopicHandle *handle, void *message)
+{
+  unsigned int version = ATOMIC_LOAD(&handle->registry->version);
+  if (version != handle->version) {
+    VECTOR_CLEAR(&handle->nodes);
+    /* matched again by the next publication */
+    if (topic_handle_match(handle) != 0) return -ENOMEM;
+    handle->version = version;
+  }
+  return topic_publish_nodes(VECTOR_ADDR(&handle->nodes), VECTOR_SIZE(&handle->nodes), handle->name, message);
+}
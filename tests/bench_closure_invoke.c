@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef __linux__
+# include <linux/perf_event.h>
+# include <sys/ioctl.h>
+# include <sys/syscall.h>
+# include <unistd.h>
+#endif
+
+#include <continuation/closure.h>
+
+#define CLOSURE_COUNT 65536
+#define ROUND_COUNT 10
+
+typedef CLOSURE1(long) Counter;
+
+static long total = 0;
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* count the cache misses of the calling thread, or return -1 if not permitted */
+static int cache_misses_open()
+{
+#ifdef __linux__
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = PERF_COUNT_HW_CACHE_MISSES;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+  return -1;
+#endif
+}
+
+static void cache_misses_enable(int fd)
+{
+#ifdef __linux__
+  if (fd >= 0) {
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+#else
+  (void)fd;
+#endif
+}
+
+static long long cache_misses_read(int fd)
+{
+  long long count = -1;
+#ifdef __linux__
+  if (fd >= 0) {
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(fd, &count, sizeof(count)) != sizeof(count)) count = -1;
+    close(fd);
+  }
+#else
+  (void)fd;
+#endif
+  return count;
+}
+
+static void connect_counter(Counter *counter)
+{
+  CLOSURE_INIT(counter);
+  CLOSURE_CONNECT(counter
+    , (
+      CLOSURE_RETAIN_VAR(counter);
+    )
+    , (
+      total += CLOSURE_ARG_OF_(counter)->_1;
+    )
+    , ()
+  );
+}
+
+int main()
+{
+  Counter *counters = (Counter *)malloc(CLOSURE_COUNT * sizeof(Counter));
+  double start, elapsed;
+  long long misses;
+  int i, round, fd;
+
+  setbuf(stdout,NULL);
+  printf("Invoke %d closures of %lu bytes round-robin.\n", CLOSURE_COUNT, (unsigned long)sizeof(Counter));
+  for (i = 0; i < CLOSURE_COUNT; ++i) {
+    connect_counter(&counters[i]);
+  }
+
+  fd = cache_misses_open();
+  cache_misses_enable(fd);
+  start = now();
+  for (round = 0; round < ROUND_COUNT; ++round) {
+    for (i = 0; i < CLOSURE_COUNT; ++i) {
+      CLOSURE1_RUN(&counters[i], 1);
+    }
+  }
+  elapsed = now() - start;
+  misses = cache_misses_read(fd);
+
+  for (i = 0; i < CLOSURE_COUNT; ++i) {
+    CLOSURE_FREE(&counters[i]);
+  }
+  free(counters);
+
+  assert(total == (long)CLOSURE_COUNT * ROUND_COUNT);
+  printf("%d invocations: %.1f ns per invocation.\n", CLOSURE_COUNT * ROUND_COUNT, elapsed * 1e9 / ((double)CLOSURE_COUNT * ROUND_COUNT));
+  if (misses >= 0) {
+    printf("%.2f cache misses per invocation.\n", (double)misses / ((double)CLOSURE_COUNT * ROUND_COUNT));
+  } else {
+    printf("Cache misses are not counted, the hardware counters are not available.\n");
+  }
+  return 0;
+}
@@ -0,0 +1,50 @@
+#include <stdio.h>
+#include <time.h>
+
+#include <continuation/closure.h>
+
+#define INVOKE_COUNT 200000
+
+static long handled = 0;
+static long returned = 0;
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main()
+{
+  CLOSURE1(int) handler;
+  double start, elapsed;
+  int i;
+
+  setbuf(stdout,NULL);
+  printf("Early return from C++ closures by %s.\n", CONTINUATION_USE_EXCEPTION_RETURN ? "exception" : "longjmp");
+  CLOSURE_INIT(&handler);
+  CLOSURE_CONNECT(&handler
+    , ()
+    , (
+      /* filter out most of the signals as a typical handler */
+      if (CLOSURE_ARG_OF_(&handler)->_1 % 8 != 0) {
+        ++returned;
+        CLOSURE_RETURN();
+      }
+      ++handled;
+    )
+    , ()
+  );
+
+  start = now();
+  for (i = 0; i < INVOKE_COUNT; ++i) {
+    CLOSURE1_RUN(&handler, i);
+  }
+  elapsed = now() - start;
+  CLOSURE_FREE(&handler);
+
+  assert(handled == INVOKE_COUNT / 8 && returned == INVOKE_COUNT - INVOKE_COUNT / 8);
+  printf("%d invocations, %ld early returns: %.1f ns per invocation.\n", INVOKE_COUNT, returned, elapsed * 1e9 / INVOKE_COUNT);
+  return 0;
+}
@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define BOOST_PP_VARIADICS 1
+
+#include <continuation/actor.h>
+
+#define ACTOR_COUNT 1000
+#define PRODUCER_COUNT 2
+#define MESSAGE_COUNT 100
+
+struct Counter {
+  long last[PRODUCER_COUNT];
+  long count;
+  volatile int running;
+  int overlapped;
+};
+
+struct Message {
+  struct __ActorMessage item;
+  int producer;
+  long sequence;
+};
+
+static ActorBehavior behaviors[ACTOR_COUNT];
+static struct __Actor actors[ACTOR_COUNT];
+static struct Counter counters[ACTOR_COUNT];
+static struct Message messages[PRODUCER_COUNT][ACTOR_COUNT][MESSAGE_COUNT];
+
+/* the counter is private to the actor, no lock is taken */
+static void connect_counter(ActorBehavior *behavior, struct Counter *counter)
+{
+  CLOSURE_INIT(behavior);
+  CLOSURE_CONNECT(behavior
+    , ()
+    , (
+      struct Message *message = (struct Message *)CLOSURE_ARG_OF_(behavior)->_1;
+      if (ATOMIC_EXCHANGE(&counter->running, 1)) counter->overlapped = 1;
+      assert(message->sequence == counter->last[message->producer] + 1);
+      counter->last[message->producer] = message->sequence;
+      ++counter->count;
+      ATOMIC_STORE(&counter->running, 0);
+    )
+    , ()
+  );
+}
+
+static void *produce(void *arg)
+{
+  int producer = (int)(size_t)arg;
+  long sequence;
+  int i, error;
+  for (sequence = 0; sequence < MESSAGE_COUNT; ++sequence) {
+    for (i = 0; i < ACTOR_COUNT; ++i) {
+      struct Message *message = &messages[producer][i][sequence];
+      message->producer = producer;
+      message->sequence = sequence;
+      /* both the intrusive and the allocated posts */
+      if (producer == 0) {
+        message->item.message = message;
+        actor_post(&actors[i], &message->item);
+      } else {
+        error = actor_send(&actors[i], message);
+        assert(error == 0);
+      }
+    }
+  }
+  return NULL;
+}
+
+int main()
+{
+  struct __Scheduler scheduler;
+  pthread_t producers[PRODUCER_COUNT];
+  int i, j, error;
+
+  setbuf(stdout,NULL);
+  error = scheduler_init(&scheduler, 4);
+  assert(error == 0);
+  for (i = 0; i < ACTOR_COUNT; ++i) {
+    for (j = 0; j < PRODUCER_COUNT; ++j) counters[i].last[j] = -1;
+    connect_counter(&behaviors[i], &counters[i]);
+    /* the batches of some actors are as small as possible */
+    actor_init(&actors[i], &scheduler, &behaviors[i], i % 2 ? 1 : 0);
+    assert(!actor_is_scheduled(&actors[i]));
+  }
+
+  printf("Send %d messages to each of %d actors from %d threads.\n", PRODUCER_COUNT * MESSAGE_COUNT, ACTOR_COUNT, PRODUCER_COUNT);
+  for (j = 0; j < PRODUCER_COUNT; ++j) {
+    error = pthread_create(&producers[j], NULL, produce, (void *)(size_t)j);
+    assert(error == 0);
+  }
+  for (j = 0; j < PRODUCER_COUNT; ++j) {
+    pthread_join(producers[j], NULL);
+  }
+  for (i = 0; i < ACTOR_COUNT; ++i) {
+    actor_free(&actors[i]);
+    assert(!actor_is_scheduled(&actors[i]));
+    assert(counters[i].count == PRODUCER_COUNT * MESSAGE_COUNT);
+    assert(!counters[i].overlapped);
+    for (j = 0; j < PRODUCER_COUNT; ++j) assert(counters[i].last[j] == MESSAGE_COUNT - 1);
+  }
+
+  printf("Free actors right after a burst of messages.\n");
+  for (i = 0; i < ACTOR_COUNT; ++i) {
+    struct __Actor *actor = (struct __Actor *)malloc(sizeof(struct __Actor));
+    counters[i].count = 0;
+    counters[i].last[0] = -1;
+    actor_init(actor, &scheduler, &behaviors[i], 1 + i % 4);
+    for (j = 0; j < MESSAGE_COUNT; ++j) {
+      error = actor_send(actor, &messages[0][i][j]);
+      assert(error == 0);
+    }
+    actor_free(actor);
+    /* scribble over the actor to catch a late access of the activation */
+    memset(actor, 0xff, sizeof(struct __Actor));
+    free(actor);
+    assert(counters[i].count == MESSAGE_COUNT);
+  }
+
+  scheduler_free(&scheduler);
+  for (i = 0; i < ACTOR_COUNT; ++i) {
+    CLOSURE_FREE(&behaviors[i]);
+  }
+  return 0;
+}
@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <time.h>
+
+#define BOOST_PP_VARIADICS 1
+
+#include <continuation/continuation_pthread.h>
+
+#define TASK_COUNT 200
+#define SUBTASK_COUNT 4
+#define TABLE_SIZE 64
+
+static volatile long finished = 0;
+static volatile long subtasks_finished = 0;
+static long results[TASK_COUNT];
+static volatile int cancelled_seen = 0;
+
+static void nap(long ns)
+{
+  struct timespec ts;
+  ts.tv_sec = 0;
+  ts.tv_nsec = ns;
+  nanosleep(&ts, NULL);
+}
+
+static void fork_join()
+{
+  int i;
+  ASYNC_SCOPE(
+    for (i = 0; i < TASK_COUNT; ++i) {
+      ASYNC_RUN(
+        nap(1000000);
+        results[i] = (long)i * i;
+        ATOMIC_FETCH_ADD(&finished, 1);
+      );
+    }
+    /* the threads created by the tasks are waited as well */
+    ASYNC_RUN(
+      int j;
+      for (j = 0; j < SUBTASK_COUNT; ++j) {
+        ASYNC_RUN(
+          nap(2000000);
+          ATOMIC_FETCH_ADD(&subtasks_finished, 1);
+        );
+      }
+    );
+  );
+}
+
+static void run_each()
+{
+  long i;
+  long table[TABLE_SIZE];
+  int error;
+  for (i = 0; i < TABLE_SIZE; ++i) table[i] = i;
+  ASYNC_SCOPE(
+    /* all of the threads read the same snapshot of the table */
+    error = ASYNC_RUN_EACH(i, TASK_COUNT,
+      results[i] = table[i % TABLE_SIZE] + i;
+      ATOMIC_FETCH_ADD(&finished, 1);
+    );
+    assert(error == 0);
+    /* the snapshot is taken, the threads don't see the change */
+    table[0] = -1;
+  );
+}
+
+static void cancel()
+{
+  ASYNC_SCOPE(
+    assert(!ASYNC_SCOPE_IS_CANCELLED());
+    ASYNC_RUN(
+      ASYNC_SCOPE_CANCEL();
+    );
+    ASYNC_SCOPE(
+      /* the cancellation of the enclosing scope is seen by the nested one */
+      ASYNC_RUN(
+        while (!ASYNC_SCOPE_IS_CANCELLED()) nap(100000);
+        ATOMIC_FETCH_ADD(&cancelled_seen, 1);
+      );
+    );
+    assert(ASYNC_SCOPE_IS_CANCELLED());
+  );
+  assert(!ASYNC_SCOPE_IS_CANCELLED());
+}
+
+int main()
+{
+  int i;
+
+  setbuf(stdout,NULL);
+  printf("Wait for %d threads by a scope.\n", TASK_COUNT + 1 + SUBTASK_COUNT);
+  fork_join();
+  assert(finished == TASK_COUNT);
+  assert(subtasks_finished == SUBTASK_COUNT);
+  for (i = 0; i < TASK_COUNT; ++i) {
+    assert(results[i] == (long)i * i);
+  }
+
+  printf("Run %d threads sharing a snapshot of the stack frame.\n", TASK_COUNT);
+  finished = 0;
+  run_each();
+  assert(finished == TASK_COUNT);
+  for (i = 0; i < TASK_COUNT; ++i) {
+    assert(results[i] == i % TABLE_SIZE + i);
+  }
+
+  cancel();
+  assert(cancelled_seen == 1);
+  return 0;
+}
@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <sched.h>
+#include <time.h>
+
+#include <continuation/scheduler.h>
+#include <continuation/cancel_token.h>
+
+#define CALLBACK_COUNT 4
+#define TIMER_DELAY 10000000000ull /* 10s */
+
+static int order[CALLBACK_COUNT];
+static int called = 0;
+
+static void record(void *arg)
+{
+  order[called++] = (int)(size_t)arg;
+}
+
+struct TimerTask {
+  struct __SchedulerTask task;
+  struct __Scheduler *scheduler;
+  volatile int ran;
+};
+
+static void timer_task_run(struct __SchedulerTask *task)
+{
+  ATOMIC_STORE(&((struct TimerTask *)task)->ran, 1);
+}
+
+/* take the timer out and run the task at once */
+static void cancel_timer(void *arg)
+{
+  struct TimerTask *timer_task = (struct TimerTask *)arg;
+  if (scheduler_cancel_timer(timer_task->scheduler, &timer_task->task)) {
+    scheduler_submit(timer_task->scheduler, &timer_task->task);
+  }
+}
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main()
+{
+  struct __CancelToken token;
+  struct __CancelCallback *callbacks[CALLBACK_COUNT], *callback;
+  struct __Scheduler scheduler;
+  struct TimerTask timer_tasks[3];
+  double start;
+  int i, j, result;
+
+  setbuf(stdout,NULL);
+  printf("Reuse the registrations released by unregistration.\n");
+  cancel_token_init(&token);
+  for (i = 0; i < 1000000; ++i) {
+    for (j = 0; j < CALLBACK_COUNT; ++j) {
+      callbacks[j] = cancel_token_register(&token, record, NULL);
+      assert(callbacks[j] != NULL);
+    }
+    /* from the middle, the head and the tail of the list */
+    result = cancel_token_unregister(callbacks[1]);
+    assert(result == 1);
+    result = cancel_token_unregister(callbacks[CALLBACK_COUNT - 1]);
+    assert(result == 1);
+    result = cancel_token_unregister(callbacks[0]);
+    assert(result == 1);
+    for (j = 2; j < CALLBACK_COUNT - 1; ++j) {
+      result = cancel_token_unregister(callbacks[j]);
+      assert(result == 1);
+    }
+  }
+  /* the released registrations are reused */
+  for (j = 0, callback = token.callbacks; callback; callback = callback->next) ++j;
+  assert(j == CALLBACK_COUNT);
+  assert(called == 0);
+  cancel_token_free(&token);
+
+  printf("Run the callbacks of a cancelled token.\n");
+  cancel_token_init(&token);
+  assert(!cancel_token_is_cancelled(&token));
+  for (i = 0; i < CALLBACK_COUNT; ++i) {
+    callbacks[i] = cancel_token_register(&token, record, (void *)(size_t)i);
+    assert(callbacks[i] != NULL);
+  }
+  result = cancel_token_unregister(callbacks[1]);
+  assert(result == 1);
+  result = cancel_token_cancel(&token);
+  assert(result == 1);
+  assert(cancel_token_is_cancelled(&token));
+  /* in the order of registration without the unregistered one */
+  assert(called == CALLBACK_COUNT - 1 && order[0] == 0 && order[1] == 2 && order[2] == 3);
+  result = cancel_token_unregister(callbacks[0]);
+  assert(result == 0);
+  callbacks[0] = cancel_token_register(&token, record, NULL);
+  assert(callbacks[0] == NULL);
+  result = cancel_token_cancel(&token);
+  assert(result == 0);
+  assert(called == CALLBACK_COUNT - 1);
+  cancel_token_free(&token);
+
+  printf("Take the timers out of the scheduler on cancellation.\n");
+  result = scheduler_init(&scheduler, 1);
+  assert(result == 0);
+  cancel_token_init(&token);
+  start = now();
+  for (i = 0; i < 3; ++i) {
+    scheduler_task_init(&timer_tasks[i].task, timer_task_run);
+    timer_tasks[i].scheduler = &scheduler;
+    timer_tasks[i].ran = 0;
+    scheduler_submit_after(&scheduler, &timer_tasks[i].task, TIMER_DELAY + i);
+  }
+  /* the one in the middle of the heap is unlinked */
+  cancel_token_register(&token, cancel_timer, &timer_tasks[1]);
+  cancel_token_cancel(&token);
+  while (!ATOMIC_LOAD(&timer_tasks[1].ran)) sched_yield();
+  assert(now() - start < 1);
+  assert(!timer_tasks[0].ran && !timer_tasks[2].ran);
+  result = scheduler_cancel_timer(&scheduler, &timer_tasks[1].task);
+  assert(result == 0);
+  result = scheduler_cancel_timer(&scheduler, &timer_tasks[2].task);
+  assert(result == 1);
+  result = scheduler_cancel_timer(&scheduler, &timer_tasks[0].task);
+  assert(result == 1);
+  scheduler_free(&scheduler);
+  assert(!timer_tasks[0].ran && !timer_tasks[2].ran);
+  cancel_token_free(&token);
+  return 0;
+}
@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <time.h>
+
+#include <continuation/closure.h>
+
+#define CLONE_COUNT 1000
+
+typedef CLOSURE1(long) Handler;
+
+static Handler handlers[CLONE_COUNT + 1];
+static long sum = 0;
+static int finalized = 0;
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void connect_handler(Handler *handler)
+{
+  long calls = 0;
+  CLOSURE_INIT(handler);
+  CLOSURE_CONNECT(handler
+    , (
+      CLOSURE_RETAIN_VAR(handler);
+      CLOSURE_RETAIN_VAR(calls);
+    )
+    , (
+      ++calls;
+      sum += CLOSURE_ARG_OF_(handler)->_1 * calls;
+    )
+    , (
+      ++finalized;
+    )
+  );
+}
+
+int main()
+{
+  double start, connect_time, clone_time;
+  long expected;
+  int i, error;
+
+  setbuf(stdout,NULL);
+  printf("Clone %d closures from a connected one.\n", CLONE_COUNT);
+  start = now();
+  for (i = 0; i <= CLONE_COUNT; ++i) {
+    connect_handler(&handlers[i]);
+  }
+  connect_time = now() - start;
+  for (i = 1; i <= CLONE_COUNT; ++i) {
+    CLOSURE_FREE(&handlers[i]);
+  }
+  assert(finalized == CLONE_COUNT);
+  finalized = 0;
+
+  /* the clones start with the retained variables of the template at the moment */
+  CLOSURE1_RUN(&handlers[0], 1);
+  assert(sum == 1);
+  start = now();
+  for (i = 1; i <= CLONE_COUNT; ++i) {
+    CLOSURE_INIT(&handlers[i]);
+    error = CLOSURE_CLONE(&handlers[i], &handlers[0]);
+    assert(error == 0);
+  }
+  clone_time = now() - start;
+
+  for (i = 1; i <= CLONE_COUNT; ++i) {
+    assert(CLOSURE_IS_CONNECTED(&handlers[i]));
+    CLOSURE1_RUN(&handlers[i], i);
+    CLOSURE1_RUN(&handlers[i], i);
+  }
+  /* the template keeps its own retained variables */
+  CLOSURE1_RUN(&handlers[0], 1);
+  expected = 1 + 2;
+  for (i = 1; i <= CLONE_COUNT; ++i) expected += i * 2 + i * 3;
+  assert(sum == expected);
+
+  for (i = 0; i <= CLONE_COUNT; ++i) {
+    CLOSURE_FREE(&handlers[i]);
+  }
+  assert(finalized == CLONE_COUNT + 1);
+  printf("%.0f ns per connection, %.0f ns per clone.\n", connect_time * 1e9 / (CLONE_COUNT + 1), clone_time * 1e9 / CLONE_COUNT);
+  return 0;
+}
@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <memory>
+#include <string>
+
+#include <continuation/closure.hpp>
+
+static std::string text;
+static std::unique_ptr<int> taken;
+static int empty_count = 0;
+
+static_assert(signalbus::closure<int, std::string>::arity == 2, "unexpected arity");
+static_assert(signalbus::closure<>::arity == 0, "unexpected arity");
+
+int main()
+{
+  signalbus::closure<int, const std::string &> append;
+  signalbus::closure<std::unique_ptr<int> > take;
+  signalbus::closure<int &> increase;
+  signalbus::closure<> count;
+  std::string world("world");
+  int value = 1;
+
+  setbuf(stdout,NULL);
+  printf("Invoke C++ closure templates.\n");
+  CLOSURE_CONNECT(append.native()
+    , ()
+    , (
+      text.append(append.arg<1>(), 0, (size_t)append.arg<0>());
+    )
+    , ()
+  );
+  append(5, "hello, there");
+  append(0, world);
+  append(5, world);
+  assert(text == "helloworld");
+
+  /* move-only parameters are handed over without copy */
+  CLOSURE_CONNECT(take.native()
+    , ()
+    , (
+      taken = take.arg<0>();
+    )
+    , ()
+  );
+  take(std::unique_ptr<int>(new int(42)));
+  assert(taken && *taken == 42);
+
+  CLOSURE_CONNECT(increase.native()
+    , ()
+    , (
+      ++increase.arg<0>();
+    )
+    , ()
+  );
+  increase(value);
+  increase(value);
+  assert(value == 3);
+
+  CLOSURE_CONNECT(count.native()
+    , ()
+    , (
+      ++empty_count;
+    )
+    , (
+      empty_count = -empty_count;
+    )
+  );
+  count();
+  count();
+  assert(count.connected());
+  count.free();
+  assert(!count.connected() && empty_count == -2);
+  count();
+  assert(empty_count == -2);
+
+  printf("%s\n", text.c_str());
+  return 0;
+}
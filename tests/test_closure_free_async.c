@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <continuation/reclaimer.h>
+
+#define HANDLER_COUNT 10000
+
+typedef CLOSURE1(long) Handler;
+
+static pthread_t main_thread;
+static long sum = 0;
+static volatile int finalized = 0;
+static volatile int released = 0;
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void release_handler(void *ptr)
+{
+  /* finalized before the storage is released */
+  assert(finalized > released);
+  ATOMIC_FETCH_ADD(&released, 1);
+  free(ptr);
+}
+
+static Handler *connect_handler()
+{
+  Handler *handler = (Handler *)malloc(sizeof(Handler));
+  CLOSURE_INIT(handler);
+  CLOSURE_CONNECT(handler
+    , (
+      CLOSURE_RETAIN_VAR(handler);
+    )
+    , (
+      sum += CLOSURE_ARG_OF_(handler)->_1;
+    )
+    , (
+      assert(!pthread_equal(pthread_self(), main_thread));
+      ATOMIC_FETCH_ADD(&finalized, 1);
+    )
+  );
+  return handler;
+}
+
+int main()
+{
+  static Handler *handlers[HANDLER_COUNT];
+  struct __Reclaimer reclaimer;
+  Handler unconnected;
+  double start, retire_time;
+  int i, error;
+
+  setbuf(stdout,NULL);
+  printf("Free %d closures on a reclaimer thread.\n", HANDLER_COUNT);
+  main_thread = pthread_self();
+  error = reclaimer_init(&reclaimer);
+  assert(error == 0);
+
+  for (i = 0; i < HANDLER_COUNT; ++i) {
+    handlers[i] = connect_handler();
+    CLOSURE1_RUN(handlers[i], i);
+  }
+  assert(sum == (long)HANDLER_COUNT * (HANDLER_COUNT - 1) / 2);
+
+  start = now();
+  for (i = 0; i < HANDLER_COUNT; ++i) {
+    CLOSURE_FREE_ASYNC_ON(&reclaimer, handlers[i], release_handler);
+  }
+  retire_time = now() - start;
+  reclaimer_flush(&reclaimer);
+  assert(finalized == HANDLER_COUNT);
+  assert(released == HANDLER_COUNT);
+  assert(reclaimer.reclaimed_count == HANDLER_COUNT);
+  assert(reclaimer.batch_count >= 1 && reclaimer.batch_count <= HANDLER_COUNT);
+
+  /* an unconnected closure is freed at once */
+  CLOSURE_INIT(&unconnected);
+  CLOSURE_FREE_ASYNC_ON(&reclaimer, &unconnected, NULL);
+  assert(reclaimer.retired_count == HANDLER_COUNT);
+
+  /* the retired closures are freed before the thread exits */
+  handlers[0] = connect_handler();
+  CLOSURE_FREE_ASYNC_ON(&reclaimer, handlers[0], release_handler);
+  reclaimer_free(&reclaimer);
+  assert(finalized == HANDLER_COUNT + 1);
+  assert(released == HANDLER_COUNT + 1);
+
+  handlers[0] = connect_handler();
+  CLOSURE_FREE_ASYNC(handlers[0], release_handler);
+  reclaimer_flush(reclaimer_default());
+  assert(released == HANDLER_COUNT + 2);
+
+  printf("%.0f ns per retirement in %lu batches.\n", retire_time * 1e9 / HANDLER_COUNT, (unsigned long)reclaimer.batch_count);
+  return 0;
+}
@@ -0,0 +1,67 @@
+#include <stdio.h>
+
+#define BOOST_PP_VARIADICS 1
+
+#include <continuation/closure.h>
+
+#define DEPTH 1024
+#define RUN_COUNT 100
+
+struct Quote {
+  int sequence;
+  double bids[DEPTH];
+  double asks[DEPTH];
+};
+
+typedef CLOSURE_REF_N(2, (struct Quote, int)) ClosureQuote;
+
+static const struct Quote *last_quote = NULL;
+static double result = 0;
+
+static void publish(ClosureQuote *closure_quote, int sequence)
+{
+  struct Quote quote;
+  int i;
+  quote.sequence = sequence;
+  for (i = 0; i < DEPTH; ++i) {
+    quote.bids[i] = sequence - i;
+    quote.asks[i] = sequence + i;
+  }
+  CLOSURE_REF_RUN_N(2, closure_quote, (quote, sequence));
+  /* the closure sees the quote in place */
+  assert(last_quote == &quote);
+}
+
+int main()
+{
+  ClosureQuote closure_quote;
+  double spread = 0;
+  int i;
+
+  setbuf(stdout,NULL);
+  printf("A closure taking a large argument by reference.\n");
+  assert(sizeof(closure_quote.arg) < sizeof(struct Quote));
+  CLOSURE_INIT(&closure_quote);
+  CLOSURE_CONNECT(&closure_quote
+    , (
+      CLOSURE_RETAIN_VAR(spread);
+    )
+    , (
+      const struct Quote *quote = CLOSURE_ARG_OF_(&closure_quote)->_1;
+      assert(quote->sequence == *CLOSURE_ARG_OF_(&closure_quote)->_2);
+      spread += quote->asks[DEPTH - 1] - quote->bids[DEPTH - 1];
+      last_quote = quote;
+    )
+    , (
+      result = spread;
+    )
+  );
+
+  for (i = 0; i < RUN_COUNT; ++i) {
+    publish(&closure_quote, i);
+  }
+  CLOSURE_FREE(&closure_quote);
+  printf("the total spread is: %f\n", result);
+  assert(result == 2.0 * (DEPTH - 1) * RUN_COUNT);
+  return 0;
+}
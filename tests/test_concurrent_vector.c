@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <pthread.h>
+
+#include <continuation/misc/concurrent_vector.h>
+
+#define THREAD_COUNT 4
+#define APPEND_COUNT 100000
+
+static CONCURRENT_VECTOR(long) vector = CONCURRENT_VECTOR_STATIC_INITIALIZER();
+static volatile int appending = 1;
+
+static void *append(void *arg)
+{
+  long thread = (long)(size_t)arg;
+  long i;
+  for (i = 0; i < APPEND_COUNT; ++i) {
+    size_t index;
+    CONCURRENT_VECTOR_APPEND_INDEX(&vector, thread * APPEND_COUNT + i, index);
+    assert(index != CONCURRENT_VECTOR_NPOS);
+    assert(CONCURRENT_VECTOR_ITEM(&vector, index) == thread * APPEND_COUNT + i);
+  }
+  return NULL;
+}
+
+static void *read_items(void *arg)
+{
+  long *first = NULL;
+  (void)arg;
+  while (ATOMIC_LOAD(&appending)) {
+    size_t size = CONCURRENT_VECTOR_SIZE(&vector);
+    if (size > 0) {
+      long item = CONCURRENT_VECTOR_ITEM(&vector, size - 1);
+      assert(item >= 0 && item < THREAD_COUNT * APPEND_COUNT);
+      /* the items never move while the vector grows */
+      if (first == NULL) first = &CONCURRENT_VECTOR_ITEM(&vector, 0);
+      assert(first == &CONCURRENT_VECTOR_ITEM(&vector, 0));
+    }
+  }
+  return NULL;
+}
+
+int main()
+{
+  pthread_t threads[THREAD_COUNT], reader;
+  long next[THREAD_COUNT] = {0};
+  long *item;
+  size_t index;
+  long i;
+
+  setbuf(stdout,NULL);
+  printf("Append to a concurrent vector from %d threads.\n", THREAD_COUNT);
+  pthread_create(&reader, NULL, read_items, NULL);
+  for (i = 0; i < THREAD_COUNT; ++i) {
+    pthread_create(&threads[i], NULL, append, (void *)(size_t)i);
+  }
+  for (i = 0; i < THREAD_COUNT; ++i) {
+    pthread_join(threads[i], NULL);
+  }
+  ATOMIC_STORE(&appending, 0);
+  pthread_join(reader, NULL);
+
+  assert(CONCURRENT_VECTOR_SIZE(&vector) == THREAD_COUNT * APPEND_COUNT);
+  CONCURRENT_VECTOR_FOREACH(item, index, &vector) {
+    long thread = *item / APPEND_COUNT;
+    /* the items of a thread keep their order */
+    assert(*item % APPEND_COUNT == next[thread]);
+    ++next[thread];
+  }
+  assert(index == THREAD_COUNT * APPEND_COUNT);
+  for (i = 0; i < THREAD_COUNT; ++i) {
+    assert(next[i] == APPEND_COUNT);
+  }
+  printf("%lu items traversed.\n", (unsigned long)index);
+
+  CONCURRENT_VECTOR_FREE(&vector);
+  CONCURRENT_VECTOR_INIT(&vector);
+  CONCURRENT_VECTOR_APPEND(&vector, 1);
+  assert(CONCURRENT_VECTOR_SIZE(&vector) == 1 && CONCURRENT_VECTOR_ITEM(&vector, 0) == 1);
+  CONCURRENT_VECTOR_FREE(&vector);
+  return 0;
+}
@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <sched.h>
+#include <chrono>
+#include <stdexcept>
+
+#include <continuation/coroutine.hpp>
+#include <continuation/closure.hpp>
+
+#define SQUARE_COUNT 20
+#define WAITER_COUNT 3
+
+static struct __Scheduler scheduler;
+static signalbus::signal<int> ticks;
+
+static signalbus::task<int> square(struct __Scheduler *s, int x)
+{
+  assert(scheduler_current_worker(s) >= 0);
+  co_await signalbus::sleep_for(std::chrono::microseconds(100));
+  co_return x * x;
+}
+
+static signalbus::task<long> sum_squares(struct __Scheduler *s, int n)
+{
+  long total = 0;
+  for (int i = 0; i < n; ++i) {
+    total += co_await square(s, i);
+    co_await signalbus::yield();
+  }
+  co_return total;
+}
+
+static signalbus::task<int> wait_tick(struct __Scheduler *s)
+{
+  int tick = co_await ticks;
+  assert(scheduler_current_worker(s) >= 0);
+  co_return tick;
+}
+
+static signalbus::task<bool> sleep_until_cancelled(struct __Scheduler *s, struct __CancelToken *token)
+{
+  co_await signalbus::sleep_for(std::chrono::seconds(10), token);
+  co_return cancel_token_is_cancelled(token);
+}
+
+/* the token is cancelled after the cancellable sleep, during the plain one */
+static signalbus::task<> sleep_then_sleep(struct __Scheduler *s, struct __CancelToken *token)
+{
+  co_await signalbus::sleep_for(std::chrono::milliseconds(1), token);
+  cancel_token_cancel(token);
+  co_await signalbus::sleep_for(std::chrono::milliseconds(20));
+}
+
+static signalbus::task<> fail(struct __Scheduler *s)
+{
+  co_await signalbus::sleep_for(std::chrono::milliseconds(1));
+  throw std::runtime_error("failed");
+}
+
+static signalbus::task<> sleep_then_fail(struct __Scheduler *s, std::chrono::milliseconds duration)
+{
+  co_await signalbus::sleep_for(duration);
+  co_await fail(s);
+}
+
+int main()
+{
+  signalbus::closure<int> on_tick;
+  long expected = 0;
+  int i;
+
+  setbuf(stdout,NULL);
+  printf("Run coroutines on a scheduler.\n");
+  int error = scheduler_init(&scheduler, 2);
+  assert(error == 0);
+
+  for (i = 0; i < SQUARE_COUNT; ++i) expected += i * i;
+  long total = sum_squares(&scheduler, SQUARE_COUNT).get();
+  assert(total == expected);
+
+  /* the signal is emitted by a closure, as a slot of the bus would */
+  CLOSURE_CONNECT(on_tick.native()
+    , ()
+    , (
+      ticks.emit(on_tick.arg<0>());
+    )
+    , ()
+  );
+  {
+    signalbus::task<int> waiters[WAITER_COUNT] = {wait_tick(&scheduler), wait_tick(&scheduler), wait_tick(&scheduler)};
+    while (ticks.waiting() < WAITER_COUNT) sched_yield();
+    on_tick(7);
+    for (i = 0; i < WAITER_COUNT; ++i) {
+      int tick = waiters[i].get();
+      assert(tick == 7);
+    }
+    assert(ticks.waiting() == 0);
+  }
+
+  {
+    auto start = std::chrono::steady_clock::now();
+    bool caught = false;
+    try {
+      sleep_then_fail(&scheduler, std::chrono::milliseconds(10)).get();
+    } catch (const std::runtime_error &) {
+      caught = true;
+    }
+    assert(caught);
+    assert(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(11));
+  }
+
+  {
+    auto start = std::chrono::steady_clock::now();
+    struct __CancelToken token;
+    cancel_token_init(&token);
+    signalbus::task<bool> sleeper = sleep_until_cancelled(&scheduler, &token);
+    cancel_token_cancel(&token);
+    bool cancelled = sleeper.get();
+    assert(cancelled);
+    assert(std::chrono::steady_clock::now() - start < std::chrono::seconds(1));
+    cancel_token_free(&token);
+  }
+
+  {
+    auto start = std::chrono::steady_clock::now();
+    struct __CancelToken token;
+    cancel_token_init(&token);
+    sleep_then_sleep(&scheduler, &token).get();
+    assert(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(21));
+    cancel_token_free(&token);
+  }
+
+  scheduler_free(&scheduler);
+  printf("%ld\n", expected);
+  return 0;
+}
@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <time.h>
+
+#define BOOST_PP_VARIADICS 1
+
+#include <continuation/closure.h>
+#include <continuation/fiber.h>
+
+#define SWITCH_COUNT 100000
+#define FRAME_SIZE 16384
+
+struct Generator {
+  struct __Fiber fiber;
+  int value;
+};
+
+static void generate(void *arg)
+{
+  struct Generator *generator = (struct Generator *)arg;
+  int i;
+  for (i = 0; i < 10; ++i) {
+    generator->value = i;
+    fiber_yield(&generator->fiber);
+  }
+}
+
+static int recurse(int depth)
+{
+  volatile char buffer[1024];
+  buffer[0] = (char)depth;
+  return depth > 0 ? recurse(depth - 1) + buffer[0] - depth + 1 : 0;
+}
+
+static void run_deep(void *arg)
+{
+  *(int *)arg = recurse(100);
+}
+
+#if defined(__GNUC__) && defined(__x86_64__)
+/* round toward zero in both the SSE and the x87 units */
+#define MXCSR_RC_ZERO 0x6000u
+#define X87_RC_ZERO 0x0c00u
+
+static unsigned int get_mxcsr()
+{
+  unsigned int mxcsr;
+  __asm__ __volatile__("stmxcsr %0" : "=m"(mxcsr));
+  return mxcsr;
+}
+
+static unsigned short get_x87_cw()
+{
+  unsigned short cw;
+  __asm__ __volatile__("fnstcw %0" : "=m"(cw));
+  return cw;
+}
+
+static void round_toward_zero(void *arg)
+{
+  struct __Fiber *fiber = (struct __Fiber *)arg;
+  unsigned int mxcsr = get_mxcsr() | MXCSR_RC_ZERO;
+  unsigned short cw = get_x87_cw() | X87_RC_ZERO;
+  __asm__ __volatile__("ldmxcsr %0" : : "m"(mxcsr));
+  __asm__ __volatile__("fldcw %0" : : "m"(cw));
+  fiber_yield(fiber);
+  assert(get_mxcsr() == mxcsr && get_x87_cw() == cw);
+}
+#endif
+
+static void switch_loop(void *arg)
+{
+  struct __Fiber *fiber = (struct __Fiber *)arg;
+  for (;;) fiber_yield(fiber);
+}
+
+static double bench_fiber()
+{
+  struct __Fiber fiber;
+  clock_t start;
+  double elapsed;
+  int i, error;
+  error = fiber_init(&fiber, NULL, switch_loop, &fiber);
+  assert(error == 0);
+  start = clock();
+  for (i = 0; i < SWITCH_COUNT; ++i) {
+    fiber_resume(&fiber);
+  }
+  elapsed = (double)(clock() - start) / CLOCKS_PER_SEC;
+  fiber_free(&fiber);
+  return elapsed;
+}
+
+static double bench_closure()
+{
+  CLOSURE1(int) closure;
+  volatile char frame[FRAME_SIZE];
+  clock_t start;
+  int i;
+  frame[0] = 0;
+  CLOSURE_INIT(&closure);
+  CLOSURE_CONNECT(&closure
+    , ()
+    , (
+      frame[CLOSURE_ARG_OF_(&closure)->_1 % FRAME_SIZE] = 1;
+    )
+    , ()
+  );
+  start = clock();
+  for (i = 0; i < SWITCH_COUNT; ++i) {
+    CLOSURE1_RUN(&closure, i);
+  }
+  CLOSURE_FREE(&closure);
+  return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main()
+{
+  struct __FiberStackPool pool;
+  struct Generator generator;
+  struct __Fiber fiber;
+  int i, error, result = -1;
+
+  setbuf(stdout,NULL);
+  printf("A generator on a fiber.\n");
+  fiber_stack_pool_init(&pool, 0, 1);
+  error = fiber_init(&generator.fiber, &pool, generate, &generator);
+  assert(error == 0);
+  for (i = 0; i < 10; ++i) {
+    fiber_resume(&generator.fiber);
+    assert(!fiber_is_finished(&generator.fiber));
+    assert(generator.value == i);
+  }
+  fiber_resume(&generator.fiber);
+  assert(fiber_is_finished(&generator.fiber));
+  fiber_free(&generator.fiber);
+  assert(pool.count == 1);
+  printf("%d values generated.\n", i);
+
+  printf("Deep frames on a recycled stack.\n");
+  error = fiber_init(&fiber, &pool, run_deep, &result);
+  assert(error == 0);
+  assert(pool.count == 0);
+  fiber_resume(&fiber);
+  assert(fiber_is_finished(&fiber));
+  assert(result == 100);
+  fiber_free(&fiber);
+  fiber_stack_pool_free(&pool);
+  assert(pool.count == 0);
+
+#if defined(__GNUC__) && defined(__x86_64__)
+  printf("The rounding mode of a fiber is its own.\n");
+  {
+    unsigned int mxcsr = get_mxcsr();
+    unsigned short cw = get_x87_cw();
+    error = fiber_init(&fiber, NULL, round_toward_zero, &fiber);
+    assert(error == 0);
+    fiber_resume(&fiber);
+    assert(get_mxcsr() == mxcsr && get_x87_cw() == cw);
+    fiber_resume(&fiber);
+    assert(fiber_is_finished(&fiber));
+    assert(get_mxcsr() == mxcsr && get_x87_cw() == cw);
+    fiber_free(&fiber);
+  }
+#endif
+
+  printf("%d switches with a fiber: %.3fs\n", SWITCH_COUNT, bench_fiber());
+  printf("%d invocations of a closure with %d bytes frame: %.3fs\n", SWITCH_COUNT, FRAME_SIZE, bench_closure());
+  return 0;
+}
@@ -0,0 +1,42 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <continuation/continuation.h>
+
+#define MAX_FRAME_SIZE 1024
+#define GUARD_SIZE 64
+#define GUARD 0xa5
+
+static unsigned char src[MAX_FRAME_SIZE + GUARD_SIZE];
+static unsigned char dst[GUARD_SIZE + MAX_FRAME_SIZE + GUARD_SIZE];
+
+int main()
+{
+  size_t size, offset, i;
+  ContinuationFrameCopy last = NULL;
+  void *copied;
+  int kernels = 0;
+
+  setbuf(stdout,NULL);
+  printf("Copy stack frames by the selected kernels.\n");
+  for (i = 0; i < sizeof(src); ++i) src[i] = (unsigned char)rand();
+  for (size = 0; size <= MAX_FRAME_SIZE; ++size) {
+    ContinuationFrameCopy copy_frame = continuation_select_frame_copy(size);
+    assert(copy_frame != NULL);
+    assert(copy_frame == continuation_select_frame_copy(size));
+    if (copy_frame != last) ++kernels;
+    last = copy_frame;
+    /* misaligned both sides */
+    for (offset = 0; offset < 4; ++offset) {
+      memset(dst, GUARD, sizeof(dst));
+      copied = copy_frame(dst + GUARD_SIZE + offset, src + offset * 3, size);
+      assert(copied == dst + GUARD_SIZE + offset);
+      assert(memcmp(dst + GUARD_SIZE + offset, src + offset * 3, size) == 0);
+      for (i = 0; i < GUARD_SIZE + offset; ++i) assert(dst[i] == GUARD);
+      for (i = GUARD_SIZE + offset + size; i < sizeof(dst); ++i) assert(dst[i] == GUARD);
+    }
+  }
+  printf("%d size classes copied.\n", kernels);
+  return 0;
+}
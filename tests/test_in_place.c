@@ -0,0 +1,96 @@
+#include <stdio.h>
+#include <string.h>
+
+#define BOOST_PP_VARIADICS 1
+#define CONTINUATION_USE_IN_PLACE_INVOKE 1
+
+#include <continuation/closure.h>
+#include <continuation/topic.h>
+
+#define RUN_COUNT 100
+
+static int in_place_count = 0;
+static int relocated_count = 0;
+static int result = 0;
+static const char *received_name = NULL;
+static void *received_message = NULL;
+
+typedef CLOSURE1(int) ClosureSum;
+
+static void run_sum(ClosureSum *closure_sum, int i)
+{
+  CLOSURE1_RUN(closure_sum, i);
+}
+
+int main()
+{
+  ClosureSum closure_sum;
+  int i;
+
+  setbuf(stdout,NULL);
+  printf("A closure invoked by its host function in place.\n");
+  CLOSURE_INIT(&closure_sum);
+  CLOSURE_CONNECT(&closure_sum
+    , (
+      int sum = 0;
+      CLOSURE_RETAIN_VAR(sum);
+    )
+    , (
+      if (CLOSURE_GET_FRAME_OFFSET() == 0) {
+        ++in_place_count;
+      } else {
+        ++relocated_count;
+      }
+      sum += CLOSURE_ARG_OF_(&closure_sum)->_1;
+    )
+    , (
+      result = sum;
+    )
+  );
+
+  for (i = 1; i <= RUN_COUNT; ++i) {
+    if (i % 2) {
+      CLOSURE1_RUN(&closure_sum, i);
+    } else {
+      run_sum(&closure_sum, i);
+    }
+  }
+  printf("%d invocations in place, %d relocated.\n", in_place_count, relocated_count);
+  assert(in_place_count == RUN_COUNT / 2);
+  assert(relocated_count == RUN_COUNT / 2);
+  assert(i == RUN_COUNT + 1);
+
+  CLOSURE_FREE(&closure_sum);
+  printf("the sum result is: %d\n", result);
+  assert(result == RUN_COUNT * (RUN_COUNT + 1) / 2);
+
+  printf("A closure invoked by the library compiled without in place invocation.\n");
+  {
+    struct __TopicRegistry registry;
+    struct __TopicSubscription *subscription;
+    TopicSlot slot;
+    int error, count;
+    error = topic_registry_init(&registry);
+    assert(error == 0);
+    CLOSURE_INIT(&slot);
+    CLOSURE_CONNECT(&slot
+      , ()
+      , (
+        /* the arguments are found at the same offsets by the library */
+        received_name = CLOSURE_ARG_OF_(&slot)->_1;
+        received_message = CLOSURE_ARG_OF_(&slot)->_2;
+      )
+      , ()
+    );
+    subscription = topic_subscribe(&registry, "sum", &slot);
+    assert(subscription != NULL);
+    count = topic_publish(&registry, "sum", &result);
+    assert(count == 1);
+    assert(received_name != NULL && strcmp(received_name, "sum") == 0);
+    assert(received_message == &result);
+    topic_unsubscribe(&registry, subscription);
+    topic_registry_free(&registry);
+    CLOSURE_FREE(&slot);
+  }
+  return 0;
+}
@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <pthread.h>
+
+#define BOOST_PP_VARIADICS 1
+
+#include <continuation/inbox.h>
+
+#define PRODUCER_COUNT 4
+#define EMIT_COUNT 10000
+
+static struct __Inbox inbox;
+static InboxSlot slot;
+static pthread_t owner;
+static size_t next[PRODUCER_COUNT];
+
+static void *produce(void *arg)
+{
+  size_t producer = (size_t)arg;
+  size_t i;
+  int error;
+  for (i = 0; i < EMIT_COUNT; ++i) {
+    error = inbox_emit(&inbox, &slot, (void *)(producer * EMIT_COUNT + i));
+    assert(error == 0);
+  }
+  return NULL;
+}
+
+int main()
+{
+  pthread_t producers[PRODUCER_COUNT];
+  int received = 0, batches = 0, error, ready;
+  size_t i;
+
+  setbuf(stdout,NULL);
+  printf("Deliver messages from %d threads to the owner of an inbox.\n", PRODUCER_COUNT);
+  owner = pthread_self();
+  error = inbox_init(&inbox);
+  assert(error == 0);
+  inbox_bind(&inbox);
+  assert(inbox_current() == &inbox);
+  ready = inbox_wait(&inbox, 0);
+  assert(ready == 0);
+
+  CLOSURE_INIT(&slot);
+  CLOSURE_CONNECT(&slot
+    , ()
+    , (
+      size_t message = (size_t)CLOSURE_ARG_OF_(&slot)->_1;
+      /* always run on the owner thread, in the order of emission of each producer */
+      assert(pthread_equal(pthread_self(), owner));
+      assert(message % EMIT_COUNT == next[message / EMIT_COUNT]);
+      ++next[message / EMIT_COUNT];
+    )
+    , ()
+  );
+
+  for (i = 0; i < PRODUCER_COUNT; ++i) {
+    pthread_create(&producers[i], NULL, produce, (void *)i);
+  }
+  while (received < PRODUCER_COUNT * EMIT_COUNT) {
+    ready = inbox_wait(&inbox, -1);
+    assert(ready);
+    received += inbox_drain(&inbox);
+    ++batches;
+  }
+  for (i = 0; i < PRODUCER_COUNT; ++i) {
+    pthread_join(producers[i], NULL);
+    assert(next[i] == EMIT_COUNT);
+  }
+  printf("%d messages delivered in %d batches.\n", received, batches);
+
+  received = inbox_drain(&inbox);
+  assert(received == 0);
+  CLOSURE_FREE(&slot);
+  inbox_free(&inbox);
+  assert(inbox_current() == NULL);
+  return 0;
+}
@@ -0,0 +1,81 @@
+#include <stdio.h>
+
+#define BOOST_PP_VARIADICS 1
+
+#include <continuation/closure.h>
+#include <continuation/fiber.h>
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
+
+#define FRAME_SIZE 65536
+
+typedef CLOSURE1(int) ClosureSum;
+
+#ifdef HAVE_PTHREAD
+/* the invoke stack of the thread is released when it exits */
+static void *run_on_thread(void *arg)
+{
+  CLOSURE1_RUN((ClosureSum *)arg, 0);
+  return NULL;
+}
+#endif
+
+int main()
+{
+  ClosureSum closure, nested;
+  volatile char frame[FRAME_SIZE];
+  int i, sum = 0, nested_sum = 0;
+
+  setbuf(stdout,NULL);
+  printf("A closure with %d bytes frame on the invoke stack.\n", FRAME_SIZE);
+
+  frame[0] = 0;
+  CLOSURE_INIT(&nested);
+  CLOSURE_CONNECT(&nested
+    , (
+      CLOSURE_RETAIN_VAR(nested_sum);
+    )
+    , (
+      /* nesting invocation runs on the same invoke stack */
+      assert(fiber_current() != NULL);
+      nested_sum += CLOSURE_ARG_OF_(&nested)->_1;
+    )
+    , ()
+  );
+
+  CLOSURE_INIT(&closure);
+  CLOSURE_CONNECT(&closure
+    , (
+      CLOSURE_RETAIN_VAR(sum);
+    )
+    , (
+      assert(fiber_current() != NULL);
+      frame[CLOSURE_ARG_OF_(&closure)->_1] = 1;
+      sum += CLOSURE_ARG_OF_(&closure)->_1;
+      CLOSURE1_RUN(&nested, CLOSURE_ARG_OF_(&closure)->_1);
+    )
+    , (
+      printf("the sum result is: %d\n", sum);
+      assert(sum == 5050);
+    )
+  );
+
+  for (i = 1; i <= 100; ++i) {
+    CLOSURE1_RUN(&closure, i);
+  }
+  assert(fiber_current() == NULL);
+#ifdef HAVE_PTHREAD
+  {
+    pthread_t thread;
+    int error = pthread_create(&thread, NULL, run_on_thread, &closure);
+    assert(error == 0);
+    pthread_join(thread, NULL);
+  }
+#endif
+  CLOSURE_FREE(&closure);
+
+  CLOSURE_FREE(&nested);
+  continuation_invoke_stack_free();
+  return 0;
+}
@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define BOOST_PP_VARIADICS 1
+
+#include <continuation/journal.h>
+#include <continuation/payload.h>
+
+#define JOURNAL_PREFIX "test_journal.tmp"
+#define SEGMENT_SIZE 4096
+#define THREAD_COUNT 4
+#define APPEND_COUNT 1000
+#define TAP_COUNT 100
+
+static struct __Journal journal;
+static long replayed[THREAD_COUNT];
+static long replayed_sum = 0;
+static long tapped = 0;
+
+static void *append(void *arg)
+{
+  long thread = (long)(size_t)arg;
+  long i;
+  int error;
+  for (i = 0; i < APPEND_COUNT; ++i) {
+    long message[2];
+    message[0] = thread;
+    message[1] = i;
+    error = journal_append(&journal, "orders.eu.fill", message, sizeof(message));
+    assert(error == 0);
+  }
+  return NULL;
+}
+
+int main()
+{
+  pthread_t threads[THREAD_COUNT];
+  struct __TopicRegistry registry;
+  struct __JournalTap tap;
+  TopicSlot replay_slot, tap_slot;
+  struct __TopicSubscription *subscription;
+  char path[64];
+  long i, count;
+  int error;
+
+  setbuf(stdout,NULL);
+  printf("Record from %d threads into a journal of rotated segments.\n", THREAD_COUNT);
+  error = journal_open(&journal, JOURNAL_PREFIX, SEGMENT_SIZE);
+  assert(error == 0);
+  for (i = 0; i < THREAD_COUNT; ++i) {
+    pthread_create(&threads[i], NULL, append, (void *)(size_t)i);
+  }
+  for (i = 0; i < THREAD_COUNT; ++i) {
+    pthread_join(threads[i], NULL);
+  }
+  assert(journal.sequence == THREAD_COUNT * APPEND_COUNT);
+
+  printf("Record the messages published to a topic by a tap.\n");
+  error = topic_registry_init(&registry);
+  assert(error == 0);
+  journal_tap_init(&tap, &journal, 0);
+  subscription = topic_subscribe(&registry, "quotes.#", &tap.slot);
+  assert(subscription != NULL);
+  for (i = 0; i < TAP_COUNT; ++i) {
+    long *message = (long *)payload_alloc(2 * sizeof(long));
+    message[0] = THREAD_COUNT;
+    message[1] = i;
+    count = topic_publish(&registry, "quotes.eu", message);
+    assert(count == 1);
+    payload_release(message);
+  }
+  journal_tap_free(&tap);
+  topic_registry_free(&registry);
+  journal_close(&journal);
+  payload_cache_flush();
+
+  printf("Replay the journal.\n");
+  error = topic_registry_init(&registry);
+  assert(error == 0);
+  CLOSURE_INIT(&replay_slot);
+  CLOSURE_CONNECT(&replay_slot
+    , ()
+    , (
+      const long *message = (const long *)CLOSURE_ARG_OF_(&replay_slot)->_2;
+      /* the records of a thread keep their order */
+      assert(message[0] < THREAD_COUNT && message[1] == replayed[message[0]]);
+      ++replayed[message[0]];
+      replayed_sum += message[1];
+    )
+    , ()
+  );
+  CLOSURE_INIT(&tap_slot);
+  CLOSURE_CONNECT(&tap_slot
+    , ()
+    , (
+      const long *message = (const long *)CLOSURE_ARG_OF_(&tap_slot)->_2;
+      assert(message[0] == THREAD_COUNT && message[1] == tapped);
+      ++tapped;
+    )
+    , ()
+  );
+  subscription = topic_subscribe(&registry, "orders.*.fill", &replay_slot);
+  assert(subscription != NULL);
+  subscription = topic_subscribe(&registry, "quotes.eu", &tap_slot);
+  assert(subscription != NULL);
+  count = journal_replay(JOURNAL_PREFIX, &registry, 0);
+  printf("%ld records replayed.\n", count);
+  assert(count == THREAD_COUNT * APPEND_COUNT + TAP_COUNT);
+  assert(replayed_sum == (long)THREAD_COUNT * APPEND_COUNT * (APPEND_COUNT - 1) / 2);
+  assert(tapped == TAP_COUNT);
+  count = journal_replay("test_journal.none", &registry, 0);
+  assert(count == -1);
+
+  topic_registry_free(&registry);
+  CLOSURE_FREE(&replay_slot);
+  CLOSURE_FREE(&tap_slot);
+  for (i = 0; ; ++i) {
+    snprintf(path, sizeof(path), JOURNAL_PREFIX ".%06ld", i);
+    if (unlink(path) != 0) break;
+  }
+  assert(i > 1);
+  return 0;
+}
@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BOOST_PP_VARIADICS 1
+
+#include <continuation/parallel.h>
+
+#define ELEMENT_COUNT 100000
+#define WORKER_COUNT 4
+
+static void fill(struct __Scheduler *scheduler, long *values, long n)
+{
+  long i;
+  long base = 3;
+  ASYNC_FOR_ON(scheduler, i, 0, n, 1000,
+    values[i] = base * i;
+  );
+}
+
+static long sum(struct __Scheduler *scheduler, const long *values, long n, long grain)
+{
+  long i;
+  long total = 0;
+  ASYNC_REDUCE_ON(scheduler, total, +, i, 0, n, grain,
+    total += values[i];
+  );
+  return total;
+}
+
+static long count_odd(const long *values, long n)
+{
+  long i;
+  long odd = 0;
+  ASYNC_REDUCE(odd, +, i, 0, n, 0,
+    if (values[i] & 1) ++odd;
+  );
+  return odd;
+}
+
+struct NestedTask {
+  struct __SchedulerTask task;
+  struct __Scheduler *scheduler;
+  const long *values;
+  long total;
+  volatile int done;
+};
+
+/* a loop run by a worker helps the others instead of blocking */
+static void nested_task_run(struct __SchedulerTask *task)
+{
+  struct NestedTask *nested = (struct NestedTask *)task;
+  nested->total = sum(nested->scheduler, nested->values, ELEMENT_COUNT, 100);
+  ATOMIC_STORE(&nested->done, 1);
+}
+
+int main()
+{
+  struct __Scheduler scheduler;
+  struct NestedTask nested;
+  long *values = (long *)malloc(ELEMENT_COUNT * sizeof(long));
+  long expected = 3L * ELEMENT_COUNT * (ELEMENT_COUNT - 1) / 2;
+  long i, total;
+  int error;
+
+  setbuf(stdout,NULL);
+  error = scheduler_init(&scheduler, WORKER_COUNT);
+  assert(error == 0);
+
+  printf("Fill an array in parallel.\n");
+  fill(&scheduler, values, ELEMENT_COUNT);
+  for (i = 0; i < ELEMENT_COUNT; ++i) assert(values[i] == 3 * i);
+
+  printf("Reduce the array in parallel.\n");
+  total = sum(&scheduler, values, ELEMENT_COUNT, 0);
+  assert(total == expected);
+  total = sum(&scheduler, values, ELEMENT_COUNT, 1);
+  assert(total == expected);
+  total = sum(&scheduler, values, ELEMENT_COUNT, ELEMENT_COUNT);
+  assert(total == expected);
+  total = sum(&scheduler, values, 1, 0);
+  assert(total == 0);
+  total = sum(&scheduler, values, 0, 0);
+  assert(total == 0);
+  total = count_odd(values, ELEMENT_COUNT);
+  assert(total == ELEMENT_COUNT / 2);
+
+  printf("Run a parallel loop inside a worker.\n");
+  scheduler_task_init(&nested.task, nested_task_run);
+  nested.scheduler = &scheduler;
+  nested.values = values;
+  nested.done = 0;
+  scheduler_submit(&scheduler, &nested.task);
+  while (!ATOMIC_LOAD(&nested.done)) sched_yield();
+  assert(nested.total == expected);
+
+  scheduler_free(&scheduler);
+  free(values);
+  return 0;
+}
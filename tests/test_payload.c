@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <string.h>
+
+#define BOOST_PP_VARIADICS 1
+
+#include <continuation/closure.h>
+#include <continuation/payload.h>
+
+#define SLOT_COUNT 8
+#define EMIT_COUNT 1000
+#define MESSAGE_SIZE 4096
+
+typedef CLOSURE1(void *) SlotMessage;
+
+static void *kept[SLOT_COUNT];
+
+static void connect_slot(SlotMessage *slot, int index)
+{
+  CLOSURE_INIT(slot);
+  CLOSURE_CONNECT(slot
+    , (
+      CLOSURE_RETAIN_VAR(slot);
+      CLOSURE_RETAIN_VAR(index);
+    )
+    , (
+      /* keep the message beyond the invocation */
+      if (kept[index]) payload_release(kept[index]);
+      kept[index] = payload_retain(CLOSURE_ARG_OF_(slot)->_1);
+    )
+    , ()
+  );
+}
+
+int main()
+{
+  SlotMessage slots[SLOT_COUNT];
+  char plain[2 * __PAYLOAD_HEADER_SIZE] = {0};
+  void *message, *last = NULL, *before_last = NULL;
+  int i, j, reused = 0;
+
+  setbuf(stdout,NULL);
+  printf("Emit a reference counted payload to %d slots.\n", SLOT_COUNT);
+  for (i = 0; i < SLOT_COUNT; ++i) {
+    connect_slot(&slots[i], i);
+  }
+
+  for (i = 0; i < EMIT_COUNT; ++i) {
+    message = payload_alloc(MESSAGE_SIZE);
+    assert(message != NULL && payload_size(message) >= MESSAGE_SIZE);
+    assert(payload_length(message) == MESSAGE_SIZE);
+    assert(payload_is_buffer(message));
+    /* the buffer of the message before last is recycled when all of the slots drop it */
+    if (message == before_last) ++reused;
+    memset(message, i & 0xff, MESSAGE_SIZE);
+    for (j = 0; j < SLOT_COUNT; ++j) {
+      CLOSURE1_RUN(&slots[j], message);
+    }
+    assert(__payload_of(message)->refcount == SLOT_COUNT + 1);
+    payload_release(message);
+    assert(__payload_of(message)->refcount == SLOT_COUNT);
+    before_last = last;
+    last = message;
+  }
+  for (j = 0; j < SLOT_COUNT; ++j) {
+    assert(kept[j] == message);
+    assert(((unsigned char *)kept[j])[MESSAGE_SIZE - 1] == ((EMIT_COUNT - 1) & 0xff));
+    payload_release(kept[j]);
+  }
+  /* a plain message is told from the payload buffers */
+  assert(!payload_is_buffer(plain + __PAYLOAD_HEADER_SIZE));
+  assert(!payload_is_buffer(NULL));
+  printf("%d of %d buffers reused.\n", reused, EMIT_COUNT);
+  assert(reused == EMIT_COUNT - 2);
+  last = payload_alloc(MESSAGE_SIZE);
+  assert(last == message);
+  payload_release(last);
+  /* the recycled buffer keeps the length requested again */
+  last = payload_alloc(MESSAGE_SIZE - 1);
+  assert(last == message && payload_length(last) == MESSAGE_SIZE - 1 && payload_size(last) == MESSAGE_SIZE);
+  payload_release(last);
+
+  payload_cache_flush();
+  for (i = 0; i < SLOT_COUNT; ++i) {
+    CLOSURE_FREE(&slots[i]);
+  }
+  return 0;
+}
@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <sched.h>
+#include <time.h>
+
+#define BOOST_PP_VARIADICS 1
+
+#include <continuation/scheduler.h>
+
+#define TASK_COUNT 100000
+#define SPAWN_COUNT 1000
+#define YIELD_COUNT 10
+#define TIMER_COUNT 10
+#define TIMER_INTERVAL 5000000 /* 5ms */
+
+struct CountTask {
+  struct __SchedulerTask task;
+  struct __Scheduler *scheduler;
+  volatile long *counter;
+  int depth;
+  int allocated;
+};
+
+static void count_task_run(struct __SchedulerTask *task)
+{
+  struct CountTask *count_task = (struct CountTask *)task;
+  int i;
+  /* fork subtasks from the worker to exercise the local run queue and stealing */
+  for (i = 0; i < 2 && count_task->depth > 0; ++i) {
+    struct CountTask *child = (struct CountTask *)malloc(sizeof(struct CountTask));
+    scheduler_task_init(&child->task, count_task_run);
+    child->scheduler = count_task->scheduler;
+    child->counter = count_task->counter;
+    child->depth = count_task->depth - 1;
+    child->allocated = 1;
+    scheduler_submit(count_task->scheduler, &child->task);
+  }
+  ATOMIC_FETCH_ADD(count_task->counter, 1);
+  if (count_task->allocated) free(count_task);
+}
+
+struct TimerTask {
+  struct __SchedulerTask task;
+  uint64_t due;
+  volatile long *counter;
+  int ran;
+};
+
+static uint64_t now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void timer_task_run(struct __SchedulerTask *task)
+{
+  struct TimerTask *timer_task = (struct TimerTask *)task;
+  timer_task->ran = 1;
+  ATOMIC_FETCH_ADD(timer_task->counter, 1);
+}
+
+/* spawned continuations are expanded here to run on fibers */
+#undef CONTINUATION_USE_FIBER
+#define CONTINUATION_USE_FIBER 1
+
+static void spawn_fibers(struct __Scheduler *scheduler, int *results, volatile long *counter)
+{
+  int i, error;
+  for (i = 0; i < SPAWN_COUNT; ++i) {
+    error = ASYNC_SPAWN_ON(scheduler,
+      int j;
+      for (j = 0; j < YIELD_COUNT; ++j) {
+        /* the local variables are kept on the stack of fiber */
+        results[i] += i;
+        ASYNC_YIELD();
+      }
+      ATOMIC_FETCH_ADD(counter, 1);
+    );
+    assert(error == 0);
+  }
+}
+
+int main()
+{
+  struct __Scheduler scheduler;
+  struct CountTask *tasks;
+  struct TimerTask timers[TIMER_COUNT + 1];
+  volatile long counter = 0;
+  int results[SPAWN_COUNT];
+  int i, error;
+
+  setbuf(stdout,NULL);
+  printf("Tasks submitted from outside of the pool.\n");
+
+  error = scheduler_init(&scheduler, 4);
+  assert(error == 0);
+  tasks = (struct CountTask *)malloc(TASK_COUNT * sizeof(struct CountTask));
+  for (i = 0; i < TASK_COUNT; ++i) {
+    scheduler_task_init(&tasks[i].task, count_task_run);
+    tasks[i].scheduler = &scheduler;
+    tasks[i].counter = &counter;
+    tasks[i].depth = 0;
+    tasks[i].allocated = 0;
+    scheduler_submit(&scheduler, &tasks[i].task);
+  }
+  while (ATOMIC_LOAD(&counter) < TASK_COUNT) sched_yield();
+  printf("%ld tasks done.\n", counter);
+
+  printf("Tasks forked by the workers.\n");
+  counter = 0;
+  tasks[0].depth = 12;
+  scheduler_submit(&scheduler, &tasks[0].task);
+  while (ATOMIC_LOAD(&counter) < (2 << 12) - 1) sched_yield();
+  printf("%ld tasks done.\n", counter);
+
+  printf("Continuations spawned to the scheduler.\n");
+  counter = 0;
+  for (i = 0; i < SPAWN_COUNT; ++i) {
+    error = ASYNC_SPAWN_ON(&scheduler,
+      /* the host function is waiting, so its variables are accessible */
+      ASYNC_HOST_VAR(results)[i] = i * i;
+      ATOMIC_FETCH_ADD(&ASYNC_HOST_VAR(counter), 1);
+    );
+    assert(error == 0);
+  }
+  while (ATOMIC_LOAD(&counter) < SPAWN_COUNT) sched_yield();
+  for (i = 0; i < SPAWN_COUNT; ++i) {
+    assert(results[i] == i * i);
+  }
+  printf("%ld continuations done.\n", counter);
+
+  printf("Continuations yielding on fibers.\n");
+  counter = 0;
+  memset(results, 0, sizeof(results));
+  spawn_fibers(&scheduler, results, &counter);
+  while (ATOMIC_LOAD(&counter) < SPAWN_COUNT) sched_yield();
+  for (i = 0; i < SPAWN_COUNT; ++i) {
+    assert(results[i] == i * YIELD_COUNT);
+  }
+  printf("%ld continuations done.\n", counter);
+
+  printf("Tasks submitted after delays.\n");
+  counter = 0;
+  for (i = 0; i < TIMER_COUNT; ++i) {
+    /* the later submitted, the earlier due */
+    uint64_t delay = (uint64_t)(TIMER_COUNT - i) * TIMER_INTERVAL;
+    scheduler_task_init(&timers[i].task, timer_task_run);
+    timers[i].due = now() + delay;
+    timers[i].counter = &counter;
+    timers[i].ran = 0;
+    scheduler_submit_after(&scheduler, &timers[i].task, delay);
+  }
+  while (ATOMIC_LOAD(&counter) < TIMER_COUNT) {
+    for (i = 0; i < TIMER_COUNT; ++i) {
+      /* never earlier than the deadline, the clock is read after the flag */
+      assert(!ATOMIC_LOAD(&timers[i].ran) || now() >= timers[i].due);
+    }
+    sched_yield();
+  }
+  printf("%ld timers fired.\n", counter);
+
+  /* the pending timers are run when the scheduler is freed */
+  scheduler_task_init(&timers[TIMER_COUNT].task, timer_task_run);
+  timers[TIMER_COUNT].counter = &counter;
+  timers[TIMER_COUNT].ran = 0;
+  scheduler_submit_after(&scheduler, &timers[TIMER_COUNT].task, (uint64_t)3600 * 1000000000u);
+  scheduler_free(&scheduler);
+  assert(timers[TIMER_COUNT].ran && counter == TIMER_COUNT + 1);
+  free(tasks);
+  return 0;
+}
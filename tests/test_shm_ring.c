@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <string.h>
+#include <sched.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#define BOOST_PP_VARIADICS 1
+
+#include <continuation/shm_ring.h>
+
+#define PRODUCER_COUNT 2
+#define SEND_COUNT 100000
+#define CAPACITY 4096
+#define SEND_BATCH 50
+
+struct Message {
+  long sequence;
+  char text[20];
+};
+
+static long next[PRODUCER_COUNT];
+static long received = 0;
+
+static void produce(const char *name, unsigned int channel)
+{
+  struct __ShmRing ring;
+  long i;
+  int error;
+  error = shm_ring_attach(&ring, name);
+  assert(error == 0);
+  for (i = 0; i < SEND_COUNT; ++i) {
+    struct Message *message;
+    /* build the message in place */
+    while ((message = (struct Message *)shm_ring_reserve(&ring, channel, sizeof(struct Message))) == NULL) {
+      sched_yield();
+    }
+    message->sequence = i;
+    snprintf(message->text, sizeof(message->text), "message %ld", i % 10);
+    shm_ring_commit(&ring, message);
+  }
+  shm_ring_close(&ring);
+}
+
+int main()
+{
+  struct __ShmRing ring;
+  ShmRingSlot dispatcher;
+  pid_t producers[PRODUCER_COUNT];
+  char name[64];
+  pid_t pid;
+  void *payload;
+  int i, status, error, ready, dispatched;
+
+  setbuf(stdout,NULL);
+  printf("Deliver messages from %d processes through a shared memory ring.\n", PRODUCER_COUNT);
+  snprintf(name, sizeof(name), "/signalbus.test.%ld", (long)getpid());
+  error = shm_ring_create(&ring, name, CAPACITY);
+  assert(error == 0);
+
+  CLOSURE_INIT(&dispatcher);
+  CLOSURE_CONNECT(&dispatcher
+    , ()
+    , (
+      unsigned int channel = CLOSURE_ARG_OF_(&dispatcher)->_1;
+      const struct Message *message = (const struct Message *)CLOSURE_ARG_OF_(&dispatcher)->_2;
+      char text[20];
+      assert(channel < PRODUCER_COUNT && CLOSURE_ARG_OF_(&dispatcher)->_3 == sizeof(struct Message));
+      /* in the order of each producer */
+      assert(message->sequence == next[channel]);
+      snprintf(text, sizeof(text), "message %ld", message->sequence % 10);
+      assert(strcmp(message->text, text) == 0);
+      ++next[channel];
+      ++received;
+    )
+    , ()
+  );
+
+  for (i = 0; i < PRODUCER_COUNT; ++i) {
+    producers[i] = fork();
+    assert(producers[i] >= 0);
+    if (producers[i] == 0) {
+      produce(name, (unsigned int)i);
+      _exit(0);
+    }
+  }
+  while (received < PRODUCER_COUNT * SEND_COUNT) {
+    if (shm_ring_wait(&ring, 1000)) {
+      shm_ring_dispatch(&ring, &dispatcher);
+    }
+  }
+  for (i = 0; i < PRODUCER_COUNT; ++i) {
+    pid = waitpid(producers[i], &status, 0);
+    assert(pid == producers[i] && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    assert(next[i] == SEND_COUNT);
+  }
+  printf("%ld messages dispatched.\n", received);
+
+  /* copying send and an anonymous ring */
+  shm_ring_close(&ring);
+  shm_unlink(name);
+  error = shm_ring_create(&ring, NULL, CAPACITY);
+  assert(error == 0);
+  received = 0;
+  memset(next, 0, sizeof(next));
+  for (i = 0; i < SEND_BATCH; ++i) {
+    struct Message message;
+    message.sequence = i;
+    snprintf(message.text, sizeof(message.text), "message %d", i % 10);
+    error = shm_ring_send(&ring, 1, &message, sizeof(message));
+    assert(error == 0);
+  }
+  error = shm_ring_send(&ring, 1, name, CAPACITY);
+  assert(error == EAGAIN);
+  ready = shm_ring_wait(&ring, 0);
+  assert(ready);
+  dispatched = shm_ring_dispatch(&ring, &dispatcher);
+  assert(dispatched == SEND_BATCH);
+  ready = shm_ring_wait(&ring, 0);
+  assert(ready == 0);
+
+  /* a record longer than the offset of the head is reserved after the padding is consumed */
+  CLOSURE_FREE(&dispatcher);
+  CLOSURE_INIT(&dispatcher);
+  CLOSURE_CONNECT(&dispatcher
+    , ()
+    , (
+      ++received;
+    )
+    , ()
+  );
+  received = 0;
+  payload = shm_ring_reserve(&ring, 0, CAPACITY / 2);
+  assert(payload != NULL);
+  shm_ring_commit(&ring, payload);
+  dispatched = shm_ring_dispatch(&ring, &dispatcher);
+  assert(dispatched == 1);
+  for (i = 0; (payload = shm_ring_reserve(&ring, 0, CAPACITY * 3 / 4)) == NULL; ++i) {
+    assert(i < 2);
+    shm_ring_dispatch(&ring, &dispatcher);
+  }
+  shm_ring_commit(&ring, payload);
+  dispatched = shm_ring_dispatch(&ring, &dispatcher);
+  assert(dispatched == 1 && received == 2);
+  shm_ring_close(&ring);
+
+  CLOSURE_FREE(&dispatcher);
+  return 0;
+}
@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <sched.h>
+#include <errno.h>
+
+#define BOOST_PP_VARIADICS 1
+
+#include <continuation/signal_queue.h>
+
+#define CAPACITY 4
+#define BURST 16
+#define BLOCK_COUNT 10000
+
+static volatile int gate_open = 1;
+static volatile int entered = 0;
+static long received[BLOCK_COUNT];
+static volatile long received_count = 0;
+static long discarded_count = 0;
+
+static void discard(void *message)
+{
+  (void)message;
+  ++discarded_count;
+}
+
+struct CancelTask {
+  struct __SchedulerTask task;
+  struct __CancelToken *token;
+};
+
+static void cancel_task_run(struct __SchedulerTask *task)
+{
+  cancel_token_cancel(((struct CancelTask *)task)->token);
+}
+
+static void reset(int open)
+{
+  gate_open = open;
+  entered = 0;
+  received_count = 0;
+  discarded_count = 0;
+}
+
+/* emit the first message and wait until the slot is stuck on it */
+static void stall(struct __SignalQueue *queue)
+{
+  int error;
+  error = signal_queue_emit(queue, 0, (void *)0);
+  assert(error == 0);
+  while (!ATOMIC_LOAD(&entered)) sched_yield();
+}
+
+int main()
+{
+  struct __Scheduler scheduler;
+  struct __SignalQueue queue;
+  struct __SignalQueueStats stats;
+  struct __CancelToken token;
+  struct CancelTask cancel_task;
+  SignalQueueSlot slot;
+  long i;
+  int error;
+
+  setbuf(stdout,NULL);
+  error = scheduler_init(&scheduler, 2);
+  assert(error == 0);
+  CLOSURE_INIT(&slot);
+  CLOSURE_CONNECT(&slot
+    , ()
+    , (
+      ATOMIC_STORE(&entered, 1);
+      while (!ATOMIC_LOAD(&gate_open)) sched_yield();
+      received[received_count] = (long)(size_t)CLOSURE_ARG_OF_(&slot)->_1;
+      ATOMIC_STORE(&received_count, received_count + 1);
+    )
+    , ()
+  );
+
+  printf("Drop the newest messages on overflow.\n");
+  reset(0);
+  error = signal_queue_init(&queue, &scheduler, &slot, CAPACITY, SIGNAL_QUEUE_DROP_NEWEST, discard);
+  assert(error == 0);
+  stall(&queue);
+  for (i = 1; i <= BURST; ++i) {
+    error = signal_queue_emit(&queue, i, (void *)(size_t)i);
+    assert(error == (i <= CAPACITY ? 0 : EAGAIN));
+  }
+  ATOMIC_STORE(&gate_open, 1);
+  signal_queue_get_stats(&queue, &stats);
+  signal_queue_free(&queue);
+  assert(received_count == CAPACITY + 1 && received[CAPACITY] == CAPACITY);
+  assert(stats.high_water == CAPACITY && stats.dropped == BURST - CAPACITY);
+  assert(discarded_count == BURST - CAPACITY);
+
+  printf("Drop the oldest messages on overflow.\n");
+  reset(0);
+  error = signal_queue_init(&queue, &scheduler, &slot, CAPACITY, SIGNAL_QUEUE_DROP_OLDEST, discard);
+  assert(error == 0);
+  stall(&queue);
+  for (i = 1; i <= BURST; ++i) {
+    error = signal_queue_emit(&queue, i, (void *)(size_t)i);
+    assert(error == 0);
+  }
+  ATOMIC_STORE(&gate_open, 1);
+  signal_queue_free(&queue);
+  assert(received_count == CAPACITY + 1 && received[1] == BURST - CAPACITY + 1 && received[CAPACITY] == BURST);
+  assert(discarded_count == BURST - CAPACITY);
+
+  printf("Coalesce the messages by keys.\n");
+  reset(0);
+  error = signal_queue_init(&queue, &scheduler, &slot, CAPACITY, SIGNAL_QUEUE_COALESCE, discard);
+  assert(error == 0);
+  stall(&queue);
+  for (i = 1; i <= BURST; ++i) {
+    error = signal_queue_emit(&queue, i % 2, (void *)(size_t)i);
+    assert(error == 0);
+  }
+  ATOMIC_STORE(&gate_open, 1);
+  signal_queue_get_stats(&queue, &stats);
+  signal_queue_free(&queue);
+  assert(received_count == 3 && received[1] == BURST - 1 && received[2] == BURST);
+  assert(stats.high_water == 2 && stats.coalesced == BURST - 2 && stats.dropped == 0);
+
+  printf("Block the emitter on overflow.\n");
+  reset(1);
+  error = signal_queue_init(&queue, &scheduler, &slot, CAPACITY, SIGNAL_QUEUE_BLOCK, NULL);
+  assert(error == 0);
+  for (i = 0; i < BLOCK_COUNT; ++i) {
+    error = signal_queue_emit(&queue, 0, (void *)(size_t)i);
+    assert(error == 0);
+  }
+  signal_queue_get_stats(&queue, &stats);
+  signal_queue_free(&queue);
+  for (i = 0; i < BLOCK_COUNT; ++i) {
+    assert(received[i] == i);
+  }
+  printf("%ld messages delivered, %ld emissions blocked, high water %ld.\n"
+    , (long)received_count, (long)stats.blocked, (long)stats.high_water);
+  assert(stats.high_water <= CAPACITY && stats.dropped == 0);
+
+  printf("Cancel the blocked emitter.\n");
+  reset(0);
+  cancel_token_init(&token);
+  error = signal_queue_init(&queue, &scheduler, &slot, CAPACITY, SIGNAL_QUEUE_BLOCK, discard);
+  assert(error == 0);
+  stall(&queue);
+  for (i = 1; i <= CAPACITY; ++i) {
+    error = signal_queue_emit_cancellable(&queue, i, (void *)(size_t)i, &token);
+    assert(error == 0);
+  }
+  scheduler_task_init(&cancel_task.task, cancel_task_run);
+  cancel_task.token = &token;
+  scheduler_submit_after(&scheduler, &cancel_task.task, 1000000);
+  error = signal_queue_emit_cancellable(&queue, i, (void *)(size_t)i, &token);
+  assert(error == ECANCELED);
+  ATOMIC_STORE(&gate_open, 1);
+  signal_queue_get_stats(&queue, &stats);
+  signal_queue_free(&queue);
+  cancel_token_free(&token);
+  assert(received_count == CAPACITY + 1);
+  assert(stats.blocked == 1 && stats.cancelled == 1 && discarded_count == 1);
+
+  CLOSURE_FREE(&slot);
+  scheduler_free(&scheduler);
+  return 0;
+}
@@ -0,0 +1,73 @@
+#include <stdio.h>
+
+#define BOOST_PP_VARIADICS 1
+
+#include <continuation/task_graph.h>
+
+#define FAN 16
+#define NODE_COUNT (FAN + 2)
+#define RUN_COUNT 100
+
+static TaskGraphClosure closures[NODE_COUNT];
+static volatile long clock_ticks = 0;
+static long stamps[NODE_COUNT];
+static long sums[NODE_COUNT];
+
+/* the node records when it runs and the argument of the run */
+static void connect_node(TaskGraphClosure *closure, int id)
+{
+  CLOSURE_INIT(closure);
+  CLOSURE_CONNECT(closure
+    , ()
+    , (
+      stamps[id] = ATOMIC_FETCH_ADD(&clock_ticks, 1);
+      sums[id] += (long)(size_t)CLOSURE_ARG_OF_(closure)->_1;
+    )
+    , ()
+  );
+}
+
+int main()
+{
+  struct __Scheduler scheduler;
+  struct __TaskGraph graph;
+  struct __TaskGraphNode *nodes[NODE_COUNT];
+  long expected = 0;
+  int i, run, error;
+
+  setbuf(stdout,NULL);
+  error = scheduler_init(&scheduler, 4);
+  assert(error == 0);
+  task_graph_init(&graph, &scheduler);
+  for (i = 0; i < NODE_COUNT; ++i) {
+    connect_node(&closures[i], i);
+    nodes[i] = task_graph_add(&graph, &closures[i]);
+    assert(nodes[i] != NULL);
+  }
+  /* the source fans out to the middle nodes, which fan in to the sink */
+  for (i = 1; i <= FAN; ++i) {
+    error = task_graph_depend(nodes[i], nodes[0]);
+    assert(error == 0);
+    error = task_graph_depend(nodes[NODE_COUNT - 1], nodes[i]);
+    assert(error == 0);
+  }
+
+  printf("Run a graph of %d nodes %d times.\n", NODE_COUNT, RUN_COUNT);
+  for (run = 1; run <= RUN_COUNT; ++run) {
+    task_graph_run(&graph, (void *)(size_t)run);
+    expected += run;
+    for (i = 1; i <= FAN; ++i) {
+      assert(stamps[0] < stamps[i] && stamps[i] < stamps[NODE_COUNT - 1]);
+    }
+  }
+  for (i = 0; i < NODE_COUNT; ++i) {
+    assert(sums[i] == expected);
+  }
+
+  task_graph_free(&graph);
+  scheduler_free(&scheduler);
+  for (i = 0; i < NODE_COUNT; ++i) {
+    CLOSURE_FREE(&closures[i]);
+  }
+  return 0;
+}
@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <string.h>
+
+#define BOOST_PP_VARIADICS 1
+
+#include <continuation/topic.h>
+
+#define PUBLISH_COUNT 1000
+#define WIDE_SEGMENTS 5
+
+static int exact_count = 0;
+static int star_count = 0;
+static int hash_count = 0;
+static int wide_count = 0;
+
+static void connect_slot(TopicSlot *slot, int *count)
+{
+  CLOSURE_INIT(slot);
+  CLOSURE_CONNECT(slot
+    , (
+      CLOSURE_RETAIN_VAR(slot);
+      CLOSURE_RETAIN_VAR(count);
+    )
+    , (
+      assert(strcmp((const char *)CLOSURE_ARG_OF_(slot)->_2, "filled") == 0);
+      ++*count;
+    )
+    , ()
+  );
+}
+
+int main()
+{
+  struct __TopicRegistry registry;
+  struct __TopicSubscription *subscription, *added;
+  struct __TopicHandle handle;
+  TopicSlot exact_slot, star_slot, hash_slot, wide_slot;
+  char pattern[2 * WIDE_SEGMENTS];
+  int i, j, error, count;
+
+  setbuf(stdout,NULL);
+  printf("Publish by hierarchical topics.\n");
+  error = topic_registry_init(&registry);
+  assert(error == 0);
+  connect_slot(&exact_slot, &exact_count);
+  connect_slot(&star_slot, &star_count);
+  connect_slot(&hash_slot, &hash_count);
+
+  added = topic_subscribe(&registry, "orders.eu.fill", &exact_slot);
+  assert(added != NULL);
+  added = topic_subscribe(&registry, "orders.*.fill", &star_slot);
+  assert(added != NULL);
+  subscription = topic_subscribe(&registry, "orders.#", &hash_slot);
+  assert(subscription != NULL);
+  /* reached by multiple paths but invoked once */
+  added = topic_subscribe(&registry, "#.#", &hash_slot);
+  assert(added != NULL);
+
+  count = topic_publish(&registry, "orders.eu.fill", "filled");
+  assert(count == 4);
+  count = topic_publish(&registry, "orders.us.fill", "filled");
+  assert(count == 3);
+  count = topic_publish(&registry, "orders", "filled");
+  assert(count == 2);
+  count = topic_publish(&registry, "orders.eu.fill.partial", "filled");
+  assert(count == 2);
+  count = topic_publish(&registry, "trades.eu.fill", "filled");
+  assert(count == 1);
+  assert(exact_count == 1 && star_count == 2 && hash_count == 9);
+
+  error = topic_resolve(&registry, "orders.eu.fill", &handle);
+  assert(error == 0);
+  for (i = 0; i < PUBLISH_COUNT; ++i) {
+    count = topic_publish_handle(&handle, "filled");
+    assert(count == 4);
+  }
+  assert(exact_count == 1 + PUBLISH_COUNT);
+  assert(star_count == 2 + PUBLISH_COUNT);
+
+  /* the handle is resolved again after the trie grows */
+  added = topic_subscribe(&registry, "*.eu.*", &exact_slot);
+  assert(added != NULL);
+  count = topic_publish_handle(&handle, "filled");
+  assert(count == 5);
+  assert(exact_count == 3 + PUBLISH_COUNT);
+
+  topic_unsubscribe(&registry, subscription);
+  count = topic_publish_handle(&handle, "filled");
+  assert(count == 4);
+  count = topic_publish(&registry, "orders", "filled");
+  assert(count == 1);
+  topic_handle_free(&handle);
+
+  /* more matched nodes than a publisher keeps on its stack */
+  connect_slot(&wide_slot, &wide_count);
+  for (i = 0; i < 1 << WIDE_SEGMENTS; ++i) {
+    for (j = 0; j < WIDE_SEGMENTS; ++j) {
+      pattern[2 * j] = i & (1 << j) ? '*' : 'a' + j;
+      pattern[2 * j + 1] = j < WIDE_SEGMENTS - 1 ? '.' : '\0';
+    }
+    added = topic_subscribe(&registry, pattern, &wide_slot);
+    assert(added != NULL);
+  }
+  count = topic_publish(&registry, "a.b.c.d.e", "filled");
+  assert(count == (1 << WIDE_SEGMENTS) + 1);
+  error = topic_resolve(&registry, "a.b.c.d.e", &handle);
+  assert(error == 0);
+  count = topic_publish_handle(&handle, "filled");
+  assert(count == (1 << WIDE_SEGMENTS) + 1);
+  topic_handle_free(&handle);
+  assert(wide_count == 2 << WIDE_SEGMENTS);
+  printf("%d exact, %d single-level and %d multi-level deliveries.\n", exact_count, star_count, hash_count);
+
+  topic_registry_free(&registry);
+  CLOSURE_FREE(&exact_slot);
+  CLOSURE_FREE(&star_slot);
+  CLOSURE_FREE(&hash_slot);
+  CLOSURE_FREE(&wide_slot);
+  return 0;
+}